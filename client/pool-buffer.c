@@ -2,6 +2,7 @@
 #include <cairo.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <pango/pangocairo.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +12,7 @@
 #include <unistd.h>
 #include <wayland-client.h>
 #include "config.h"
+#include "log.h"
 #include "pool-buffer.h"
 #include "util.h"
 
@@ -48,27 +50,109 @@ static const struct wl_buffer_listener buffer_listener = {
 	.release = buffer_release
 };
 
+void buffer_pool_init(struct buffer_pool *pool) {
+	memset(pool, 0, sizeof(struct buffer_pool));
+	wl_list_init(&pool->buffers);
+	pool->fd = -1;
+}
+
+static void pool_reset(struct buffer_pool *pool) {
+	if (pool->shm_pool) {
+		wl_shm_pool_destroy(pool->shm_pool);
+		pool->shm_pool = NULL;
+	}
+	if (pool->fd != -1) {
+		close(pool->fd);
+		pool->fd = -1;
+	}
+	pool->size = 0;
+}
+
+void buffer_pool_finish(struct buffer_pool *pool) {
+	if (pool->allocations > 0) {
+		sway_log(SWAY_DEBUG, "Buffer pool: %" PRIu64 " allocations, %" PRIu64
+				" reuses, %" PRIu64 " resizes", pool->allocations,
+				pool->reuses, pool->resizes);
+	}
+	struct pool_buffer *buffer, *tmp;
+	wl_list_for_each_safe(buffer, tmp, &pool->buffers, link) {
+		destroy_buffer(buffer);
+	}
+	pool_reset(pool);
+}
+
+/**
+ * Finds room for size bytes in the pool's file, growing it if needed. Sets
+ * offset to the start of the room, and prev to the link the new buffer should
+ * be inserted after to keep the buffers sorted.
+ */
+static bool pool_reserve(struct wl_shm *shm, struct buffer_pool *pool,
+		size_t size, size_t *offset, struct wl_list **prev) {
+	// First fit between the existing buffers
+	size_t end = 0;
+	struct wl_list *link = &pool->buffers;
+	struct pool_buffer *buffer;
+	wl_list_for_each(buffer, &pool->buffers, link) {
+		if (buffer->offset - end >= size) {
+			break;
+		}
+		end = buffer->offset + buffer->size;
+		link = &buffer->link;
+	}
+	*offset = end;
+	*prev = link;
+	if (end + size <= pool->size) {
+		return true;
+	}
+
+	if (pool->fd == -1) {
+		pool->fd = anonymous_shm_open();
+		if (pool->fd == -1) {
+			return false;
+		}
+	}
+	if (ftruncate(pool->fd, end + size) < 0) {
+		return false;
+	}
+	if (pool->shm_pool) {
+		wl_shm_pool_resize(pool->shm_pool, end + size);
+		pool->resizes++;
+	} else {
+		pool->shm_pool = wl_shm_create_pool(shm, pool->fd, end + size);
+	}
+	pool->size = end + size;
+	return true;
+}
+
 static struct pool_buffer *create_buffer(struct wl_shm *shm,
-		struct pool_buffer *buf, int32_t width, int32_t height,
+		struct buffer_pool *pool, int32_t width, int32_t height,
 		uint32_t format) {
 	uint32_t stride = width * 4;
-	size_t size = stride * height;
-
-	int fd = anonymous_shm_open();
-	if (fd == -1) {
+	// Each buffer is mapped on its own, so its offset must be page aligned
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t size = ((size_t)stride * height + page_size - 1) &
+		~(page_size - 1);
+
+	size_t offset;
+	struct wl_list *prev;
+	if (!pool_reserve(shm, pool, size, &offset, &prev)) {
 		return NULL;
 	}
-	if (ftruncate(fd, size) < 0) {
-		close(fd);
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			pool->fd, offset);
+	if (data == MAP_FAILED) {
 		return NULL;
 	}
-	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-	struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, size);
-	buf->buffer = wl_shm_pool_create_buffer(pool, 0,
-			width, height, stride, format);
-	wl_shm_pool_destroy(pool);
-	close(fd);
 
+	struct pool_buffer *buf = calloc(1, sizeof(struct pool_buffer));
+	if (!buf) {
+		munmap(data, size);
+		return NULL;
+	}
+	buf->pool = pool;
+	buf->buffer = wl_shm_pool_create_buffer(pool->shm_pool, offset,
+			width, height, stride, format);
+	buf->offset = offset;
 	buf->size = size;
 	buf->width = width;
 	buf->height = height;
@@ -79,10 +163,16 @@ static struct pool_buffer *create_buffer(struct wl_shm *shm,
 	buf->pango = pango_cairo_create_context(buf->cairo);
 
 	wl_buffer_add_listener(buf->buffer, &buffer_listener, buf);
+	wl_list_insert(prev, &buf->link);
+	pool->length++;
+	pool->allocations++;
 	return buf;
 }
 
 void destroy_buffer(struct pool_buffer *buffer) {
+	if (buffer->destroy_user_data) {
+		buffer->destroy_user_data(buffer->user_data);
+	}
 	if (buffer->buffer) {
 		wl_buffer_destroy(buffer->buffer);
 	}
@@ -98,33 +188,39 @@ void destroy_buffer(struct pool_buffer *buffer) {
 	if (buffer->data) {
 		munmap(buffer->data, buffer->size);
 	}
-	memset(buffer, 0, sizeof(struct pool_buffer));
+	struct buffer_pool *pool = buffer->pool;
+	wl_list_remove(&buffer->link);
+	free(buffer);
+
+	// Start over with an empty file, in case the buffers got smaller
+	if (--pool->length == 0) {
+		pool_reset(pool);
+	}
 }
 
 struct pool_buffer *get_next_buffer(struct wl_shm *shm,
-		struct pool_buffer pool[static 2], uint32_t width, uint32_t height) {
-	struct pool_buffer *buffer = NULL;
-
-	for (size_t i = 0; i < 2; ++i) {
-		if (pool[i].busy) {
+		struct buffer_pool *pool, uint32_t width, uint32_t height) {
+	struct pool_buffer *buffer = NULL, *iter, *tmp;
+	wl_list_for_each_safe(iter, tmp, &pool->buffers, link) {
+		if (iter->busy) {
 			continue;
 		}
-		buffer = &pool[i];
+		if (iter->width != width || iter->height != height) {
+			destroy_buffer(iter);
+		} else if (!buffer) {
+			buffer = iter;
+		}
 	}
 
-	if (!buffer) {
-		return NULL;
+	if (buffer) {
+		pool->reuses++;
+	} else if (pool->length < BUFFER_POOL_MAX_BUFFERS) {
+		buffer = create_buffer(shm, pool, width, height,
+				WL_SHM_FORMAT_ARGB8888);
 	}
 
-	if (buffer->width != width || buffer->height != height) {
-		destroy_buffer(buffer);
-	}
-
-	if (!buffer->buffer) {
-		if (!create_buffer(shm, buffer, width, height,
-					WL_SHM_FORMAT_ARGB8888)) {
-			return NULL;
-		}
+	if (!buffer) {
+		return NULL;
 	}
 	buffer->busy = true;
 	return buffer;
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hashmap.h"
+
+#define HASHMAP_MIN_CAPACITY 16
+
+uint32_t hash_string(const char *str) {
+	uint32_t hash = 2166136261u;
+	for (; *str; ++str) {
+		hash ^= (unsigned char)*str;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+hashmap_t *create_hashmap(void) {
+	hashmap_t *map = malloc(sizeof(hashmap_t));
+	if (!map) {
+		return NULL;
+	}
+	map->capacity = HASHMAP_MIN_CAPACITY;
+	map->length = 0;
+	map->slots = calloc(map->capacity, sizeof(struct hashmap_slot));
+	if (!map->slots) {
+		free(map);
+		return NULL;
+	}
+	return map;
+}
+
+void hashmap_free(hashmap_t *map) {
+	if (map == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < map->capacity; ++i) {
+		free(map->slots[i].key);
+	}
+	free(map->slots);
+	free(map);
+}
+
+static struct hashmap_slot *hashmap_find(hashmap_t *map, const char *key,
+		uint32_t hash) {
+	size_t mask = map->capacity - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		struct hashmap_slot *slot = &map->slots[i];
+		if (!slot->key || (slot->hash == hash && strcmp(slot->key, key) == 0)) {
+			return slot;
+		}
+	}
+}
+
+static bool hashmap_resize(hashmap_t *map) {
+	// Keep the load factor below 3/4 so that lookups always hit a free slot
+	if ((map->length + 1) * 4 < map->capacity * 3) {
+		return true;
+	}
+	size_t old_capacity = map->capacity;
+	struct hashmap_slot *old_slots = map->slots;
+	struct hashmap_slot *slots =
+		calloc(old_capacity * 2, sizeof(struct hashmap_slot));
+	if (!slots) {
+		return false;
+	}
+	map->capacity = old_capacity * 2;
+	map->slots = slots;
+	for (size_t i = 0; i < old_capacity; ++i) {
+		if (old_slots[i].key) {
+			*hashmap_find(map, old_slots[i].key, old_slots[i].hash) =
+				old_slots[i];
+		}
+	}
+	free(old_slots);
+	return true;
+}
+
+void *hashmap_get(hashmap_t *map, const char *key) {
+	return hashmap_find(map, key, hash_string(key))->value;
+}
+
+void *hashmap_set(hashmap_t *map, const char *key, void *value) {
+	uint32_t hash = hash_string(key);
+	struct hashmap_slot *slot = hashmap_find(map, key, hash);
+	if (slot->key) {
+		void *old = slot->value;
+		slot->value = value;
+		return old;
+	}
+
+	if (!hashmap_resize(map)) {
+		return NULL;
+	}
+	char *copy = strdup(key);
+	if (!copy) {
+		return NULL;
+	}
+	slot = hashmap_find(map, key, hash);
+	slot->key = copy;
+	slot->hash = hash;
+	slot->value = value;
+	map->length++;
+	return NULL;
+}
+
+void *hashmap_remove(hashmap_t *map, const char *key) {
+	struct hashmap_slot *slot = hashmap_find(map, key, hash_string(key));
+	if (!slot->key) {
+		return NULL;
+	}
+	void *value = slot->value;
+	free(slot->key);
+	map->length--;
+
+	// Shift back the following entries of the probe sequence, so that there
+	// are no holes between an entry and its home slot
+	size_t mask = map->capacity - 1;
+	size_t hole = slot - map->slots;
+	for (size_t i = (hole + 1) & mask; map->slots[i].key; i = (i + 1) & mask) {
+		size_t home = map->slots[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			map->slots[hole] = map->slots[i];
+			hole = i;
+		}
+	}
+	map->slots[hole] = (struct hashmap_slot){0};
+	return value;
+}
+
+void hashmap_for_each(hashmap_t *map,
+		void (*iterator)(const char *key, void *value, void *data), void *data) {
+	for (size_t i = 0; i < map->capacity; ++i) {
+		if (map->slots[i].key) {
+			iterator(map->slots[i].key, map->slots[i].value, data);
+		}
+	}
+}
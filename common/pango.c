@@ -17,28 +17,31 @@ size_t escape_markup_text(const char *src, char *dest) {
 	}
 
 	while (src[0]) {
+		const char *entity = NULL;
 		switch (src[0]) {
 		case '&':
-			length += 5;
-			lenient_strcat(dest, "&amp;");
+			entity = "&amp;";
 			break;
 		case '<':
-			length += 4;
-			lenient_strcat(dest, "&lt;");
+			entity = "&lt;";
 			break;
 		case '>':
-			length += 4;
-			lenient_strcat(dest, "&gt;");
+			entity = "&gt;";
 			break;
 		case '\'':
-			length += 6;
-			lenient_strcat(dest, "&apos;");
+			entity = "&apos;";
 			break;
 		case '"':
-			length += 6;
-			lenient_strcat(dest, "&quot;");
+			entity = "&quot;";
 			break;
-		default:
+		}
+		if (entity) {
+			size_t entity_len = strlen(entity);
+			if (dest) {
+				memcpy(dest + length, entity, entity_len + 1);
+			}
+			length += entity_len;
+		} else {
 			if (dest) {
 				dest[length] = *src;
 				dest[length + 1] = '\0';
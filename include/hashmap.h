@@ -0,0 +1,41 @@
+#ifndef _SWAY_HASHMAP_H
+#define _SWAY_HASHMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct hashmap_slot {
+	char *key; // NULL if the slot is unused
+	uint32_t hash;
+	void *value;
+};
+
+/**
+ * A hash map from strings to pointers, using open addressing.
+ *
+ * Keys are copied into the map. Values are not owned by the map.
+ */
+typedef struct {
+	size_t capacity; // power of two
+	size_t length;
+	struct hashmap_slot *slots;
+} hashmap_t;
+
+hashmap_t *create_hashmap(void);
+void hashmap_free(hashmap_t *map);
+// Returns the value stored for key or NULL if there is none.
+void *hashmap_get(hashmap_t *map, const char *key);
+// Returns the value previously stored for key or NULL if there was none.
+void *hashmap_set(hashmap_t *map, const char *key, void *value);
+// Returns the value which was stored for key or NULL if there was none.
+void *hashmap_remove(hashmap_t *map, const char *key);
+// Calls the iterator for each entry, in no particular order. The map must not
+// be modified from the iterator.
+void hashmap_for_each(hashmap_t *map,
+		void (*iterator)(const char *key, void *value, void *data), void *data);
+
+// FNV-1a hash of a NUL terminated string
+uint32_t hash_string(const char *str);
+
+#endif
@@ -6,19 +6,54 @@
 #include <stdint.h>
 #include <wayland-client.h>
 
+#define BUFFER_POOL_MAX_BUFFERS 4
+
+struct buffer_pool;
+
 struct pool_buffer {
+	struct wl_list link; // buffer_pool::buffers, sorted by offset
+	struct buffer_pool *pool;
 	struct wl_buffer *buffer;
 	cairo_surface_t *surface;
 	cairo_t *cairo;
 	PangoContext *pango;
 	uint32_t width, height;
 	void *data;
+	size_t offset, size; // slice of the pool's file
+	bool busy; // until the compositor releases the buffer
+
+	// Owned by the client, destroyed with the buffer
+	void *user_data;
+	void (*destroy_user_data)(void *user_data);
+};
+
+/**
+ * A pool of shm buffers which are suballocated from a single file. Buffers
+ * are reused once the compositor releases them, and new ones are added while
+ * all of them are busy, up to BUFFER_POOL_MAX_BUFFERS. The file only grows
+ * while buffers remain in it, so that the memory of buffers which are
+ * destroyed can be used again without creating a new file.
+ */
+struct buffer_pool {
+	struct wl_list buffers; // pool_buffer::link
+	int length;
+
+	int fd;
 	size_t size;
-	bool busy;
+	struct wl_shm_pool *shm_pool;
+
+	uint64_t allocations, reuses, resizes;
 };
 
+void buffer_pool_init(struct buffer_pool *pool);
+void buffer_pool_finish(struct buffer_pool *pool);
+
+/**
+ * Returns a buffer of the given size which is not in use by the compositor
+ * and marks it busy, or NULL if none is available.
+ */
 struct pool_buffer *get_next_buffer(struct wl_shm *shm,
-		struct pool_buffer pool[static 2], uint32_t width, uint32_t height);
+		struct buffer_pool *pool, uint32_t width, uint32_t height);
 void destroy_buffer(struct pool_buffer *buffer);
 
 #endif
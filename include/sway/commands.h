@@ -59,6 +59,10 @@ const struct cmd_handler *find_handler(const char *line,
  */
 list_t *execute_command(char *command,  struct sway_seat *seat,
 		struct sway_container *con);
+/**
+ * Drops the tokenized command lists kept by execute_command.
+ */
+void command_cache_clear(void);
 /**
  * Parse and handles a command during config file loading.
  *
@@ -12,6 +12,7 @@
 #include <xf86drmMode.h>
 #include "../include/config.h"
 #include "gesture.h"
+#include "hashmap.h"
 #include "list.h"
 #include "stringop.h"
 #include "swaynag.h"
@@ -115,6 +116,9 @@ struct sway_mode {
 	list_t *switch_bindings;
 	list_t *gesture_bindings;
 	bool pango;
+
+	// Lookup index over keysym_bindings and keycode_bindings, built lazily
+	struct sway_binding_index *binding_index;
 };
 
 struct input_config_mapped_from_region {
@@ -487,7 +491,10 @@ enum xwayland_mode {
 struct sway_config {
 	char *swaynag_command;
 	struct swaynag_instance swaynag_config_errors;
-	list_t *symbols;
+	list_t *symbols; // sorted by name length, longest first
+	hashmap_t *symbols_by_name; // struct sway_variable, same entries as symbols
+	int *symbol_lengths; // distinct lengths of the names in symbols
+	int symbol_lengths_len;
 	list_t *modes;
 	list_t *bars;
 	list_t *cmd_queue;
@@ -497,6 +504,7 @@ struct sway_config {
 	list_t *input_type_configs;
 	list_t *seat_configs;
 	list_t *criteria;
+	struct criteria_index *criteria_index; // built lazily by criteria.c
 	list_t *no_focus;
 	list_t *active_bar_modifiers;
 	struct sway_mode *current_mode;
@@ -616,12 +624,6 @@ bool load_main_config(const char *path, bool is_active, bool validating);
 void load_include_configs(const char *path, struct sway_config *config,
 		struct swaynag_instance *swaynag);
 
-/**
- * Reads the config from the given FILE.
- */
-bool read_config(FILE *file, struct sway_config *config,
-		struct swaynag_instance *swaynag);
-
 /**
  * Run the commands that were deferred when reading the config file.
  */
@@ -644,6 +646,11 @@ void free_config(struct sway_config *config);
 
 void free_sway_variable(struct sway_variable *var);
 
+/**
+ * Adds a variable to the config's symbols and updates their index.
+ */
+void config_add_symbol(struct sway_config *config, struct sway_variable *var);
+
 /**
  * Does variable replacement for a string based on the config's currently loaded variables.
  */
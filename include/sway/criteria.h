@@ -27,6 +27,8 @@ enum pattern_type {
 struct pattern {
 	enum pattern_type match_type;
 	pcre2_code *regex;
+	pcre2_match_data *match_data;
+	char *literal; // set if the regex is of the form ^literal$
 };
 
 struct criteria {
@@ -72,6 +74,11 @@ void criteria_destroy(struct criteria *criteria);
  */
 struct criteria *criteria_parse(char *raw, char **error);
 
+/**
+ * Destroy the lookup index over config->criteria.
+ */
+void criteria_index_destroy(struct criteria_index *index);
+
 /**
  * Compile a list of criterias matching the given view.
  *
@@ -0,0 +1,70 @@
+#ifndef _SWAY_HIT_INDEX_H
+#define _SWAY_HIT_INDEX_H
+#include <stdbool.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+
+/**
+ * A grid over the tiling layer of an output, used to hit test the pointer
+ * without walking every scene node of the layer.
+ *
+ * The index is rebuilt whenever the output is arranged after a transaction
+ * is applied. Entries are the scene trees of view containers and the title
+ * bars of split containers, which only move or get destroyed as part of a
+ * transaction. Their contents (surfaces, title text) may change between
+ * transactions, so hits inside an entry are still resolved by the scene.
+ */
+struct sway_hit_entry {
+	struct wlr_scene_node *node;
+	struct wlr_box box; // layout coordinates, covers all of node's contents
+};
+
+struct sway_hit_index {
+	// False until the index has been built, or if something it can't
+	// describe was found in the tree. Callers fall back to the scene then.
+	bool valid;
+
+	struct sway_hit_entry *entries; // in scene order, bottom first
+	int entries_len, entries_cap;
+
+	struct wlr_box bounds; // union of all entry boxes
+	int cell_size, columns, rows;
+	int *cell_offsets; // columns * rows + 1 offsets into cells
+	int *cells; // entry indices, ascending within each cell
+	int cell_offsets_cap, cells_cap;
+};
+
+void hit_index_finish(struct sway_hit_index *index);
+
+/**
+ * Start rebuilding the index. The index is empty and valid afterwards.
+ */
+void hit_index_begin(struct sway_hit_index *index);
+
+/**
+ * Add the containers of a workspace tiling tree to the index. Marks the index
+ * invalid if the tree contains anything else.
+ */
+void hit_index_add_tiling(struct sway_hit_index *index,
+		struct wlr_scene_tree *tree);
+
+/**
+ * Build the grid after all trees have been added.
+ */
+void hit_index_end(struct sway_hit_index *index);
+
+/**
+ * Empty and invalidate the index if any of its entries is inside node, which
+ * is about to be destroyed. It is built again when the output is arranged.
+ */
+void hit_index_forget(struct sway_hit_index *index,
+		struct wlr_scene_node *node);
+
+/**
+ * Find the topmost scene node at the given layout coordinates among the
+ * indexed entries, as wlr_scene_node_at would on the indexed trees.
+ */
+struct wlr_scene_node *hit_index_node_at(struct sway_hit_index *index,
+		double lx, double ly, double *nx, double *ny);
+
+#endif
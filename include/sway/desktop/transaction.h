@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <wlr/types/wlr_scene.h>
+#include "list.h"
 
 /**
  * Transactions enable us to perform atomic layout updates.
@@ -24,6 +25,40 @@
 struct sway_transaction_instruction;
 struct sway_view;
 
+#define TRANSACTION_STATS_BUCKETS 16
+
+/**
+ * A histogram of durations in milliseconds. Bucket 0 counts durations below
+ * 1ms, bucket i durations in [2^(i-1), 2^i) ms, and the last bucket all
+ * longer durations.
+ */
+struct sway_transaction_histogram {
+	uint64_t buckets[TRANSACTION_STATS_BUCKETS];
+	uint64_t count;
+};
+
+/**
+ * How fast the views of a client acknowledge configures, keyed by app_id (or
+ * X11 class).
+ */
+struct sway_transaction_client_stats {
+	char *app_id;
+	uint64_t configures;
+	uint64_t timeouts; // configures that missed their deadline
+	struct sway_transaction_histogram ack_latency; // commit to view ready
+	float ack_latency_avg_ms; // moving average, 0 before the first ack
+	unsigned int consecutive_misses;
+	bool slow; // missed several deadlines in a row, not waited for anymore
+};
+
+struct sway_transaction_stats {
+	uint64_t committed;
+	uint64_t applied;
+	uint64_t timed_out;
+	struct sway_transaction_histogram latency; // commit to apply
+	list_t *clients; // struct sway_transaction_client_stats
+};
+
 /**
  * Find all dirty containers, create and commit a transaction containing them,
  * and unmark them as dirty.
@@ -61,4 +96,25 @@ bool transaction_notify_view_ready_by_geometry(struct sway_view *view,
 
 void arrange_popups(struct wlr_scene_tree *popups);
 
+/**
+ * Statistics about all transactions since sway started. Always collected.
+ */
+const struct sway_transaction_stats *transaction_get_stats(void);
+
+/**
+ * Returns the upper bound in milliseconds of the bucket containing the given
+ * percentile (0 to 1), or -1 for the unbounded last bucket. Returns 0 for an
+ * empty histogram.
+ */
+int transaction_histogram_percentile(
+		const struct sway_transaction_histogram *histogram, double percentile);
+
+/**
+ * How long a transaction waits for a view of this client to acknowledge its
+ * configure before applying without it, based on the client's recent ack
+ * latency. Never more than the global transaction timeout.
+ */
+uint32_t transaction_client_deadline_ms(
+		const struct sway_transaction_client_stats *client);
+
 #endif
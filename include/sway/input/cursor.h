@@ -136,6 +136,12 @@ struct sway_cursor_touch *sway_cursor_touch_create(struct sway_cursor *cursor, s
  */
 void cursor_rebase(struct sway_cursor *cursor);
 void cursor_rebase_all(void);
+
+/**
+ * Rebase the cursors of the seats whose pointer is within the given region,
+ * in layout coordinates.
+ */
+void cursor_rebase_region(const pixman_region32_t *region);
 void cursor_update_image(struct sway_cursor *cursor, struct sway_node *node);
 
 void cursor_handle_activity_from_idle_source(struct sway_cursor *cursor,
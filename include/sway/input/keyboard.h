@@ -92,4 +92,11 @@ void sway_keyboard_configure(struct sway_keyboard *keyboard);
 void sway_keyboard_destroy(struct sway_keyboard *keyboard);
 
 void sway_keyboard_disarm_key_repeat(struct sway_keyboard *keyboard);
+
+/**
+ * Drop the binding lookup index of a mode. It is rebuilt on the next key
+ * event, so this must be called whenever the mode's keysym or keycode
+ * bindings change.
+ */
+void sway_keyboard_invalidate_binding_index(struct sway_mode *mode);
 #endif
@@ -73,6 +73,9 @@ struct sway_seat_node {
 	struct sway_node *node;
 
 	struct wl_list link; // sway_seat::focus_stack
+	struct wl_list node_link; // sway_node::seat_nodes
+	// Position in focus_stack: entries closer to the top have larger values
+	int64_t focus_order;
 
 	struct wl_listener destroy;
 };
@@ -98,6 +101,8 @@ struct sway_seat {
 
 	bool has_focus;
 	struct wl_list focus_stack; // list of containers in focus order
+	// Smallest and largest sway_seat_node::focus_order handed out
+	int64_t focus_order_bottom, focus_order_top;
 	struct sway_workspace *workspace;
 	char *prev_workspace_name; // for workspace back_and_forth
 
@@ -1,8 +1,11 @@
 #ifndef _SWAY_IPC_JSON_H
 #define _SWAY_IPC_JSON_H
 #include <json.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "sway/output.h"
 #include "sway/tree/container.h"
+#include "sway/tree/workspace.h"
 #include "sway/input/input-manager.h"
 
 #include <wlr/types/wlr_scene.h>
@@ -15,9 +18,28 @@ json_object *ipc_json_describe_disabled_output(struct sway_output *o);
 json_object *ipc_json_describe_non_desktop_output(struct sway_output_non_desktop *o);
 json_object *ipc_json_describe_node(struct sway_node *node);
 json_object *ipc_json_describe_node_recursive(struct sway_node *node);
+/**
+ * Appends the JSON serialization of the whole tree, as returned by
+ * ipc_json_describe_node_recursive(&root->node), to the buffer. The buffer is
+ * grown with realloc as needed. Returns false if an allocation failed.
+ */
+bool ipc_json_write_tree(char **data, size_t *len, size_t *size);
+
+/**
+ * Append the changes between the current state of a node and the state that
+ * is about to be applied to it to the changes array.
+ */
+void ipc_json_describe_output_diff(json_object *changes,
+		struct sway_output *output, struct sway_output_state *state);
+void ipc_json_describe_workspace_diff(json_object *changes,
+		struct sway_workspace *ws, struct sway_workspace_state *state);
+void ipc_json_describe_container_diff(json_object *changes,
+		struct sway_container *con, struct sway_container_state *state);
+
 json_object *ipc_json_describe_input(struct sway_input_device *device);
 json_object *ipc_json_describe_seat(struct sway_seat *seat);
 json_object *ipc_json_describe_bar_config(struct bar_config *bar);
 json_object *ipc_json_describe_scene(struct wlr_scene *scene);
+json_object *ipc_json_describe_stats(void);
 
 #endif
@@ -1,5 +1,6 @@
 #ifndef _SWAY_IPC_SERVER_H
 #define _SWAY_IPC_SERVER_H
+#include <json.h>
 #include <sys/socket.h>
 #include "sway/config.h"
 #include "sway/input/input-manager.h"
@@ -23,4 +24,11 @@ void ipc_event_binding(struct sway_binding *binding);
 void ipc_event_input(const char *change, struct sway_input_device *device);
 void ipc_event_output(void);
 
+bool ipc_event_tree_diff_wanted(void);
+/**
+ * Sends the tree_diff event. Takes ownership of the changes array, and does
+ * nothing if it is empty.
+ */
+void ipc_event_tree_diff(json_object *changes);
+
 #endif
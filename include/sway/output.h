@@ -7,6 +7,7 @@
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_scene.h>
 #include "config.h"
+#include "sway/desktop/hit_index.h"
 #include "sway/tree/node.h"
 #include "sway/tree/view.h"
 
@@ -38,6 +39,9 @@ struct sway_output {
 	// is black.
 	struct wlr_scene_rect *fullscreen_background;
 
+	// Hit testing index over layers.tiling, rebuilt when the output is arranged
+	struct sway_hit_index tiling_hits;
+
 	struct wlr_output *wlr_output;
 	struct wlr_scene_output *scene_output;
 	struct sway_server *server;
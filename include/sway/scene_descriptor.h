@@ -19,6 +19,7 @@ enum sway_scene_descriptor_type {
 	SWAY_SCENE_DESC_XWAYLAND_UNMANAGED,
 	SWAY_SCENE_DESC_POPUP,
 	SWAY_SCENE_DESC_DRAG_ICON,
+	SWAY_SCENE_DESC_OUTPUT,
 };
 
 bool scene_descriptor_assign(struct wlr_scene_node *node,
@@ -30,4 +31,15 @@ void *scene_descriptor_try_get(struct wlr_scene_node *node,
 void scene_descriptor_destroy(struct wlr_scene_node *node,
 	enum sway_scene_descriptor_type type);
 
+/**
+ * Get the descriptor that tells what a hit on the node belongs to: a
+ * container, view, popup, layer shell or unmanaged xwayland surface.
+ *
+ * This is looked up on every level of every hit test, so the descriptor is
+ * cached in wlr_scene_node.data, which sway doesn't use for anything else.
+ * If a node has several of these, the types are checked in that order.
+ */
+bool scene_descriptor_try_get_hit(struct wlr_scene_node *node,
+	enum sway_scene_descriptor_type *type, void **data);
+
 #endif
@@ -150,6 +150,7 @@ struct sway_debug {
 	bool txn_timings;      // Log verbose messages about transactions
 	bool txn_wait;         // Always wait for the timeout before applying
 	bool legacy_wl_drm;    // Enable the legacy wl_drm interface
+	bool ipc_tree_check;   // Compare streamed GET_TREE replies with json-c
 };
 
 extern struct sway_debug debug;
@@ -1,5 +1,7 @@
 #ifndef _SWAY_BUFFER_H
 #define _SWAY_BUFFER_H
+#include <stddef.h>
+#include <stdint.h>
 #include <wlr/types/wlr_scene.h>
 
 struct sway_text_node {
@@ -14,6 +16,16 @@ struct sway_text_node {
 	struct wlr_scene_node *node;
 };
 
+/**
+ * Rasterized texts are shared between the text nodes showing the same text
+ * with the same properties. Those no node shows anymore are kept for a while.
+ */
+struct sway_text_node_cache_stats {
+	size_t entries;
+	size_t bytes; // of all cached rasters, shown or not
+	uint64_t hits, misses, evictions;
+};
+
 struct sway_text_node *sway_text_node_create(struct wlr_scene_tree *parent,
 		char *text, float color[4], bool pango_markup);
 
@@ -25,4 +37,6 @@ void sway_text_node_set_max_width(struct sway_text_node *node, int max_width);
 
 void sway_text_node_set_background(struct sway_text_node *node, float background[4]);
 
+const struct sway_text_node_cache_stats *sway_text_node_get_cache_stats(void);
+
 #endif
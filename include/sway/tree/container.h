@@ -9,6 +9,7 @@
 
 struct sway_view;
 struct sway_seat;
+struct title_format;
 
 enum sway_container_layout {
 	L_NONE,
@@ -104,6 +105,10 @@ struct sway_container {
 	int title_width;
 	
 	char *title_format;
+	struct title_format *title_format_program; // compiled title_format
+
+	// formatted_title needs rebuilding before the next transaction
+	bool representation_dirty;
 
 	enum sway_container_layout prev_split_layout;
 
@@ -185,13 +190,33 @@ void container_update_title_bar(struct sway_container *container);
 
 void container_update_marks(struct sway_container *container);
 
-size_t parse_title_format(struct sway_container *container, char *buffer);
+/**
+ * Compiles and sets the container's title_format, taking ownership of format.
+ */
+void container_set_title_format(struct sway_container *container, char *format);
+
+/**
+ * Returns a newly allocated string with the container's formatted title.
+ */
+char *parse_title_format(struct sway_container *container);
 
-size_t container_build_representation(enum sway_container_layout layout,
-		list_t *children, char *buffer);
+/**
+ * Returns a newly allocated tree representation such as V[Terminal, Firefox].
+ */
+char *container_build_representation(enum sway_container_layout layout,
+		list_t *children);
 
+/**
+ * Marks the representation of the container and its ancestors as outdated.
+ * They are rebuilt when the next transaction is committed.
+ */
 void container_update_representation(struct sway_container *container);
 
+/**
+ * Rebuilds an outdated container representation, after those of its children.
+ */
+void container_flush_representation(struct sway_container *container);
+
 /**
  * Return the height of a regular title bar.
  */
@@ -321,6 +346,11 @@ bool container_is_transient_for(struct sway_container *child,
  */
 struct sway_container *container_find_mark(char *mark);
 
+/**
+ * Find the container with the given node id, if it is in the tree.
+ */
+struct sway_container *container_by_id(size_t id);
+
 /**
  * Find any container that has the given mark and remove the mark from the
  * container. Returns true if it matched a container.
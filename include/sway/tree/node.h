@@ -38,13 +38,21 @@ struct sway_node {
 	size_t id;
 
 	struct sway_transaction_instruction *instruction;
+	// The node's instruction in the most recent transaction it was added to
+	struct sway_transaction_instruction *pending_instruction;
 	size_t ntxnrefs;
 	bool destroying;
 
+	// True while the node is part of the current (applied) tree. Used to
+	// describe tree diffs over IPC.
+	bool has_current;
+
 	// If true, indicates that the container has pending state that differs from
 	// the current.
 	bool dirty;
 
+	struct wl_list seat_nodes; // sway_seat_node::node_link, one per seat
+
 	struct {
 		struct wl_signal destroy;
 	} events;
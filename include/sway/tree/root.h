@@ -8,6 +8,7 @@
 #include <wlr/render/wlr_texture.h>
 #include "sway/tree/container.h"
 #include "sway/tree/node.h"
+#include "hashmap.h"
 #include "list.h"
 
 extern struct sway_root *root;
@@ -69,6 +70,17 @@ struct sway_root {
 	struct sway_output *fallback_output;
 
 	struct sway_container *fullscreen_global;
+	// Whether the last arrangement showed a global fullscreen container, in
+	// which case the next one must arrange every output
+	bool arranged_fullscreen_global;
+
+	// Lookup indexes. They may contain nodes which aren't currently attached
+	// to the tree, so lookups must check candidates with root_has_workspace
+	// or root_has_container.
+	hashmap_t *workspaces_by_name; // ASCII lowercased name -> list_t
+	hashmap_t *workspaces_by_number; // leading digits of name -> list_t
+	hashmap_t *containers_by_mark; // mark -> list_t of sway_container
+	hashmap_t *containers_by_id; // decimal node id -> sway_container
 
 	struct {
 		struct wl_signal new_node;
@@ -118,6 +130,28 @@ struct sway_workspace *root_find_workspace(
 struct sway_container *root_find_container(
 		bool (*test)(struct sway_container *con, void *data), void *data);
 
+/**
+ * Add an item to the list stored for key in one of the multi-valued lookup
+ * indexes, creating the list if needed.
+ */
+void root_index_add(hashmap_t *index, const char *key, void *item);
+
+/**
+ * Remove an item from the list stored for key in one of the multi-valued
+ * lookup indexes, dropping the list once it is empty.
+ */
+void root_index_remove(hashmap_t *index, const char *key, void *item);
+
+/**
+ * Returns true if the workspace would be visited by root_find_workspace.
+ */
+bool root_has_workspace(struct sway_workspace *ws);
+
+/**
+ * Returns true if the container would be visited by root_find_container.
+ */
+bool root_has_container(struct sway_container *con);
+
 void root_get_box(struct sway_root *root, struct wlr_box *box);
 
 #endif
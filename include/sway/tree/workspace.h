@@ -34,6 +34,7 @@ struct sway_workspace {
 
 	char *name;
 	char *representation;
+	bool representation_dirty; // see workspace_update_representation
 
 	double x, y;
 	int width, height;
@@ -62,6 +63,12 @@ struct sway_workspace *workspace_create(struct sway_output *output,
 
 void workspace_destroy(struct sway_workspace *workspace);
 
+/**
+ * Rename the workspace, keeping the root lookup indexes up to date. Takes
+ * ownership of name.
+ */
+void workspace_set_name(struct sway_workspace *workspace, char *name);
+
 void workspace_begin_destroy(struct sway_workspace *workspace);
 
 void workspace_consider_destroy(struct sway_workspace *ws);
@@ -141,8 +148,17 @@ void workspace_add_gaps(struct sway_workspace *ws);
 struct sway_container *workspace_split(struct sway_workspace *workspace,
 		enum sway_container_layout layout);
 
+/**
+ * Marks the representation as outdated, to be rebuilt when the next
+ * transaction is committed.
+ */
 void workspace_update_representation(struct sway_workspace *ws);
 
+/**
+ * Rebuilds an outdated representation, after those of the tiling children.
+ */
+void workspace_flush_representation(struct sway_workspace *ws);
+
 void workspace_get_box(struct sway_workspace *workspace, struct wlr_box *box);
 
 size_t workspace_num_tiling_views(struct sway_workspace *ws);
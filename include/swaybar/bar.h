@@ -4,6 +4,7 @@
 #include "config.h"
 #include "input.h"
 #include "pool-buffer.h"
+#include "render.h"
 #include "cursor-shape-v1-client-protocol.h"
 #include "wlr-layer-shell-unstable-v1-client-protocol.h"
 #include "xdg-output-unstable-v1-client-protocol.h"
@@ -14,6 +15,7 @@ struct swaybar_output;
 struct swaybar_tray;
 #endif
 struct swaybar_workspace;
+struct text_cache;
 struct loop;
 
 struct swaybar {
@@ -36,6 +38,7 @@ struct swaybar {
 
 	struct swaybar_config *config;
 	struct status_line *status;
+	struct text_cache *text_cache;
 
 	struct loop *eventloop;
 
@@ -72,10 +75,12 @@ struct swaybar_output {
 	uint32_t width, height;
 	int32_t scale;
 	enum wl_output_subpixel subpixel;
-	struct pool_buffer buffers[2];
+	struct buffer_pool buffer_pool;
 	struct pool_buffer *current_buffer;
+	struct swaybar_render_frame surface_frame; // last committed frame
 	bool dirty;
 	bool frame_scheduled;
+	uint64_t updates, coalesced_updates;
 
 	uint32_t output_height, output_width, output_x, output_y;
 };
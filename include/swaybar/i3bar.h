@@ -24,6 +24,9 @@ struct i3bar_block {
 	int border_bottom;
 	int border_left;
 	int border_right;
+
+	char *json; // the text the block was parsed from
+	size_t json_len;
 };
 
 void i3bar_block_unref(struct i3bar_block *block);
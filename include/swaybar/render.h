@@ -1,8 +1,38 @@
 #ifndef _SWAYBAR_RENDER_H
 #define _SWAYBAR_RENDER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 struct swaybar_output;
 
+/**
+ * A horizontal span of the bar drawn by a single element (workspace button,
+ * binding mode indicator, status block or tray), spanning the full height.
+ */
+struct swaybar_render_region {
+	double x, width;
+	uint32_t hash; // of everything the element's drawing depends on
+	bool always_damaged;
+};
+
+/**
+ * What a rendered frame is made of, used to only repaint and damage the
+ * regions which differ between two frames.
+ */
+struct swaybar_render_frame {
+	bool valid;
+	uint32_t hash; // of everything affecting the whole bar
+	struct swaybar_render_region *regions;
+	size_t regions_len, regions_cap;
+};
+
 void render_frame(struct swaybar_output *output);
 
+/**
+ * Forget what the output's buffers and surface show, so that the next frame
+ * is fully repainted and damaged.
+ */
+void render_invalidate(struct swaybar_output *output);
+
 #endif
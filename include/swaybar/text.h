@@ -0,0 +1,46 @@
+#ifndef _SWAYBAR_TEXT_H
+#define _SWAYBAR_TEXT_H
+#include <cairo.h>
+#include <pango/pangocairo.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include "hashmap.h"
+
+/**
+ * A least recently used cache of shaped pango layouts, so that text which
+ * did not change is not parsed and shaped again on every frame.
+ *
+ * Layouts are keyed by text, markup flag, font and scale. Layouts drawn with
+ * some font options are kept apart from the ones only measured, so that the
+ * sizes match the uncached ones exactly.
+ */
+struct text_cache {
+	hashmap_t *entries_by_key; // struct text_cache_entry
+	struct wl_list entries; // text_cache_entry::link, most recent first
+	int length;
+
+	uint64_t hits, misses, evictions;
+
+	char *key; // scratch buffer for building keys
+	size_t key_size;
+};
+
+struct text_cache *text_cache_create(void);
+void text_cache_destroy(struct text_cache *cache);
+
+/**
+ * Same as get_text_size, for text which is not a format string.
+ */
+void text_cache_get_size(struct text_cache *cache, cairo_t *cairo,
+		const PangoFontDescription *desc, int *width, int *height,
+		int *baseline, double scale, bool markup, const char *text);
+
+/**
+ * Same as render_text, for text which is not a format string.
+ */
+void text_cache_render(struct text_cache *cache, cairo_t *cairo,
+		const PangoFontDescription *desc, double scale, bool markup,
+		const char *text);
+
+#endif
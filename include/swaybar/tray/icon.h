@@ -1,6 +1,7 @@
 #ifndef _SWAYBAR_TRAY_ICON_H
 #define _SWAYBAR_TRAY_ICON_H
 
+#include "hashmap.h"
 #include "list.h"
 
 struct icon_theme_subdir {
@@ -28,16 +29,33 @@ struct icon_theme {
 	list_t *subdirs; // struct icon_theme_subdir *
 };
 
+/*
+ * An index of the files in the icon directories which have been searched,
+ * so that looking up an icon does not need to touch the file system. Each
+ * directory is read the first time it is searched, and watched for changes
+ * with inotify where available.
+ */
+struct icon_index {
+	hashmap_t *dirs; // path -> struct icon_dir *
+	list_t *watched; // struct icon_dir *
+	int fd; // inotify file descriptor, -1 if unavailable
+};
+
 void init_themes(list_t **themes, list_t **basedirs);
 void finish_themes(list_t *themes, list_t *basedirs);
 
+struct icon_index *create_icon_index(void);
+void destroy_icon_index(struct icon_index *index);
+// Drops the directories which changed from the index
+void icon_index_handle_events(struct icon_index *index);
+
 /*
  * Finds an icon of a specified size given a list of themes and base directories.
  * If the icon is found, the pointers min_size & max_size are set to minimum &
  * maximum size that the icon can be scaled to, respectively.
  * Returns: path of icon (which should be freed), or NULL if the icon is not found.
  */
-char *find_icon(list_t *themes, list_t *basedirs, char *name, int size,
-		char *theme, int *min_size, int *max_size);
+char *find_icon(struct icon_index *index, list_t *themes, list_t *basedirs,
+		char *name, int size, char *theme, int *min_size, int *max_size);
 
 #endif
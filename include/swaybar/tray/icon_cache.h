@@ -0,0 +1,47 @@
+#ifndef _SWAYBAR_TRAY_ICON_CACHE_H
+#define _SWAYBAR_TRAY_ICON_CACHE_H
+
+#include <cairo.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include "hashmap.h"
+
+/**
+ * A least recently used cache of decoded and scaled tray icons, shared by all
+ * items and outputs, so that icons which are shown again are not decoded or
+ * scaled again. The cache holds a reference to each surface, and drops the
+ * oldest ones once they take up more than a fixed amount of memory.
+ */
+struct icon_cache {
+	hashmap_t *entries_by_key; // struct icon_cache_entry
+	struct wl_list entries; // icon_cache_entry::link, most recent first
+	size_t bytes;
+
+	uint64_t hits, misses, evictions;
+};
+
+struct icon_cache *icon_cache_create(void);
+void icon_cache_destroy(struct icon_cache *cache);
+
+/**
+ * Returns a reference to the image at path, decoding it only if it is not
+ * cached or the file changed. If key is not NULL, it is set to a key which
+ * identifies the image for icon_cache_scale and should be freed.
+ */
+cairo_surface_t *icon_cache_load(struct icon_cache *cache, const char *path,
+		char **key);
+
+/**
+ * Returns a key which identifies the contents of a pixmap of the given size
+ * for icon_cache_scale. The key should be freed.
+ */
+char *icon_cache_pixmap_key(int size, const unsigned char *pixels);
+
+/**
+ * Returns a reference to image, which is identified by key, scaled to size.
+ */
+cairo_surface_t *icon_cache_scale(struct icon_cache *cache, const char *key,
+		cairo_surface_t *image, int size);
+
+#endif
@@ -28,6 +28,7 @@ struct swaybar_sni {
 	// icon properties
 	struct swaybar_tray *tray;
 	cairo_surface_t *icon;
+	char *icon_key; // identifies the icon in the tray's icon_cache
 	int min_size;
 	int max_size;
 	int target_size;
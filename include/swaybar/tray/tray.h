@@ -14,6 +14,8 @@
 #include "swaybar/tray/host.h"
 #include "list.h"
 
+struct icon_cache;
+struct icon_index;
 struct swaybar;
 struct swaybar_output;
 struct swaybar_watcher;
@@ -32,6 +34,8 @@ struct swaybar_tray {
 
 	list_t *basedirs; // char *
 	list_t *themes; // struct swaybar_theme *
+	struct icon_index *icon_index;
+	struct icon_cache *icon_cache;
 };
 
 struct swaybar_tray *create_tray(struct swaybar *bar);
@@ -5,12 +5,14 @@
 #include <strings.h>
 #include <stdio.h>
 #include <json.h>
+#include <wayland-util.h>
 #include "sway/commands.h"
 #include "sway/config.h"
 #include "sway/criteria.h"
 #include "sway/input/input-manager.h"
 #include "sway/input/seat.h"
 #include "sway/tree/view.h"
+#include "hashmap.h"
 #include "stringop.h"
 #include "log.h"
 
@@ -203,10 +205,214 @@ static void set_config_node(struct sway_node *node, bool node_overridden) {
 	}
 }
 
+/**
+ * One command of a command list, as split, tokenized and unquoted by
+ * execute_command. Only text derived state is stored here; variables,
+ * criteria matches and the handler table depend on the current state and are
+ * resolved each time the command runs.
+ */
+struct command_segment {
+	bool new_list; // preceded by ';', so the criteria scope is reset
+	struct criteria *criteria; // NULL if the criteria depends on the focus
+	char *criteria_raw; // criteria which has to be parsed on each run
+	char *criteria_error; // criteria failed to parse, nothing follows
+	char *text;
+	int argc; // 0 for empty commands
+	char **argv;
+	const struct cmd_handler *handler;
+	int handler_scope; // find_handler_scope() the handler was found in
+};
+
+struct compiled_command {
+	int refcount; // one for the cache, one per running execute_command
+	list_t *segments; // struct command_segment
+	char *key; // command text, set while the command is cached
+	struct wl_list link; // command_cache_lru
+};
+
+#define COMMAND_CACHE_MAX_ENTRIES 256
+
+// command text -> struct compiled_command
+static hashmap_t *command_cache = NULL;
+// cached commands, most recently used first
+static struct wl_list command_cache_lru;
+
+static int find_handler_scope(void) {
+	return config->reading ? 1 : config->active ? 2 : 0;
+}
+
+static void command_segment_destroy(struct command_segment *segment) {
+	if (segment->criteria) {
+		criteria_destroy(segment->criteria);
+	}
+	free(segment->criteria_raw);
+	free(segment->criteria_error);
+	free(segment->text);
+	if (segment->argv) {
+		free_argv(segment->argc, segment->argv);
+	}
+	free(segment);
+}
+
+static void compiled_command_unref(struct compiled_command *compiled) {
+	if (!compiled || --compiled->refcount > 0) {
+		return;
+	}
+	for (int i = 0; i < compiled->segments->length; ++i) {
+		command_segment_destroy(compiled->segments->items[i]);
+	}
+	list_free(compiled->segments);
+	free(compiled->key);
+	free(compiled);
+}
+
+static struct compiled_command *compile_command(const char *text) {
+	struct compiled_command *compiled = calloc(1, sizeof(*compiled));
+	char *exec = strdup(text);
+	if (!compiled || !exec || !(compiled->segments = create_list())) {
+		free(compiled);
+		free(exec);
+		return NULL;
+	}
+	compiled->refcount = 1;
+
+	char *head = exec;
+	char matched_delim = ';';
+	do {
+		struct command_segment *segment = calloc(1, sizeof(*segment));
+		if (!segment) {
+			compiled_command_unref(compiled);
+			free(exec);
+			return NULL;
+		}
+		segment->handler_scope = -1;
+		list_add(compiled->segments, segment);
+
+		for (; isspace(*head); ++head) {}
+		// Extract criteria (valid for this command list only).
+		if (matched_delim == ';') {
+			segment->new_list = true;
+			if (*head == '[') {
+				char *error = NULL;
+				struct criteria *criteria = criteria_parse(head, &error);
+				if (!criteria) {
+					segment->criteria_error = error;
+					break;
+				}
+				head += strlen(criteria->raw);
+				// con_id=__focused__ is resolved while parsing
+				if (strstr(criteria->raw, "__focused__")) {
+					segment->criteria_raw = strdup(criteria->raw);
+					criteria_destroy(criteria);
+				} else {
+					segment->criteria = criteria;
+				}
+				// Skip leading whitespace
+				for (; isspace(*head); ++head) {}
+			}
+		}
+		// Split command list
+		char *cmd = argsep(&head, ";,", &matched_delim);
+		for (; isspace(*cmd); ++cmd) {}
+		if (strcmp(cmd, "") == 0) {
+			continue;
+		}
+
+		//TODO better handling of argv
+		segment->text = strdup(cmd);
+		segment->argv = split_args(cmd, &segment->argc);
+		if (strcmp(segment->argv[0], "exec") != 0 &&
+				strcmp(segment->argv[0], "exec_always") != 0 &&
+				strcmp(segment->argv[0], "mode") != 0) {
+			for (int i = 1; i < segment->argc; ++i) {
+				if (*segment->argv[i] == '\"' || *segment->argv[i] == '\'') {
+					strip_quotes(segment->argv[i]);
+				}
+			}
+		}
+	} while (head);
+
+	free(exec);
+	return compiled;
+}
+
+static void command_cache_remove(struct compiled_command *compiled) {
+	hashmap_remove(command_cache, compiled->key);
+	wl_list_remove(&compiled->link);
+	compiled_command_unref(compiled);
+}
+
+void command_cache_clear(void) {
+	if (!command_cache) {
+		return;
+	}
+	struct compiled_command *compiled, *tmp;
+	wl_list_for_each_safe(compiled, tmp, &command_cache_lru, link) {
+		command_cache_remove(compiled);
+	}
+	hashmap_free(command_cache);
+	command_cache = NULL;
+}
+
+static void command_cache_add(const char *text,
+		struct compiled_command *compiled) {
+	if (!command_cache) {
+		command_cache = create_hashmap();
+		if (!command_cache) {
+			return;
+		}
+		wl_list_init(&command_cache_lru);
+	}
+	if (!(compiled->key = strdup(text))) {
+		return;
+	}
+	if (command_cache->length >= COMMAND_CACHE_MAX_ENTRIES) {
+		// Evict the least recently used command, so that a stream of
+		// one-off IPC commands does not push out the bindings
+		struct compiled_command *oldest =
+			wl_container_of(command_cache_lru.prev, oldest, link);
+		command_cache_remove(oldest);
+	}
+	hashmap_set(command_cache, text, compiled);
+	wl_list_insert(&command_cache_lru, &compiled->link);
+	++compiled->refcount;
+}
+
+/**
+ * Returns the compiled form of a command list, reusing the one from a previous
+ * run of the same text. Bindings, for_window rules and repeated IPC commands
+ * are thereby only tokenized once. The caller owns a reference.
+ */
+static struct compiled_command *get_compiled_command(const char *text) {
+	struct compiled_command *compiled = NULL;
+	if (command_cache) {
+		compiled = hashmap_get(command_cache, text);
+	}
+	if (!compiled) {
+		compiled = compile_command(text);
+		if (compiled) {
+			command_cache_add(text, compiled);
+		}
+		return compiled;
+	}
+	wl_list_remove(&compiled->link);
+	wl_list_insert(&command_cache_lru, &compiled->link);
+	++compiled->refcount;
+	return compiled;
+}
+
+static const struct cmd_handler *segment_handler(
+		struct command_segment *segment) {
+	int scope = find_handler_scope();
+	if (segment->handler_scope != scope) {
+		segment->handler = find_core_handler(segment->argv[0]);
+		segment->handler_scope = scope;
+	}
+	return segment->handler;
+}
+
 list_t *execute_command(char *_exec, struct sway_seat *seat,
 		struct sway_container *con) {
-	char *cmd;
-	char matched_delim = ';';
 	list_t *containers = NULL;
 	bool using_criteria = false;
 
@@ -218,71 +424,80 @@ list_t *execute_command(char *_exec, struct sway_seat *seat,
 		}
 	}
 
-	char *exec = strdup(_exec);
-	char *head = exec;
+	struct compiled_command *compiled = get_compiled_command(_exec);
 	list_t *res_list = create_list();
 
-	if (!res_list || !exec) {
+	if (!res_list || !compiled) {
+		list_free(res_list);
+		compiled_command_unref(compiled);
 		return NULL;
 	}
 
 	config->handler_context.seat = seat;
 
-	do {
-		for (; isspace(*head); ++head) {}
+	for (int s = 0; s < compiled->segments->length; ++s) {
+		struct command_segment *segment = compiled->segments->items[s];
 		// Extract criteria (valid for this command list only).
-		if (matched_delim == ';') {
+		if (segment->new_list) {
 			using_criteria = false;
-			if (*head == '[') {
+			if (segment->criteria_error) {
+				list_add(res_list, cmd_results_new(CMD_INVALID, "%s",
+						segment->criteria_error));
+				goto cleanup;
+			}
+			struct criteria *criteria = segment->criteria;
+			if (segment->criteria_raw) {
 				char *error = NULL;
-				struct criteria *criteria = criteria_parse(head, &error);
+				criteria = criteria_parse(segment->criteria_raw, &error);
 				if (!criteria) {
 					list_add(res_list,
 							cmd_results_new(CMD_INVALID, "%s", error));
 					free(error);
 					goto cleanup;
 				}
+			}
+			if (criteria) {
 				list_free(containers);
 				containers = criteria_get_containers(criteria);
-				head += strlen(criteria->raw);
-				criteria_destroy(criteria);
+				if (criteria != segment->criteria) {
+					criteria_destroy(criteria);
+				}
 				using_criteria = true;
-				// Skip leading whitespace
-				for (; isspace(*head); ++head) {}
 			}
 		}
-		// Split command list
-		cmd = argsep(&head, ";,", &matched_delim);
-		for (; isspace(*cmd); ++cmd) {}
 
-		if (strcmp(cmd, "") == 0) {
+		if (segment->argc == 0) {
 			sway_log(SWAY_INFO, "Ignoring empty command.");
 			continue;
 		}
-		sway_log(SWAY_INFO, "Handling command '%s'", cmd);
-		//TODO better handling of argv
-		int argc;
-		char **argv = split_args(cmd, &argc);
-		if (strcmp(argv[0], "exec") != 0 &&
-				strcmp(argv[0], "exec_always") != 0 &&
-				strcmp(argv[0], "mode") != 0) {
-			for (int i = 1; i < argc; ++i) {
-				if (*argv[i] == '\"' || *argv[i] == '\'') {
-					strip_quotes(argv[i]);
-				}
-			}
-		}
-		const struct cmd_handler *handler = find_core_handler(argv[0]);
+		sway_log(SWAY_INFO, "Handling command '%s'", segment->text);
+		const struct cmd_handler *handler = segment_handler(segment);
 		if (!handler) {
 			list_add(res_list, cmd_results_new(CMD_INVALID,
-					"Unknown/invalid command '%s'", argv[0]));
-			free_argv(argc, argv);
+					"Unknown/invalid command '%s'", segment->argv[0]));
+			goto cleanup;
+		}
+
+		// Handlers may modify their arguments, so they get a copy
+		int argc = segment->argc;
+		char **argv = calloc(argc + 1, sizeof(char *));
+		for (int i = 0; argv && i < argc; ++i) {
+			if (!(argv[i] = strdup(segment->argv[i]))) {
+				free_argv(argc, argv);
+				argv = NULL;
+			}
+		}
+		if (!argv) {
+			list_add(res_list, cmd_results_new(CMD_FAILURE,
+					"Unable to allocate command arguments"));
 			goto cleanup;
 		}
 
 		// Var replacement, for all but first argument of set
 		for (int i = handler->handle == cmd_set ? 2 : 1; i < argc; ++i) {
-			argv[i] = do_var_replacement(argv[i]);
+			if (strchr(argv[i], '$')) {
+				argv[i] = do_var_replacement(argv[i]);
+			}
 		}
 
 
@@ -327,9 +542,9 @@ list_t *execute_command(char *_exec, struct sway_seat *seat,
 					fail_res ? fail_res : cmd_results_new(CMD_SUCCESS, NULL));
 		}
 		free_argv(argc, argv);
-	} while(head);
+	}
 cleanup:
-	free(exec);
+	compiled_command_unref(compiled);
 	list_free(containers);
 	return res_list;
 }
@@ -340,7 +555,7 @@ cleanup:
 // 3) it doesn't split commands (because the multiple commands are supposed to
 //	  be chained together)
 // 4) execute_command handles all state internally while config_command has
-// some state handled outside (notably the block mode, in read_config)
+// some state handled outside (notably the block mode, in execute_config_file)
 struct cmd_results *config_command(char *exec, char **new_block) {
 	struct cmd_results *results = NULL;
 	int argc;
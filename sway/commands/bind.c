@@ -480,6 +480,7 @@ static struct cmd_results *cmd_bindsym_or_bindcode(int argc, char **argv,
 	} else {
 		mode_bindings = config->current_mode->mouse_bindings;
 	}
+	sway_keyboard_invalidate_binding_index(config->current_mode);
 
 	if (unbind) {
 		return binding_remove(binding, mode_bindings, bindtype, argv[0]);
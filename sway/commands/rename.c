@@ -92,8 +92,7 @@ struct cmd_results *cmd_rename(int argc, char **argv) {
 
 	sway_log(SWAY_DEBUG, "renaming workspace '%s' to '%s'", workspace->name, new_name);
 
-	free(workspace->name);
-	workspace->name = new_name;
+	workspace_set_name(workspace, new_name);
 
 	output_sort_workspaces(workspace->output);
 	ipc_event_workspace(NULL, workspace, "rename");
@@ -1,8 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include "sway/commands.h"
 #include "sway/config.h"
+#include "hashmap.h"
 #include "list.h"
 #include "log.h"
 #include "stringop.h"
@@ -23,6 +25,34 @@ void free_sway_variable(struct sway_variable *var) {
 	free(var);
 }
 
+void config_add_symbol(struct sway_config *config, struct sway_variable *var) {
+	list_add(config->symbols, var);
+	list_qsort(config->symbols, compare_set_qsort);
+	hashmap_set(config->symbols_by_name, var->name, var);
+
+	// Remember each distinct name length once, so variable replacement only
+	// needs one lookup per length instead of comparing every name
+	int len = strlen(var->name);
+	int i = 0;
+	while (i < config->symbol_lengths_len && config->symbol_lengths[i] > len) {
+		++i;
+	}
+	if (i < config->symbol_lengths_len && config->symbol_lengths[i] == len) {
+		return;
+	}
+	int *lengths = realloc(config->symbol_lengths,
+			(config->symbol_lengths_len + 1) * sizeof(int));
+	if (!lengths) {
+		sway_log(SWAY_ERROR, "Unable to allocate variable index");
+		return;
+	}
+	memmove(&lengths[i + 1], &lengths[i],
+			(config->symbol_lengths_len - i) * sizeof(int));
+	lengths[i] = len;
+	config->symbol_lengths = lengths;
+	++config->symbol_lengths_len;
+}
+
 struct cmd_results *cmd_set(int argc, char **argv) {
 	struct cmd_results *error = NULL;
 	if ((error = checkarg(argc, "set", EXPECTED_AT_LEAST, 2))) {
@@ -33,16 +63,8 @@ struct cmd_results *cmd_set(int argc, char **argv) {
 		return cmd_results_new(CMD_INVALID, "variable '%s' must start with $", argv[0]);
 	}
 
-	struct sway_variable *var = NULL;
 	// Find old variable if it exists
-	int i;
-	for (i = 0; i < config->symbols->length; ++i) {
-		var = config->symbols->items[i];
-		if (strcmp(var->name, argv[0]) == 0) {
-			break;
-		}
-		var = NULL;
-	}
+	struct sway_variable *var = hashmap_get(config->symbols_by_name, argv[0]);
 	if (var) {
 		free(var->value);
 	} else {
@@ -51,8 +73,7 @@ struct cmd_results *cmd_set(int argc, char **argv) {
 			return cmd_results_new(CMD_FAILURE, "Unable to allocate variable");
 		}
 		var->name = strdup(argv[0]);
-		list_add(config->symbols, var);
-		list_qsort(config->symbols, compare_set_qsort);
+		config_add_symbol(config, var);
 	}
 	var->value = join_args(argv + 1, argc - 1);
 	return cmd_results_new(CMD_SUCCESS, NULL);
@@ -13,11 +13,6 @@
 static const char expected_syntax[] =
 	"Expected 'swap container with id|con_id|mark <arg>'";
 
-static bool test_con_id(struct sway_container *container, void *data) {
-	size_t *con_id = data;
-	return container->node.id == *con_id;
-}
-
 #if WLR_HAS_XWAYLAND
 static bool test_id(struct sway_container *container, void *data) {
 	xcb_window_t *wid = data;
@@ -26,14 +21,6 @@ static bool test_id(struct sway_container *container, void *data) {
 }
 #endif
 
-static bool test_mark(struct sway_container *container, void *mark) {
-	if (container->marks->length) {
-		return list_seq_find(container->marks,
-				(int (*)(const void *, const void *))strcmp, mark) != -1;
-	}
-	return false;
-}
-
 struct cmd_results *cmd_swap(int argc, char **argv) {
 	struct cmd_results *error = NULL;
 	if ((error = checkarg(argc, "swap", EXPECTED_AT_LEAST, 4))) {
@@ -59,9 +46,9 @@ struct cmd_results *cmd_swap(int argc, char **argv) {
 #endif
 	} else if (strcasecmp(argv[2], "con_id") == 0) {
 		size_t con_id = atoi(value);
-		other = root_find_container(test_con_id, &con_id);
+		other = container_by_id(con_id);
 	} else if (strcasecmp(argv[2], "mark") == 0) {
-		other = root_find_container(test_mark, value);
+		other = container_find_mark(value);
 	} else {
 		free(value);
 		return cmd_results_new(CMD_INVALID, "%s", expected_syntax);
@@ -16,11 +16,7 @@ struct cmd_results *cmd_title_format(int argc, char **argv) {
 		return cmd_results_new(CMD_INVALID,
 						 "Only valid containers can have a title_format");
 	}
-	char *format = join_args(argv, argc);
-	if (container->title_format) {
-		free(container->title_format);
-	}
-	container->title_format = format;
+	container_set_title_format(container, join_args(argv, argc));
 	if (container->view) {
 		view_update_title(container->view, true);
 	} else {
@@ -17,6 +17,7 @@
 #include <linux/input-event-codes.h>
 #include <wlr/types/wlr_output.h>
 #include "sway/input/input-manager.h"
+#include "sway/input/keyboard.h"
 #include "sway/input/seat.h"
 #include "sway/input/switch.h"
 #include "sway/commands.h"
@@ -29,6 +30,7 @@
 #include "sway/tree/root.h"
 #include "sway/tree/workspace.h"
 #include "cairo_util.h"
+#include "hashmap.h"
 #include "pango.h"
 #include "stringop.h"
 #include "list.h"
@@ -37,6 +39,30 @@
 
 struct sway_config *config = NULL;
 
+/**
+ * A config file split into lines, ready to be run as commands. Parsed files
+ * are kept across reloads, so that only the ones which changed are read and
+ * split again.
+ */
+struct config_line {
+	char *text; // without surrounding whitespace and line continuations
+	int number; // line number used in messages
+	bool brace; // followed by a lone '{' on a later line
+};
+
+struct config_file {
+	char *path;
+	struct stat sb; // of the file when it was read
+	char *contents;
+	size_t size;
+	struct config_line *lines;
+	size_t lines_len;
+	unsigned int generation; // of the last load which used the file
+};
+
+static hashmap_t *config_files = NULL; // real path -> struct config_file
+static unsigned int config_files_generation = 0;
+
 static struct xkb_state *keysym_translation_state_create(
 		struct xkb_rule_names rules, uint32_t context_flags) {
 	struct xkb_context *context = xkb_context_new(context_flags | XKB_CONTEXT_NO_SECURE_GETENV);
@@ -67,6 +93,7 @@ static void free_mode(struct sway_mode *mode) {
 		return;
 	}
 	free(mode->name);
+	sway_keyboard_invalidate_binding_index(mode);
 	if (mode->keysym_bindings) {
 		for (int i = 0; i < mode->keysym_bindings->length; i++) {
 			free_sway_binding(mode->keysym_bindings->items[i]);
@@ -106,6 +133,7 @@ void free_config(struct sway_config *config) {
 	}
 
 	memset(&config->handler_context, 0, sizeof(config->handler_context));
+	command_cache_clear();
 
 	// TODO: handle all currently unhandled lists as we add implementations
 	if (config->symbols) {
@@ -114,6 +142,8 @@ void free_config(struct sway_config *config) {
 		}
 		list_free(config->symbols);
 	}
+	hashmap_free(config->symbols_by_name);
+	free(config->symbol_lengths);
 	if (config->modes) {
 		for (int i = 0; i < config->modes->length; ++i) {
 			free_mode(config->modes->items[i]);
@@ -166,6 +196,7 @@ void free_config(struct sway_config *config) {
 		}
 		list_free(config->criteria);
 	}
+	criteria_index_destroy(config->criteria_index);
 	list_free(config->no_focus);
 	list_free(config->active_bar_modifiers);
 	list_free_items_and_destroy(config->config_chain);
@@ -216,6 +247,7 @@ static void config_defaults(struct sway_config *config) {
 	config->swaynag_config_errors.detailed = true;
 
 	if (!(config->symbols = create_list())) goto cleanup;
+	if (!(config->symbols_by_name = create_hashmap())) goto cleanup;
 	if (!(config->modes = create_list())) goto cleanup;
 	if (!(config->bars = create_list())) goto cleanup;
 	if (!(config->workspace_configs = create_list())) goto cleanup;
@@ -238,6 +270,7 @@ static void config_defaults(struct sway_config *config) {
 	if (!(config->current_mode->mouse_bindings = create_list())) goto cleanup;
 	if (!(config->current_mode->switch_bindings = create_list())) goto cleanup;
 	if (!(config->current_mode->gesture_bindings = create_list())) goto cleanup;
+	config->current_mode->binding_index = NULL;
 	list_add(config->modes, config->current_mode);
 
 	config->floating_mod = 0;
@@ -412,6 +445,11 @@ static char *get_config_path(void) {
 	return path;
 }
 
+static struct config_file *get_config_file(const char *path);
+static bool execute_config_file(const struct config_file *file,
+		struct sway_config *config, struct swaynag_instance *swaynag);
+static void prune_config_files(void);
+
 static bool load_config(const char *path, struct sway_config *config,
 		struct swaynag_instance *swaynag) {
 	if (path == NULL) {
@@ -427,14 +465,16 @@ static bool load_config(const char *path, struct sway_config *config,
 		return false;
 	}
 
-	FILE *f = fopen(path, "r");
-	if (!f) {
+	struct config_file *file = get_config_file(path);
+	if (!file) {
 		sway_log(SWAY_ERROR, "Unable to open %s for reading", path);
 		return false;
 	}
 
-	bool config_load_success = read_config(f, config, swaynag);
-	fclose(f);
+	if (config->current_config == NULL) {
+		config->current_config = strndup(file->contents, file->size);
+	}
+	bool config_load_success = execute_config_file(file, config, swaynag);
 
 	if (!config_load_success) {
 		sway_log(SWAY_ERROR, "Error(s) loading config!");
@@ -462,6 +502,8 @@ bool load_main_config(const char *file, bool is_active, bool validating) {
 		return false;
 	}
 
+	config_files_generation++;
+
 	struct sway_config *old_config = config;
 	config = calloc(1, sizeof(struct sway_config));
 	if (!config) {
@@ -506,6 +548,7 @@ bool load_main_config(const char *file, bool is_active, bool validating) {
 	config->reading = true;
 
 	bool success = load_config(path, config, &config->swaynag_config_errors);
+	prune_config_files();
 
 	if (validating) {
 		free_config(config);
@@ -745,71 +788,235 @@ static char *expand_line(const char *block, const char *line, bool add_brace) {
 	return expanded;
 }
 
-bool read_config(FILE *file, struct sway_config *config,
-		struct swaynag_instance *swaynag) {
-	bool reading_main_config = false;
-	char *this_config = NULL;
-	size_t config_size = 0;
-	if (config->current_config == NULL) {
-		reading_main_config = true;
+static void config_file_destroy(struct config_file *file) {
+	if (!file) {
+		return;
+	}
+	for (size_t i = 0; i < file->lines_len; ++i) {
+		free(file->lines[i].text);
+	}
+	free(file->lines);
+	free(file->contents);
+	free(file->path);
+	free(file);
+}
 
-		int ret_seek = fseek(file, 0, SEEK_END);
-		long ret_tell = ftell(file);
-		if (ret_seek == -1 || ret_tell == -1) {
-			sway_log(SWAY_ERROR, "Unable to get size of config file");
+static bool add_config_line(struct config_file *file, size_t *capacity,
+		const char *text, int number, bool brace) {
+	if (file->lines_len == *capacity) {
+		size_t new_capacity = *capacity ? *capacity * 2 : 64;
+		struct config_line *lines =
+			realloc(file->lines, new_capacity * sizeof(*lines));
+		if (!lines) {
 			return false;
 		}
-		config_size = ret_tell;
-		rewind(file);
+		file->lines = lines;
+		*capacity = new_capacity;
+	}
+	char *copy = strdup(text);
+	if (!copy) {
+		return false;
+	}
+	file->lines[file->lines_len++] = (struct config_line){
+		.text = copy,
+		.number = number,
+		.brace = brace,
+	};
+	return true;
+}
 
-		config->current_config = this_config = calloc(1, config_size + 1);
-		if (this_config == NULL) {
-			sway_log(SWAY_ERROR, "Unable to allocate buffer for config contents");
-			return false;
-		}
+/**
+ * Splits the contents of the file into the lines which are run as commands,
+ * skipping blank lines and comments.
+ */
+static bool split_config_lines(struct config_file *file) {
+	if (file->size == 0) {
+		return true;
+	}
+	FILE *f = fmemopen(file->contents, file->size, "r");
+	if (!f) {
+		return false;
 	}
 
 	bool success = true;
+	size_t capacity = 0;
 	int line_number = 0;
 	char *line = NULL;
 	size_t line_size = 0;
 	ssize_t nread;
-	list_t *stack = create_list();
-	size_t read = 0;
 	int nlines = 0;
-	while ((nread = getline_with_cont(&line, &line_size, file, &nlines)) != -1) {
-		if (reading_main_config) {
-			if (read + nread > config_size) {
-				sway_log(SWAY_ERROR, "Config file changed during reading");
-				success = false;
-				break;
-			}
-
-			strcpy(&this_config[read], line);
-			read += nread;
-		}
-
+	while ((nread = getline_with_cont(&line, &line_size, f, &nlines)) != -1) {
 		if (line[nread - 1] == '\n') {
 			line[nread - 1] = '\0';
 		}
 
 		line_number += nlines;
-		sway_log(SWAY_DEBUG, "Read line %d: %s", line_number, line);
-
 		strip_whitespace(line);
 		if (!*line || line[0] == '#') {
 			continue;
 		}
 		int brace_detected = 0;
 		if (line[strlen(line) - 1] != '{' && line[strlen(line) - 1] != '}') {
-			brace_detected = detect_brace(file);
-			if (brace_detected > 0) {
-				line_number += brace_detected;
-				sway_log(SWAY_DEBUG, "Detected open brace on line %d", line_number);
-			}
+			brace_detected = detect_brace(f);
+			line_number += brace_detected;
+		}
+		if (!add_config_line(file, &capacity, line, line_number,
+					brace_detected > 0)) {
+			success = false;
+			break;
+		}
+	}
+	free(line);
+	fclose(f);
+	return success;
+}
+
+static char *read_config_contents(FILE *f, size_t *size) {
+	size_t capacity = 4096;
+	char *contents = malloc(capacity);
+	*size = 0;
+	while (contents) {
+		*size += fread(&contents[*size], 1, capacity - *size - 1, f);
+		if (*size < capacity - 1) {
+			break;
+		}
+		capacity *= 2;
+		char *new_contents = realloc(contents, capacity);
+		if (!new_contents) {
+			free(contents);
+		}
+		contents = new_contents;
+	}
+	if (contents) {
+		if (ferror(f)) {
+			free(contents);
+			return NULL;
+		}
+		contents[*size] = '\0';
+	}
+	return contents;
+}
+
+static bool stat_equal(const struct stat *a, const struct stat *b) {
+	return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+		a->st_size == b->st_size &&
+		a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+		a->st_mtim.tv_nsec == b->st_mtim.tv_nsec &&
+		a->st_ctim.tv_sec == b->st_ctim.tv_sec &&
+		a->st_ctim.tv_nsec == b->st_ctim.tv_nsec;
+}
+
+/**
+ * Returns the parsed config file at path, only reading it if it changed
+ * since it was last read, and only splitting it again if its contents
+ * changed.
+ */
+static struct config_file *get_config_file(const char *path) {
+	if (!config_files) {
+		config_files = create_hashmap();
+		if (!config_files) {
+			return NULL;
 		}
+	}
+	struct config_file *cached = hashmap_get(config_files, path);
+
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		return NULL;
+	}
+	struct stat sb;
+	if (fstat(fileno(f), &sb) != 0) {
+		fclose(f);
+		return NULL;
+	}
+	if (cached && stat_equal(&cached->sb, &sb)) {
+		sway_log(SWAY_DEBUG, "Using cached lines of %s", path);
+		fclose(f);
+		cached->generation = config_files_generation;
+		return cached;
+	}
+
+	size_t size;
+	char *contents = read_config_contents(f, &size);
+	fclose(f);
+	if (!contents) {
+		return NULL;
+	}
+	if (cached && cached->size == size &&
+			memcmp(cached->contents, contents, size) == 0) {
+		sway_log(SWAY_DEBUG, "Using cached lines of %s", path);
+		free(contents);
+		cached->sb = sb;
+		cached->generation = config_files_generation;
+		return cached;
+	}
+
+	struct config_file *file = calloc(1, sizeof(struct config_file));
+	if (!file) {
+		free(contents);
+		return NULL;
+	}
+	file->path = strdup(path);
+	file->sb = sb;
+	file->contents = contents;
+	file->size = size;
+	file->generation = config_files_generation;
+	if (!file->path || !split_config_lines(file)) {
+		config_file_destroy(file);
+		return NULL;
+	}
+	sway_log(SWAY_DEBUG, "Read %zu lines from %s", file->lines_len, path);
+
+	hashmap_set(config_files, path, file);
+	config_file_destroy(cached);
+	return file;
+}
+
+struct prune_config_files_data {
+	list_t *unused;
+};
+
+static void find_unused_config_file(const char *path, void *value,
+		void *data) {
+	struct config_file *file = value;
+	struct prune_config_files_data *prune = data;
+	if (file->generation != config_files_generation) {
+		list_add(prune->unused, file);
+	}
+}
+
+/**
+ * Drops the files which were not used by the last load from the cache.
+ */
+static void prune_config_files(void) {
+	if (!config_files) {
+		return;
+	}
+	struct prune_config_files_data prune = { .unused = create_list() };
+	hashmap_for_each(config_files, find_unused_config_file, &prune);
+	for (int i = 0; i < prune.unused->length; ++i) {
+		struct config_file *file = prune.unused->items[i];
+		hashmap_remove(config_files, file->path);
+		config_file_destroy(file);
+	}
+	list_free(prune.unused);
+}
+
+static bool execute_config_file(const struct config_file *file,
+		struct sway_config *config, struct swaynag_instance *swaynag) {
+	bool success = true;
+	list_t *stack = create_list();
+	for (size_t i = 0; i < file->lines_len; ++i) {
+		const struct config_line *config_line = &file->lines[i];
+		char *line = config_line->text;
+		int line_number = config_line->number;
+		sway_log(SWAY_DEBUG, "Read line %d: %s", line_number, line);
+		if (config_line->brace) {
+			sway_log(SWAY_DEBUG, "Detected open brace on line %d", line_number);
+		}
+
 		char *block = stack->length ? stack->items[0] : NULL;
-		char *expanded = expand_line(block, line, brace_detected > 0);
+		char *expanded = expand_line(block, line, config_line->brace);
 		if (!expanded) {
 			success = false;
 			break;
@@ -876,7 +1083,6 @@ bool read_config(FILE *file, struct sway_config *config,
 		free(expanded);
 		free_cmd_results(res);
 	}
-	free(line);
 	list_free_items_and_destroy(stack);
 	config->current_config_line_number = 0;
 	config->current_config_line = NULL;
@@ -904,7 +1110,15 @@ void config_add_swaynag_warning(char *fmt, ...) {
 }
 
 char *do_var_replacement(char *str) {
-	int i;
+	// Every candidate name is a prefix of the text following a '$'. Look up
+	// one prefix per distinct name length, longest first, so the longest
+	// matching variable wins as it did when names were compared in order.
+	int max_len = config->symbol_lengths_len ? config->symbol_lengths[0] : 0;
+	char *name = malloc(max_len + 1);
+	if (!name) {
+		sway_log(SWAY_ERROR, "Unable to allocate variable name");
+		return str;
+	}
 	char *find = str;
 	while ((find = strchr(find, '$'))) {
 		// Skip if escaped.
@@ -923,35 +1137,43 @@ char *do_var_replacement(char *str) {
 			continue;
 		}
 		// Find matching variable
-		for (i = 0; i < config->symbols->length; ++i) {
-			struct sway_variable *var = config->symbols->items[i];
-			int vnlen = strlen(var->name);
-			if (strncmp(find, var->name, vnlen) == 0) {
-				int vvlen = strlen(var->value);
-				char *newstr = malloc(strlen(str) - vnlen + vvlen + 1);
-				if (!newstr) {
-					sway_log(SWAY_ERROR,
-						"Unable to allocate replacement "
-						"during variable expansion");
-					break;
-				}
-				char *newptr = newstr;
-				int offset = find - str;
-				strncpy(newptr, str, offset);
-				newptr += offset;
-				memcpy(newptr, var->value, vvlen);
-				newptr += vvlen;
-				strcpy(newptr, find + vnlen);
-				free(str);
-				str = newstr;
-				find = str + offset + vvlen;
-				break;
+		struct sway_variable *var = NULL;
+		size_t available = strnlen(find, max_len);
+		for (int i = 0; i < config->symbol_lengths_len && !var; ++i) {
+			int vnlen = config->symbol_lengths[i];
+			if ((size_t)vnlen > available) {
+				continue;
 			}
+			memcpy(name, find, vnlen);
+			name[vnlen] = '\0';
+			var = hashmap_get(config->symbols_by_name, name);
 		}
-		if (i == config->symbols->length) {
+		if (!var) {
 			++find;
+			continue;
+		}
+		int vnlen = strlen(var->name);
+		int vvlen = strlen(var->value);
+		char *newstr = malloc(strlen(str) - vnlen + vvlen + 1);
+		if (!newstr) {
+			sway_log(SWAY_ERROR,
+				"Unable to allocate replacement "
+				"during variable expansion");
+			++find;
+			continue;
 		}
+		char *newptr = newstr;
+		int offset = find - str;
+		strncpy(newptr, str, offset);
+		newptr += offset;
+		memcpy(newptr, var->value, vvlen);
+		newptr += vvlen;
+		strcpy(newptr, find + vnlen);
+		free(str);
+		str = newstr;
+		find = str + offset + vvlen;
 	}
+	free(name);
 	return str;
 }
 
@@ -1022,6 +1244,7 @@ void translate_keysyms(struct input_config *input_config) {
 
 		mode->keysym_bindings = bindsyms;
 		mode->keycode_bindings = bindcodes;
+		sway_keyboard_invalidate_binding_index(mode);
 	}
 
 	sway_log(SWAY_DEBUG, "Translated keysyms using config for device '%s'",
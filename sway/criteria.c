@@ -12,6 +12,7 @@
 #include "sway/tree/view.h"
 #include "sway/tree/workspace.h"
 #include "stringop.h"
+#include "hashmap.h"
 #include "list.h"
 #include "log.h"
 #include "config.h"
@@ -47,7 +48,10 @@ static bool generate_regex(pcre2_code **regex, char *value) {
 	PCRE2_SIZE offset;
 
 	*regex = pcre2_compile((PCRE2_SPTR)value, PCRE2_ZERO_TERMINATED, PCRE2_UTF | PCRE2_UCP, &errorcode, &offset, NULL);
-	if (!*regex) {
+	if (*regex) {
+		// Matching falls back to the interpreter if JIT is unavailable
+		pcre2_jit_compile(*regex, PCRE2_JIT_COMPLETE);
+	} else {
 		PCRE2_UCHAR buffer[256];
 		pcre2_get_error_message(errorcode, buffer, sizeof(buffer));
 
@@ -61,6 +65,23 @@ static bool generate_regex(pcre2_code **regex, char *value) {
 	return true;
 }
 
+/**
+ * Returns the string matched by a regex of the form ^literal$, or NULL if the
+ * regex has any other form.
+ */
+static char *regex_get_literal(const char *value) {
+	size_t len = strlen(value);
+	if (len < 2 || value[0] != '^' || value[len - 1] != '$') {
+		return NULL;
+	}
+	for (size_t i = 1; i < len - 1; ++i) {
+		if (strchr("\\^$.|?*+()[]{}", value[i])) {
+			return NULL;
+		}
+	}
+	return strndup(value + 1, len - 2);
+}
+
 static bool pattern_create(struct pattern **pattern, char *value) {
 	*pattern = calloc(1, sizeof(struct pattern));
 	if (!*pattern) {
@@ -74,6 +95,9 @@ static bool pattern_create(struct pattern **pattern, char *value) {
 		if (!generate_regex(&(*pattern)->regex, value)) {
 			return false;
 		};
+		(*pattern)->match_data =
+			pcre2_match_data_create_from_pattern((*pattern)->regex, NULL);
+		(*pattern)->literal = regex_get_literal(value);
 	}
 	return true;
 }
@@ -83,6 +107,8 @@ static void pattern_destroy(struct pattern *pattern) {
 		if (pattern->regex) {
 			pcre2_code_free(pattern->regex);
 		}
+		pcre2_match_data_free(pattern->match_data);
+		free(pattern->literal);
 		free(pattern);
 	}
 }
@@ -104,11 +130,19 @@ void criteria_destroy(struct criteria *criteria) {
 	free(criteria);
 }
 
-static int regex_cmp(const char *item, const pcre2_code *regex) {
-	pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(regex, NULL);
-	int result = pcre2_match(regex, (PCRE2_SPTR)item, strlen(item), 0, 0, match_data, NULL);
-	pcre2_match_data_free(match_data);
-	return result;
+static bool literal_match(const char *literal, const char *item) {
+	size_t len = strlen(literal);
+	// Like PCRE2, let $ also match before a trailing newline
+	return strncmp(item, literal, len) == 0 && (item[len] == '\0' ||
+			(item[len] == '\n' && item[len + 1] == '\0'));
+}
+
+static bool pattern_match(const struct pattern *pattern, const char *item) {
+	if (pattern->literal) {
+		return literal_match(pattern->literal, item);
+	}
+	return pcre2_match(pattern->regex, (PCRE2_SPTR)item, strlen(item), 0, 0,
+			pattern->match_data, NULL) >= 0;
 }
 
 #if WLR_HAS_XWAYLAND
@@ -163,7 +197,7 @@ static bool criteria_matches_container(struct criteria *criteria,
 		bool exists = false;
 		struct sway_container *con = container;
 		for (int i = 0; i < con->marks->length; ++i) {
-			if (regex_cmp(con->marks->items[i], criteria->con_mark->regex) >= 0) {
+			if (pattern_match(criteria->con_mark, con->marks->items[i])) {
 				exists = true;
 				break;
 			}
@@ -182,11 +216,38 @@ static bool criteria_matches_container(struct criteria *criteria,
 	return true;
 }
 
-static bool criteria_matches_view(struct criteria *criteria,
-		struct sway_view *view) {
+/**
+ * State shared by all criteria checks of a single evaluation.
+ */
+struct criteria_context {
+	struct sway_view *focused;
+	list_t *urgent_views; // sorted by urgency, NULL until needed
+};
+
+static void criteria_context_init(struct criteria_context *ctx) {
 	struct sway_seat *seat = input_manager_current_seat();
 	struct sway_container *focus = seat_get_focused_container(seat);
-	struct sway_view *focused = focus ? focus->view : NULL;
+	ctx->focused = focus ? focus->view : NULL;
+	ctx->urgent_views = NULL;
+}
+
+static void criteria_context_finish(struct criteria_context *ctx) {
+	list_free(ctx->urgent_views);
+}
+
+static list_t *criteria_context_get_urgent_views(
+		struct criteria_context *ctx) {
+	if (!ctx->urgent_views) {
+		ctx->urgent_views = create_list();
+		root_for_each_container(find_urgent_iterator, ctx->urgent_views);
+		list_stable_sort(ctx->urgent_views, cmp_urgent);
+	}
+	return ctx->urgent_views;
+}
+
+static bool criteria_matches_view(struct criteria *criteria,
+		struct sway_view *view, struct criteria_context *ctx) {
+	struct sway_view *focused = ctx->focused;
 
 	if (criteria->title) {
 		const char *title = view_get_title(view);
@@ -201,7 +262,7 @@ static bool criteria_matches_view(struct criteria *criteria,
 			}
 			break;
 		case PATTERN_PCRE2:
-			if (regex_cmp(title, criteria->title->regex) < 0) {
+			if (!pattern_match(criteria->title, title)) {
 				return false;
 			}
 			break;
@@ -221,7 +282,7 @@ static bool criteria_matches_view(struct criteria *criteria,
 			}
 			break;
 		case PATTERN_PCRE2:
-			if (regex_cmp(shell, criteria->shell->regex) < 0) {
+			if (!pattern_match(criteria->shell, shell)) {
 				return false;
 			}
 			break;
@@ -241,7 +302,7 @@ static bool criteria_matches_view(struct criteria *criteria,
 			}
 			break;
 		case PATTERN_PCRE2:
-			if (regex_cmp(app_id, criteria->app_id->regex) < 0) {
+			if (!pattern_match(criteria->app_id, app_id)) {
 				return false;
 			}
 			break;
@@ -273,7 +334,7 @@ static bool criteria_matches_view(struct criteria *criteria,
 			}
 			break;
 		case PATTERN_PCRE2:
-			if (regex_cmp(class, criteria->class->regex) < 0) {
+			if (!pattern_match(criteria->class, class)) {
 				return false;
 			}
 			break;
@@ -293,7 +354,7 @@ static bool criteria_matches_view(struct criteria *criteria,
 			}
 			break;
 		case PATTERN_PCRE2:
-			if (regex_cmp(instance, criteria->instance->regex) < 0) {
+			if (!pattern_match(criteria->instance, instance)) {
 				return false;
 			}
 			break;
@@ -313,7 +374,7 @@ static bool criteria_matches_view(struct criteria *criteria,
 			}
 			break;
 		case PATTERN_PCRE2:
-			if (regex_cmp(window_role, criteria->window_role->regex) < 0) {
+			if (!pattern_match(criteria->window_role, window_role)) {
 				return false;
 			}
 			break;
@@ -343,16 +404,13 @@ static bool criteria_matches_view(struct criteria *criteria,
 		if (!view_is_urgent(view)) {
 			return false;
 		}
-		list_t *urgent_views = create_list();
-		root_for_each_container(find_urgent_iterator, urgent_views);
-		list_stable_sort(urgent_views, cmp_urgent);
+		list_t *urgent_views = criteria_context_get_urgent_views(ctx);
 		struct sway_view *target;
 		if (criteria->urgent == 'o') { // oldest
 			target = urgent_views->items[0];
 		} else { // latest
 			target = urgent_views->items[urgent_views->length - 1];
 		}
-		list_free(urgent_views);
 		if (view != target) {
 			return false;
 		}
@@ -372,7 +430,7 @@ static bool criteria_matches_view(struct criteria *criteria,
 			}
 			break;
 		case PATTERN_PCRE2:
-			if (regex_cmp(ws->name, criteria->workspace->regex) < 0) {
+			if (!pattern_match(criteria->workspace, ws->name)) {
 				return false;
 			}
 			break;
@@ -388,20 +446,259 @@ static bool criteria_matches_view(struct criteria *criteria,
 	return true;
 }
 
+/**
+ * Positions of criteria in config->criteria, in ascending order.
+ */
+struct criteria_positions {
+	int *items;
+	int length, capacity;
+};
+
+enum criteria_index_field {
+	CRITERIA_INDEX_APP_ID,
+#if WLR_HAS_XWAYLAND
+	CRITERIA_INDEX_CLASS,
+	CRITERIA_INDEX_INSTANCE,
+#endif
+	CRITERIA_INDEX_TITLE,
+	CRITERIA_INDEX_FIELD_COUNT,
+};
+
+/**
+ * Groups config->criteria by the first field which they match against a
+ * literal string, so that criteria_for_view only needs to check the criteria
+ * whose literal is the view's value for that field, and the ones without
+ * such a field.
+ */
+struct criteria_index {
+	int length; // of config->criteria when the index was built
+	// literal -> struct criteria_positions
+	hashmap_t *literals[CRITERIA_INDEX_FIELD_COUNT];
+	struct criteria_positions generic;
+};
+
+static void criteria_positions_add(struct criteria_positions *positions,
+		int position) {
+	if (positions->length == positions->capacity) {
+		int capacity = positions->capacity ? positions->capacity * 2 : 8;
+		int *items = realloc(positions->items, capacity * sizeof(int));
+		if (!items) {
+			sway_log(SWAY_ERROR, "Unable to allocate criteria index");
+			return;
+		}
+		positions->items = items;
+		positions->capacity = capacity;
+	}
+	positions->items[positions->length++] = position;
+}
+
+static void criteria_positions_destroy(const char *key, void *value,
+		void *data) {
+	struct criteria_positions *positions = value;
+	free(positions->items);
+	free(positions);
+}
+
+void criteria_index_destroy(struct criteria_index *index) {
+	if (!index) {
+		return;
+	}
+	for (size_t i = 0; i < CRITERIA_INDEX_FIELD_COUNT; ++i) {
+		if (index->literals[i]) {
+			hashmap_for_each(index->literals[i],
+					criteria_positions_destroy, NULL);
+			hashmap_free(index->literals[i]);
+		}
+	}
+	free(index->generic.items);
+	free(index);
+}
+
+static struct pattern *criteria_index_get_pattern(struct criteria *criteria,
+		enum criteria_index_field field) {
+	switch (field) {
+	case CRITERIA_INDEX_APP_ID:
+		return criteria->app_id;
+#if WLR_HAS_XWAYLAND
+	case CRITERIA_INDEX_CLASS:
+		return criteria->class;
+	case CRITERIA_INDEX_INSTANCE:
+		return criteria->instance;
+#endif
+	case CRITERIA_INDEX_TITLE:
+		return criteria->title;
+	case CRITERIA_INDEX_FIELD_COUNT:
+		break;
+	}
+	return NULL;
+}
+
+static const char *criteria_index_get_view_value(struct sway_view *view,
+		enum criteria_index_field field) {
+	const char *value = NULL;
+	switch (field) {
+	case CRITERIA_INDEX_APP_ID:
+		value = view_get_app_id(view);
+		break;
+#if WLR_HAS_XWAYLAND
+	case CRITERIA_INDEX_CLASS:
+		value = view_get_class(view);
+		break;
+	case CRITERIA_INDEX_INSTANCE:
+		value = view_get_instance(view);
+		break;
+#endif
+	case CRITERIA_INDEX_TITLE:
+		value = view_get_title(view);
+		break;
+	case CRITERIA_INDEX_FIELD_COUNT:
+		break;
+	}
+	return value ? value : "";
+}
+
+static void criteria_index_add(struct criteria_index *index,
+		struct criteria *criteria, int position) {
+	for (size_t i = 0; i < CRITERIA_INDEX_FIELD_COUNT; ++i) {
+		struct pattern *pattern = criteria_index_get_pattern(criteria, i);
+		if (!pattern || !pattern->literal) {
+			continue;
+		}
+		struct criteria_positions *positions =
+			hashmap_get(index->literals[i], pattern->literal);
+		if (!positions) {
+			positions = calloc(1, sizeof(struct criteria_positions));
+			if (!positions) {
+				break;
+			}
+			hashmap_set(index->literals[i], pattern->literal, positions);
+			if (hashmap_get(index->literals[i], pattern->literal) != positions) {
+				free(positions);
+				break;
+			}
+		}
+		criteria_positions_add(positions, position);
+		return;
+	}
+	criteria_positions_add(&index->generic, position);
+}
+
+/**
+ * Get the index over config->criteria, rebuilding it if criteria have been
+ * added since it was built. Criteria are only ever removed along with the
+ * whole config.
+ */
+static struct criteria_index *criteria_get_index(void) {
+	struct criteria_index *index = config->criteria_index;
+	if (index && index->length == config->criteria->length) {
+		return index;
+	}
+	criteria_index_destroy(index);
+	config->criteria_index = NULL;
+
+	index = calloc(1, sizeof(struct criteria_index));
+	if (!index) {
+		return NULL;
+	}
+	for (size_t i = 0; i < CRITERIA_INDEX_FIELD_COUNT; ++i) {
+		index->literals[i] = create_hashmap();
+		if (!index->literals[i]) {
+			criteria_index_destroy(index);
+			return NULL;
+		}
+	}
+	for (int i = 0; i < config->criteria->length; ++i) {
+		criteria_index_add(index, config->criteria->items[i], i);
+	}
+	index->length = config->criteria->length;
+	config->criteria_index = index;
+	return index;
+}
+
+// Each field can match a value both with and without a trailing newline
+#define CRITERIA_MAX_CANDIDATE_LISTS (1 + 2 * CRITERIA_INDEX_FIELD_COUNT)
+
+static size_t criteria_index_lookup(struct criteria_index *index,
+		struct sway_view *view,
+		struct criteria_positions *lists[static CRITERIA_MAX_CANDIDATE_LISTS]) {
+	size_t len = 0;
+	lists[len++] = &index->generic;
+	for (size_t i = 0; i < CRITERIA_INDEX_FIELD_COUNT; ++i) {
+		if (index->literals[i]->length == 0) {
+			continue;
+		}
+		const char *value = criteria_index_get_view_value(view, i);
+		struct criteria_positions *positions =
+			hashmap_get(index->literals[i], value);
+		if (positions) {
+			lists[len++] = positions;
+		}
+
+		size_t value_len = strlen(value);
+		if (value_len > 0 && value[value_len - 1] == '\n') {
+			char *stripped = strndup(value, value_len - 1);
+			if (stripped) {
+				positions = hashmap_get(index->literals[i], stripped);
+				if (positions) {
+					lists[len++] = positions;
+				}
+				free(stripped);
+			}
+		}
+	}
+	return len;
+}
+
 list_t *criteria_for_view(struct sway_view *view, enum criteria_type types) {
 	list_t *criterias = config->criteria;
 	list_t *matches = create_list();
-	for (int i = 0; i < criterias->length; ++i) {
-		struct criteria *criteria = criterias->items[i];
-		if ((criteria->type & types) && criteria_matches_view(criteria, view)) {
+	struct criteria_context ctx;
+	criteria_context_init(&ctx);
+
+	struct criteria_index *index = criteria_get_index();
+	if (!index) {
+		for (int i = 0; i < criterias->length; ++i) {
+			struct criteria *criteria = criterias->items[i];
+			if ((criteria->type & types) &&
+					criteria_matches_view(criteria, view, &ctx)) {
+				list_add(matches, criteria);
+			}
+		}
+		criteria_context_finish(&ctx);
+		return matches;
+	}
+
+	// Merge the candidate lists, to check the criteria in config order
+	struct criteria_positions *lists[CRITERIA_MAX_CANDIDATE_LISTS];
+	int heads[CRITERIA_MAX_CANDIDATE_LISTS] = {0};
+	size_t lists_len = criteria_index_lookup(index, view, lists);
+	while (true) {
+		struct criteria_positions *next = NULL;
+		int *next_head = NULL;
+		for (size_t i = 0; i < lists_len; ++i) {
+			if (heads[i] < lists[i]->length && (!next ||
+					lists[i]->items[heads[i]] < next->items[*next_head])) {
+				next = lists[i];
+				next_head = &heads[i];
+			}
+		}
+		if (!next) {
+			break;
+		}
+		struct criteria *criteria = criterias->items[next->items[*next_head]];
+		++*next_head;
+		if ((criteria->type & types) &&
+				criteria_matches_view(criteria, view, &ctx)) {
 			list_add(matches, criteria);
 		}
 	}
+	criteria_context_finish(&ctx);
 	return matches;
 }
 
 struct match_data {
 	struct criteria *criteria;
+	struct criteria_context ctx;
 	list_t *matches;
 };
 
@@ -409,7 +706,8 @@ static void criteria_get_containers_iterator(struct sway_container *container,
 		void *data) {
 	struct match_data *match_data = data;
 	if (container->view) {
-		if (criteria_matches_view(match_data->criteria, container->view)) {
+		if (criteria_matches_view(match_data->criteria, container->view,
+				&match_data->ctx)) {
 			list_add(match_data->matches, container);
 		}
 	} else if (has_container_criteria(match_data->criteria)) {
@@ -419,13 +717,71 @@ static void criteria_get_containers_iterator(struct sway_container *container,
 	}
 }
 
+struct mark_candidates {
+	struct pattern *pattern;
+	list_t *containers;
+};
+
+static void collect_mark_candidates(const char *mark, void *value,
+		void *data) {
+	struct mark_candidates *candidates = data;
+	if (!pattern_match(candidates->pattern, mark)) {
+		return;
+	}
+	list_t *containers = value;
+	for (int i = 0; i < containers->length; ++i) {
+		struct sway_container *con = containers->items[i];
+		if (root_has_container(con) &&
+				list_find(candidates->containers, con) == -1) {
+			list_add(candidates->containers, con);
+		}
+	}
+}
+
+/**
+ * Narrows the search down using the root lookup indexes when the criteria
+ * select containers by id or mark. Returns false if the whole tree has to be
+ * traversed instead, which is also done when several containers carry a
+ * matching mark so that matches keep the traversal order.
+ */
+static bool criteria_get_indexed_containers(struct match_data *data) {
+	struct criteria *criteria = data->criteria;
+	if (criteria->con_id) {
+		struct sway_container *con = container_by_id(criteria->con_id);
+		if (con) {
+			criteria_get_containers_iterator(con, data);
+		}
+		return true;
+	}
+	if (!criteria->con_mark ||
+			criteria->con_mark->match_type != PATTERN_PCRE2) {
+		return false;
+	}
+	struct mark_candidates candidates = {
+		.pattern = criteria->con_mark,
+		.containers = create_list(),
+	};
+	hashmap_for_each(root->containers_by_mark, collect_mark_candidates,
+			&candidates);
+	bool indexed = candidates.containers->length <= 1;
+	if (indexed && candidates.containers->length) {
+		criteria_get_containers_iterator(candidates.containers->items[0], data);
+	}
+	list_free(candidates.containers);
+	return indexed;
+}
+
 list_t *criteria_get_containers(struct criteria *criteria) {
 	list_t *matches = create_list();
 	struct match_data data = {
 		.criteria = criteria,
 		.matches = matches,
 	};
-	root_for_each_container(criteria_get_containers_iterator, &data);
+	criteria_context_init(&data.ctx);
+	if (!criteria_get_indexed_containers(&data)) {
+		root_for_each_container(criteria_get_containers_iterator, &data);
+	}
+	criteria_context_finish(&data.ctx);
 	return matches;
 }
 
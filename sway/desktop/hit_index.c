@@ -0,0 +1,320 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+#include "log.h"
+#include "sway/desktop/hit_index.h"
+#include "sway/scene_descriptor.h"
+#include "sway/tree/container.h"
+#include "sway/tree/view.h"
+
+#define HIT_INDEX_CELL_SIZE 64
+#define HIT_INDEX_MAX_CELLS 4096
+
+static void box_add(struct wlr_box *box, int x, int y, int width, int height) {
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	if (wlr_box_empty(box)) {
+		*box = (struct wlr_box){ x, y, width, height };
+		return;
+	}
+	int x2 = box->x + box->width;
+	int y2 = box->y + box->height;
+	box->x = box->x < x ? box->x : x;
+	box->y = box->y < y ? box->y : y;
+	box->width = (x2 > x + width ? x2 : x + width) - box->x;
+	box->height = (y2 > y + height ? y2 : y + height) - box->y;
+}
+
+/**
+ * Extend box by everything wlr_scene_node_at could hit in the enabled part
+ * of the subtree. x and y are the layout coordinates of node.
+ */
+static void node_extents(struct wlr_scene_node *node, int x, int y,
+		struct wlr_box *box) {
+	if (!node->enabled) {
+		return;
+	}
+	switch (node->type) {
+	case WLR_SCENE_NODE_TREE:;
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			node_extents(child, x + child->x, y + child->y, box);
+		}
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+		box_add(box, x, y, rect->width, rect->height);
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		int width = buffer->dst_width;
+		int height = buffer->dst_height;
+		if ((width <= 0 || height <= 0) && buffer->raster) {
+			width = buffer->raster->width;
+			height = buffer->raster->height;
+			if (buffer->transform & WL_OUTPUT_TRANSFORM_90) {
+				int tmp = width;
+				width = height;
+				height = tmp;
+			}
+		}
+		box_add(box, x, y, width, height);
+		break;
+	}
+}
+
+static void add_entry(struct sway_hit_index *index,
+		struct wlr_scene_node *node, struct wlr_box *box) {
+	if (wlr_box_empty(box)) {
+		return;
+	}
+	if (index->entries_len == index->entries_cap) {
+		int cap = index->entries_cap ? index->entries_cap * 2 : 32;
+		struct sway_hit_entry *entries =
+			realloc(index->entries, cap * sizeof(*entries));
+		if (!entries) {
+			sway_log(SWAY_ERROR, "Unable to grow hit index");
+			index->valid = false;
+			return;
+		}
+		index->entries = entries;
+		index->entries_cap = cap;
+	}
+	index->entries[index->entries_len++] = (struct sway_hit_entry){
+		.node = node,
+		.box = *box,
+	};
+	box_add(&index->bounds, box->x, box->y, box->width, box->height);
+}
+
+static void add_subtree(struct sway_hit_index *index,
+		struct wlr_scene_node *node) {
+	int x, y;
+	wlr_scene_node_coords(node, &x, &y);
+	struct wlr_box box = {0};
+	node_extents(node, x, y, &box);
+	add_entry(index, node, &box);
+}
+
+static void add_container(struct sway_hit_index *index,
+		struct wlr_scene_node *node) {
+	if (!node->enabled) {
+		return;
+	}
+	struct sway_container *con =
+		scene_descriptor_try_get(node, SWAY_SCENE_DESC_CONTAINER);
+	if (!con) {
+		index->valid = false;
+		return;
+	}
+	if (con->node.destroying) {
+		// Its scene tree is freed once the transaction is done with it
+		return;
+	}
+
+	if (con->view) {
+		int x, y;
+		wlr_scene_node_coords(node, &x, &y);
+		struct wlr_box box = {0};
+		node_extents(node, x, y, &box);
+
+		// Surfaces of tiled views are clipped to the content size, but may
+		// grow up to it before the next transaction
+		int cx, cy;
+		wlr_scene_node_coords(&con->view->content_tree->node, &cx, &cy);
+		box_add(&box, cx, cy, ceil(con->current.content_width),
+				ceil(con->current.content_height));
+		add_entry(index, node, &box);
+		return;
+	}
+
+	// Split containers have a title bar and the border tree holding the
+	// children, in that order
+	struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &tree->children, link) {
+		if (!child->enabled) {
+			continue;
+		}
+		if (child == &con->title_bar.tree->node) {
+			add_subtree(index, child);
+		} else if (child == &con->border.tree->node) {
+			struct wlr_scene_node *content;
+			wl_list_for_each(content, &con->border.tree->children, link) {
+				if (content != &con->content_tree->node) {
+					index->valid = false;
+					return;
+				}
+				if (!content->enabled) {
+					continue;
+				}
+				struct wlr_scene_node *grandchild;
+				wl_list_for_each(grandchild, &con->content_tree->children, link) {
+					add_container(index, grandchild);
+				}
+			}
+		} else {
+			index->valid = false;
+			return;
+		}
+	}
+}
+
+void hit_index_finish(struct sway_hit_index *index) {
+	free(index->entries);
+	free(index->cell_offsets);
+	free(index->cells);
+	memset(index, 0, sizeof(*index));
+}
+
+void hit_index_begin(struct sway_hit_index *index) {
+	index->valid = true;
+	index->entries_len = 0;
+	index->bounds = (struct wlr_box){0};
+	index->columns = index->rows = 0;
+}
+
+void hit_index_add_tiling(struct sway_hit_index *index,
+		struct wlr_scene_tree *tree) {
+	if (!tree->node.enabled) {
+		return;
+	}
+	struct wlr_scene_node *node;
+	wl_list_for_each(node, &tree->children, link) {
+		add_container(index, node);
+	}
+}
+
+void hit_index_forget(struct sway_hit_index *index,
+		struct wlr_scene_node *node) {
+	for (int i = 0; i < index->entries_len; ++i) {
+		struct wlr_scene_node *entry = index->entries[i].node;
+		for (; entry; entry = entry->parent ? &entry->parent->node : NULL) {
+			if (entry == node) {
+				hit_index_begin(index);
+				index->valid = false;
+				return;
+			}
+		}
+	}
+}
+
+static bool grow_array(int **array, int *cap, int len) {
+	if (len <= *cap) {
+		return true;
+	}
+	int *grown = realloc(*array, len * sizeof(int));
+	if (!grown) {
+		sway_log(SWAY_ERROR, "Unable to grow hit index");
+		return false;
+	}
+	*array = grown;
+	*cap = len;
+	return true;
+}
+
+static void entry_cells(struct sway_hit_index *index,
+		struct sway_hit_entry *entry, int *c0, int *r0, int *c1, int *r1) {
+	*c0 = (entry->box.x - index->bounds.x) / index->cell_size;
+	*r0 = (entry->box.y - index->bounds.y) / index->cell_size;
+	*c1 = (entry->box.x + entry->box.width - 1 - index->bounds.x) /
+		index->cell_size;
+	*r1 = (entry->box.y + entry->box.height - 1 - index->bounds.y) /
+		index->cell_size;
+}
+
+void hit_index_end(struct sway_hit_index *index) {
+	if (!index->valid || !index->entries_len) {
+		return;
+	}
+
+	int cell_size = HIT_INDEX_CELL_SIZE;
+	int columns, rows;
+	while (true) {
+		columns = (index->bounds.width + cell_size - 1) / cell_size;
+		rows = (index->bounds.height + cell_size - 1) / cell_size;
+		if (columns * rows <= HIT_INDEX_MAX_CELLS) {
+			break;
+		}
+		cell_size *= 2;
+	}
+	index->cell_size = cell_size;
+	index->columns = columns;
+	index->rows = rows;
+
+	int ncells = columns * rows;
+	if (!grow_array(&index->cell_offsets, &index->cell_offsets_cap,
+			ncells + 1)) {
+		index->valid = false;
+		return;
+	}
+	int *offsets = index->cell_offsets;
+	memset(offsets, 0, (ncells + 1) * sizeof(int));
+
+	// Count the entries of each cell, then turn the counts into offsets
+	for (int i = 0; i < index->entries_len; ++i) {
+		int c0, r0, c1, r1;
+		entry_cells(index, &index->entries[i], &c0, &r0, &c1, &r1);
+		for (int r = r0; r <= r1; ++r) {
+			for (int c = c0; c <= c1; ++c) {
+				offsets[r * columns + c + 1]++;
+			}
+		}
+	}
+	for (int i = 0; i < ncells; ++i) {
+		offsets[i + 1] += offsets[i];
+	}
+
+	if (!grow_array(&index->cells, &index->cells_cap, offsets[ncells])) {
+		index->valid = false;
+		return;
+	}
+
+	// Fill each cell in entry order. This advances offsets[i] to the start of
+	// cell i + 1, so shift them back afterwards.
+	for (int i = 0; i < index->entries_len; ++i) {
+		int c0, r0, c1, r1;
+		entry_cells(index, &index->entries[i], &c0, &r0, &c1, &r1);
+		for (int r = r0; r <= r1; ++r) {
+			for (int c = c0; c <= c1; ++c) {
+				index->cells[offsets[r * columns + c]++] = i;
+			}
+		}
+	}
+	memmove(offsets + 1, offsets, ncells * sizeof(int));
+	offsets[0] = 0;
+}
+
+struct wlr_scene_node *hit_index_node_at(struct sway_hit_index *index,
+		double lx, double ly, double *nx, double *ny) {
+	if (!index->entries_len ||
+			!wlr_box_contains_point(&index->bounds, lx, ly)) {
+		return NULL;
+	}
+
+	int c = (int)floor(lx - index->bounds.x) / index->cell_size;
+	int r = (int)floor(ly - index->bounds.y) / index->cell_size;
+	if (c >= index->columns || r >= index->rows) {
+		return NULL;
+	}
+	int cell = r * index->columns + c;
+
+	// Later entries are drawn above earlier ones
+	for (int i = index->cell_offsets[cell + 1] - 1;
+			i >= index->cell_offsets[cell]; --i) {
+		struct sway_hit_entry *entry = &index->entries[index->cells[i]];
+		if (!wlr_box_contains_point(&entry->box, lx, ly)) {
+			continue;
+		}
+		struct wlr_scene_node *node =
+			wlr_scene_node_at(entry->node, lx, ly, nx, ny);
+		if (node) {
+			return node;
+		}
+	}
+	return NULL;
+}
@@ -209,14 +209,15 @@ static void output_configure_scene(struct sway_output *output,
 		return;
 	}
 
-	struct sway_container *con =
-		scene_descriptor_try_get(node, SWAY_SCENE_DESC_CONTAINER);
-	if (con) {
-		opacity = con->alpha;
-	}
-
 	if (node->type == WLR_SCENE_NODE_BUFFER) {
 		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+
+		// Buffers which aren't shown here are configured by the outputs
+		// showing them, before they are rendered there
+		if (!(buffer->active_outputs & (1ull << output->scene_output->index))) {
+			return;
+		}
+
 		struct wlr_scene_surface *surface = wlr_scene_surface_try_from_buffer(buffer);
 
 		if (surface) {
@@ -234,6 +235,19 @@ static void output_configure_scene(struct sway_output *output,
 
 		wlr_scene_buffer_set_opacity(buffer, opacity);
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
+		// The layers of other outputs hold nothing that is shown here
+		struct sway_output *layer_output =
+			scene_descriptor_try_get(node, SWAY_SCENE_DESC_OUTPUT);
+		if (layer_output && layer_output != output) {
+			return;
+		}
+
+		struct sway_container *con =
+			scene_descriptor_try_get(node, SWAY_SCENE_DESC_CONTAINER);
+		if (con) {
+			opacity = con->alpha;
+		}
+
 		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
 		struct wlr_scene_node *node;
 		wl_list_for_each(node, &tree->children, link) {
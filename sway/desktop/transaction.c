@@ -1,29 +1,77 @@
+#include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <wlr/types/wlr_buffer.h>
 #include "sway/config.h"
 #include "sway/scene_descriptor.h"
+#include "sway/desktop/hit_index.h"
 #include "sway/desktop/idle_inhibit_v1.h"
 #include "sway/desktop/transaction.h"
 #include "sway/input/cursor.h"
 #include "sway/input/input-manager.h"
+#include "sway/ipc-json.h"
+#include "sway/ipc-server.h"
 #include "sway/output.h"
 #include "sway/server.h"
 #include "sway/tree/container.h"
 #include "sway/tree/node.h"
 #include "sway/tree/view.h"
 #include "sway/tree/workspace.h"
+#include "hashmap.h"
 #include "list.h"
 #include "log.h"
 
+// Clients beyond this many app_ids are accounted together as "other"
+#define TRANSACTION_STATS_MAX_CLIENTS 256
+
+// Adaptive deadlines: a view is waited for twice its client's average ack
+// latency plus some slack, within these bounds
+#define TRANSACTION_DEADLINE_MIN_MS 20
+#define TRANSACTION_DEADLINE_SLACK_MS 10
+// Clients missing this many deadlines in a row are flagged as slow and only
+// waited for the minimum deadline
+#define TRANSACTION_SLOW_CLIENT_MISSES 3
+
+static struct sway_transaction_stats stats = {0};
+static hashmap_t *stats_clients_by_app_id = NULL;
+
+// Size of the first chunk of a transaction arena, later chunks double
+#define TRANSACTION_ARENA_CHUNK_SIZE 4096
+
+struct transaction_arena_chunk {
+	struct transaction_arena_chunk *next;
+	size_t size, used;
+	max_align_t data[];
+};
+
+/**
+ * A bump allocator for data living as long as a transaction. Everything is
+ * freed at once when the transaction is destroyed.
+ */
+struct transaction_arena {
+	struct transaction_arena_chunk *chunks; // most recent first
+};
+
+// The largest chunk of the last destroyed arena, reused by the next one
+static struct transaction_arena_chunk *spare_arena_chunk = NULL;
+
 struct sway_transaction {
 	struct wl_event_source *timer;
+	struct transaction_arena arena;
 	list_t *instructions;   // struct sway_transaction_instruction *
 	size_t num_waiting;
 	size_t num_configures;
 	struct timespec commit_time;
+	bool timed_out; // at least one view missed its deadline
+
+	// What applying the transaction changed, to limit the scene arrange and
+	// cursor rebasing to it
+	bool affects_all;
+	list_t *affected_outputs; // struct sway_output
+	pixman_region32_t affected_region; // layout coordinates
 };
 
 struct sway_transaction_instruction {
@@ -37,8 +85,197 @@ struct sway_transaction_instruction {
 	uint32_t serial;
 	bool server_request;
 	bool waiting;
+	struct sway_transaction_client_stats *client; // set for configured views
+	uint32_t deadline_ms; // relative to the commit time, if waiting
 };
 
+static float elapsed_ms(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000 +
+		(now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void histogram_add(struct sway_transaction_histogram *histogram,
+		float ms) {
+	size_t bucket = 0;
+	while (bucket < TRANSACTION_STATS_BUCKETS - 1 && ms >= (1u << bucket)) {
+		bucket++;
+	}
+	histogram->buckets[bucket]++;
+	histogram->count++;
+}
+
+int transaction_histogram_percentile(
+		const struct sway_transaction_histogram *histogram, double percentile) {
+	if (histogram->count == 0) {
+		return 0;
+	}
+	uint64_t rank = percentile * histogram->count;
+	if (rank < 1) {
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < TRANSACTION_STATS_BUCKETS - 1; ++i) {
+		seen += histogram->buckets[i];
+		if (seen >= rank) {
+			return 1 << i;
+		}
+	}
+	return -1;
+}
+
+static struct sway_transaction_client_stats *get_client_stats(
+		struct sway_view *view) {
+	const char *app_id = view_get_app_id(view);
+	if (!app_id) {
+		app_id = view_get_class(view);
+	}
+	if (!app_id) {
+		app_id = "unknown";
+	}
+
+	if (!stats.clients) {
+		stats.clients = create_list();
+		stats_clients_by_app_id = create_hashmap();
+	}
+	struct sway_transaction_client_stats *client =
+		hashmap_get(stats_clients_by_app_id, app_id);
+	if (client) {
+		return client;
+	}
+	if (stats.clients->length >= TRANSACTION_STATS_MAX_CLIENTS) {
+		app_id = "other";
+		client = hashmap_get(stats_clients_by_app_id, app_id);
+		if (client) {
+			return client;
+		}
+	}
+
+	client = calloc(1, sizeof(struct sway_transaction_client_stats));
+	if (!client) {
+		return NULL;
+	}
+	client->app_id = strdup(app_id);
+	list_add(stats.clients, client);
+	hashmap_set(stats_clients_by_app_id, app_id, client);
+	return client;
+}
+
+const struct sway_transaction_stats *transaction_get_stats(void) {
+	return &stats;
+}
+
+uint32_t transaction_client_deadline_ms(
+		const struct sway_transaction_client_stats *client) {
+	uint32_t timeout = server.txn_timeout_ms;
+	uint32_t deadline = timeout;
+	if (client && client->slow) {
+		deadline = TRANSACTION_DEADLINE_MIN_MS;
+	} else if (client && client->ack_latency_avg_ms > 0) {
+		deadline = 2 * client->ack_latency_avg_ms +
+			TRANSACTION_DEADLINE_SLACK_MS;
+		if (deadline < TRANSACTION_DEADLINE_MIN_MS) {
+			deadline = TRANSACTION_DEADLINE_MIN_MS;
+		}
+	}
+	return deadline < timeout ? deadline : timeout;
+}
+
+static void client_stats_add_ack(struct sway_transaction_client_stats *client,
+		float ms, bool in_time) {
+	histogram_add(&client->ack_latency, ms);
+	client->ack_latency_avg_ms = client->ack_latency_avg_ms > 0 ?
+		0.8f * client->ack_latency_avg_ms + 0.2f * ms : ms;
+	if (in_time) {
+		client->consecutive_misses = 0;
+		if (client->slow) {
+			sway_log(SWAY_DEBUG, "Client %s is responsive again",
+					client->app_id);
+			client->slow = false;
+		}
+	}
+}
+
+static void client_stats_add_miss(struct sway_transaction_client_stats *client) {
+	client->timeouts++;
+	if (++client->consecutive_misses >= TRANSACTION_SLOW_CLIENT_MISSES &&
+			!client->slow) {
+		sway_log(SWAY_INFO, "Client %s is slow to acknowledge configures, "
+				"no longer waiting for it", client->app_id);
+		client->slow = true;
+	}
+}
+
+// Returns zeroed memory, aligned for any type
+static void *transaction_arena_alloc(struct transaction_arena *arena,
+		size_t size) {
+	size_t align = sizeof(max_align_t);
+	size = (size + align - 1) / align * align;
+
+	struct transaction_arena_chunk *chunk = arena->chunks;
+	if (!chunk || chunk->used + size > chunk->size) {
+		size_t chunk_size = chunk ? chunk->size * 2 : TRANSACTION_ARENA_CHUNK_SIZE;
+		while (chunk_size < size) {
+			chunk_size *= 2;
+		}
+		if (spare_arena_chunk && spare_arena_chunk->size >= chunk_size) {
+			chunk = spare_arena_chunk;
+			spare_arena_chunk = NULL;
+		} else {
+			chunk = malloc(sizeof(struct transaction_arena_chunk) + chunk_size);
+			if (!chunk) {
+				return NULL;
+			}
+			chunk->size = chunk_size;
+		}
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	void *ptr = (char *)chunk->data + chunk->used;
+	chunk->used += size;
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+static void transaction_arena_finish(struct transaction_arena *arena) {
+	struct transaction_arena_chunk *chunk = arena->chunks;
+	while (chunk) {
+		struct transaction_arena_chunk *next = chunk->next;
+		if (!spare_arena_chunk || spare_arena_chunk->size < chunk->size) {
+			free(spare_arena_chunk);
+			spare_arena_chunk = chunk;
+		} else {
+			free(chunk);
+		}
+		chunk = next;
+	}
+	arena->chunks = NULL;
+}
+
+/**
+ * Copies a list into the transaction arena, with the items stored right after
+ * the list header. The copy must not be grown with list_add and friends.
+ */
+static list_t *transaction_snapshot_list(struct sway_transaction *transaction,
+		list_t *list) {
+	int length = list ? list->length : 0;
+	list_t *copy = transaction_arena_alloc(&transaction->arena,
+			sizeof(list_t) + length * sizeof(void *));
+	if (!sway_assert(copy, "Unable to allocate list snapshot")) {
+		return NULL;
+	}
+	copy->capacity = length;
+	copy->length = length;
+	copy->items = (void **)(copy + 1);
+	if (length > 0) {
+		memcpy(copy->items, list->items, length * sizeof(void *));
+	}
+	return copy;
+}
+
 static struct sway_transaction *transaction_create(void) {
 	struct sway_transaction *transaction =
 		calloc(1, sizeof(struct sway_transaction));
@@ -46,6 +283,8 @@ static struct sway_transaction *transaction_create(void) {
 		return NULL;
 	}
 	transaction->instructions = create_list();
+	transaction->affected_outputs = create_list();
+	pixman_region32_init(&transaction->affected_region);
 	return transaction;
 }
 
@@ -59,6 +298,9 @@ static void transaction_destroy(struct sway_transaction *transaction) {
 		if (node->instruction == instruction) {
 			node->instruction = NULL;
 		}
+		if (node->pending_instruction == instruction) {
+			node->pending_instruction = NULL;
+		}
 		if (node->destroying && node->ntxnrefs == 0) {
 			switch (node->type) {
 			case N_ROOT:
@@ -75,9 +317,11 @@ static void transaction_destroy(struct sway_transaction *transaction) {
 				break;
 			}
 		}
-		free(instruction);
 	}
 	list_free(transaction->instructions);
+	list_free(transaction->affected_outputs);
+	pixman_region32_fini(&transaction->affected_region);
+	transaction_arena_finish(&transaction->arena);
 
 	if (transaction->timer) {
 		wl_event_source_remove(transaction->timer);
@@ -88,12 +332,8 @@ static void transaction_destroy(struct sway_transaction *transaction) {
 static void copy_output_state(struct sway_output *output,
 		struct sway_transaction_instruction *instruction) {
 	struct sway_output_state *state = &instruction->output_state;
-	if (state->workspaces) {
-		state->workspaces->length = 0;
-	} else {
-		state->workspaces = create_list();
-	}
-	list_cat(state->workspaces, output->workspaces);
+	state->workspaces = transaction_snapshot_list(instruction->transaction,
+			output->workspaces);
 
 	state->active_workspace = output_get_active_workspace(output);
 }
@@ -110,18 +350,10 @@ static void copy_workspace_state(struct sway_workspace *ws,
 	state->layout = ws->layout;
 
 	state->output = ws->output;
-	if (state->floating) {
-		state->floating->length = 0;
-	} else {
-		state->floating = create_list();
-	}
-	if (state->tiling) {
-		state->tiling->length = 0;
-	} else {
-		state->tiling = create_list();
-	}
-	list_cat(state->floating, ws->floating);
-	list_cat(state->tiling, ws->tiling);
+	state->floating = transaction_snapshot_list(instruction->transaction,
+			ws->floating);
+	state->tiling = transaction_snapshot_list(instruction->transaction,
+			ws->tiling);
 
 	struct sway_seat *seat = input_manager_current_seat();
 	state->focused = seat_get_focus(seat) == &ws->node;
@@ -140,17 +372,13 @@ static void copy_container_state(struct sway_container *container,
 		struct sway_transaction_instruction *instruction) {
 	struct sway_container_state *state = &instruction->container_state;
 
-	if (state->children) {
-		list_free(state->children);
-	}
-
 	memcpy(state, &container->pending, sizeof(struct sway_container_state));
 
 	if (!container->view) {
 		// We store a copy of the child list to avoid having it mutated after
 		// we copy the state.
-		state->children = create_list();
-		list_cat(state->children, container->pending.children);
+		state->children = transaction_snapshot_list(instruction->transaction,
+				container->pending.children);
 	} else {
 		state->children = NULL;
 	}
@@ -171,19 +399,14 @@ static void transaction_add_node(struct sway_transaction *transaction,
 
 	// Check if we have an instruction for this node already, in which case we
 	// update that instead of creating a new one.
-	if (node->ntxnrefs > 0) {
-		for (int idx = 0; idx < transaction->instructions->length; idx++) {
-			struct sway_transaction_instruction *other =
-				transaction->instructions->items[idx];
-			if (other->node == node) {
-				instruction = other;
-				break;
-			}
-		}
+	if (node->pending_instruction &&
+			node->pending_instruction->transaction == transaction) {
+		instruction = node->pending_instruction;
 	}
 
 	if (!instruction) {
-		instruction = calloc(1, sizeof(struct sway_transaction_instruction));
+		instruction = transaction_arena_alloc(&transaction->arena,
+				sizeof(struct sway_transaction_instruction));
 		if (!sway_assert(instruction, "Unable to allocate instruction")) {
 			return;
 		}
@@ -193,6 +416,7 @@ static void transaction_add_node(struct sway_transaction *transaction,
 
 		list_add(transaction->instructions, instruction);
 		node->ntxnrefs++;
+		node->pending_instruction = instruction;
 	} else if (server_request) {
 		instruction->server_request = true;
 	}
@@ -212,17 +436,36 @@ static void transaction_add_node(struct sway_transaction *transaction,
 	}
 }
 
+/**
+ * The lists of an instruction state live in the transaction arena, so they
+ * are copied into lists owned by the node, reusing their storage.
+ */
+static list_t *apply_list(list_t *current, list_t *snapshot) {
+	if (!current) {
+		current = create_list();
+	}
+	current->length = 0;
+	if (snapshot) {
+		list_cat(current, snapshot);
+	}
+	return current;
+}
+
 static void apply_output_state(struct sway_output *output,
 		struct sway_output_state *state) {
-	list_free(output->current.workspaces);
+	list_t *workspaces =
+		apply_list(output->current.workspaces, state->workspaces);
 	memcpy(&output->current, state, sizeof(struct sway_output_state));
+	output->current.workspaces = workspaces;
 }
 
 static void apply_workspace_state(struct sway_workspace *ws,
 		struct sway_workspace_state *state) {
-	list_free(ws->current.floating);
-	list_free(ws->current.tiling);
+	list_t *floating = apply_list(ws->current.floating, state->floating);
+	list_t *tiling = apply_list(ws->current.tiling, state->tiling);
 	memcpy(&ws->current, state, sizeof(struct sway_workspace_state));
+	ws->current.floating = floating;
+	ws->current.tiling = tiling;
 }
 
 static void apply_container_state(struct sway_container *container,
@@ -230,12 +473,14 @@ static void apply_container_state(struct sway_container *container,
 	struct sway_view *view = container->view;
 	// There are separate children lists for each instruction state, the
 	// container's current state and the container's pending state
-	// (ie. con->children). The list itself needs to be freed here.
-	// Any child containers which are being deleted will be cleaned up in
-	// transaction_destroy().
-	list_free(container->current.children);
+	// (ie. con->children). The instruction's list lives in the transaction
+	// arena and is copied here. Any child containers which are being deleted
+	// will be cleaned up in transaction_destroy().
+	list_t *children = view ? NULL :
+		apply_list(container->current.children, state->children);
 
 	memcpy(&container->current, state, sizeof(struct sway_container_state));
+	container->current.children = children;
 
 	if (view) {
 		if (view->saved_surface_tree) {
@@ -565,6 +810,8 @@ static void disable_workspace(struct sway_workspace *ws) {
 }
 
 static void arrange_output(struct sway_output *output, int width, int height) {
+	hit_index_begin(&output->tiling_hits);
+
 	for (int i = 0; i < output->current.workspaces->length; i++) {
 		struct sway_workspace *child = output->current.workspaces->items[i];
 
@@ -605,6 +852,7 @@ static void arrange_output(struct sway_output *output, int width, int height) {
 				arrange_workspace_tiling(child,
 					area->width - gaps->left - gaps->right,
 					area->height - gaps->top - gaps->bottom);
+				hit_index_add_tiling(&output->tiling_hits, child->layers.tiling);
 			}
 		} else {
 			wlr_scene_node_set_enabled(&child->layers.tiling->node, false);
@@ -613,6 +861,8 @@ static void arrange_output(struct sway_output *output, int width, int height) {
 			disable_workspace(child);
 		}
 	}
+
+	hit_index_end(&output->tiling_hits);
 }
 
 void arrange_popups(struct wlr_scene_tree *popups) {
@@ -629,9 +879,43 @@ void arrange_popups(struct wlr_scene_tree *popups) {
 	}
 }
 
-static void arrange_root(struct sway_root *root) {
+static void arrange_root_output(struct sway_output *output) {
+	wlr_scene_output_set_position(output->scene_output, output->lx, output->ly);
+
+	wlr_scene_node_reparent(&output->layers.shell_background->node, root->layers.shell_background);
+	wlr_scene_node_reparent(&output->layers.shell_bottom->node, root->layers.shell_bottom);
+	wlr_scene_node_reparent(&output->layers.tiling->node, root->layers.tiling);
+	wlr_scene_node_reparent(&output->layers.shell_top->node, root->layers.shell_top);
+	wlr_scene_node_reparent(&output->layers.shell_overlay->node, root->layers.shell_overlay);
+	wlr_scene_node_reparent(&output->layers.fullscreen->node, root->layers.fullscreen);
+	wlr_scene_node_reparent(&output->layers.session_lock->node, root->layers.session_lock);
+
+	wlr_scene_node_set_position(&output->layers.shell_background->node, output->lx, output->ly);
+	wlr_scene_node_set_position(&output->layers.shell_bottom->node, output->lx, output->ly);
+	wlr_scene_node_set_position(&output->layers.tiling->node, output->lx, output->ly);
+	wlr_scene_node_set_position(&output->layers.fullscreen->node, output->lx, output->ly);
+	wlr_scene_node_set_position(&output->layers.shell_top->node, output->lx, output->ly);
+	wlr_scene_node_set_position(&output->layers.shell_overlay->node, output->lx, output->ly);
+	wlr_scene_node_set_position(&output->layers.session_lock->node, output->lx, output->ly);
+
+	arrange_output(output, output->width, output->height);
+}
+
+/**
+ * Arrange the scene for the current state of the tree. Only the outputs
+ * affected by the transaction are arranged, unless it affects everything.
+ */
+static void arrange_root(struct sway_root *root,
+		struct sway_transaction *transaction) {
 	struct sway_container *fs = root->fullscreen_global;
 
+	// A global fullscreen container spans all outputs, arrange everything
+	// while there is one and once after it's gone
+	if (fs || root->arranged_fullscreen_global) {
+		transaction->affects_all = true;
+	}
+	root->arranged_fullscreen_global = fs != NULL;
+
 	wlr_scene_node_set_enabled(&root->layers.shell_background->node, !fs);
 	wlr_scene_node_set_enabled(&root->layers.shell_bottom->node, !fs);
 	wlr_scene_node_set_enabled(&root->layers.tiling->node, !fs);
@@ -670,30 +954,98 @@ static void arrange_root(struct sway_root *root) {
 	} else {
 		for (int i = 0; i < root->outputs->length; i++) {
 			struct sway_output *output = root->outputs->items[i];
+			if (transaction->affects_all ||
+					list_find(transaction->affected_outputs, output) != -1) {
+				arrange_root_output(output);
+			}
+		}
+	}
 
-			wlr_scene_output_set_position(output->scene_output, output->lx, output->ly);
-
-			wlr_scene_node_reparent(&output->layers.shell_background->node, root->layers.shell_background);
-			wlr_scene_node_reparent(&output->layers.shell_bottom->node, root->layers.shell_bottom);
-			wlr_scene_node_reparent(&output->layers.tiling->node, root->layers.tiling);
-			wlr_scene_node_reparent(&output->layers.shell_top->node, root->layers.shell_top);
-			wlr_scene_node_reparent(&output->layers.shell_overlay->node, root->layers.shell_overlay);
-			wlr_scene_node_reparent(&output->layers.fullscreen->node, root->layers.fullscreen);
-			wlr_scene_node_reparent(&output->layers.session_lock->node, root->layers.session_lock);
+	arrange_popups(root->layers.popup);
+}
 
-			wlr_scene_node_set_position(&output->layers.shell_background->node, output->lx, output->ly);
-			wlr_scene_node_set_position(&output->layers.shell_bottom->node, output->lx, output->ly);
-			wlr_scene_node_set_position(&output->layers.tiling->node, output->lx, output->ly);
-			wlr_scene_node_set_position(&output->layers.fullscreen->node, output->lx, output->ly);
-			wlr_scene_node_set_position(&output->layers.shell_top->node, output->lx, output->ly);
-			wlr_scene_node_set_position(&output->layers.shell_overlay->node, output->lx, output->ly);
-			wlr_scene_node_set_position(&output->layers.session_lock->node, output->lx, output->ly);
+/**
+ * Describe the changes the transaction makes to the current state of the tree
+ * to IPC clients subscribed to tree_diff events.
+ */
+static void transaction_send_tree_diff(struct sway_transaction *transaction) {
+	if (!ipc_event_tree_diff_wanted()) {
+		return;
+	}
+	json_object *changes = json_object_new_array();
+	for (int i = 0; i < transaction->instructions->length; ++i) {
+		struct sway_transaction_instruction *instruction =
+			transaction->instructions->items[i];
+		struct sway_node *node = instruction->node;
 
-			arrange_output(output, output->width, output->height);
+		switch (node->type) {
+		case N_ROOT:
+			break;
+		case N_OUTPUT:
+			ipc_json_describe_output_diff(changes, node->sway_output,
+					&instruction->output_state);
+			break;
+		case N_WORKSPACE:
+			ipc_json_describe_workspace_diff(changes, node->sway_workspace,
+					&instruction->workspace_state);
+			break;
+		case N_CONTAINER:
+			ipc_json_describe_container_diff(changes, node->sway_container,
+					&instruction->container_state);
+			break;
 		}
 	}
+	ipc_event_tree_diff(changes);
+}
 
-	arrange_popups(root->layers.popup);
+static void transaction_add_affected_output(struct sway_transaction *transaction,
+		struct sway_output *output) {
+	if (!output || list_find(transaction->affected_outputs, output) != -1) {
+		return;
+	}
+	list_add(transaction->affected_outputs, output);
+	pixman_region32_union_rect(&transaction->affected_region,
+			&transaction->affected_region,
+			output->lx, output->ly, output->width, output->height);
+}
+
+/**
+ * Record the outputs and the area the node's current state touches. Called
+ * both before and after applying the instruction, so that whatever the node
+ * left is rearranged as well.
+ */
+static void transaction_add_affected(struct sway_transaction *transaction,
+		struct sway_transaction_instruction *instruction) {
+	struct sway_node *node = instruction->node;
+	switch (node->type) {
+	case N_ROOT:
+		transaction->affects_all = true;
+		break;
+	case N_OUTPUT:
+		transaction_add_affected_output(transaction, node->sway_output);
+		break;
+	case N_WORKSPACE:;
+		struct sway_workspace *ws = node->sway_workspace;
+		// Floating containers transient for a fullscreen container are
+		// raised above it, even on other outputs
+		if (ws->current.fullscreen != instruction->workspace_state.fullscreen) {
+			transaction->affects_all = true;
+		}
+		transaction_add_affected_output(transaction, ws->current.output);
+		break;
+	case N_CONTAINER:;
+		struct sway_container *con = node->sway_container;
+		if (con->current.workspace) {
+			transaction_add_affected_output(transaction,
+					con->current.workspace->current.output);
+		}
+		// Floating containers may overlap other outputs
+		pixman_region32_union_rect(&transaction->affected_region,
+				&transaction->affected_region,
+				floor(con->current.x), floor(con->current.y),
+				ceil(con->current.width), ceil(con->current.height));
+		break;
+	}
 }
 
 /**
@@ -701,22 +1053,24 @@ static void arrange_root(struct sway_root *root) {
  */
 static void transaction_apply(struct sway_transaction *transaction) {
 	sway_log(SWAY_DEBUG, "Applying transaction %p", transaction);
+	float ms = elapsed_ms(&transaction->commit_time);
+	stats.applied++;
+	histogram_add(&stats.latency, ms);
 	if (debug.txn_timings) {
-		struct timespec now;
-		clock_gettime(CLOCK_MONOTONIC, &now);
-		struct timespec *commit = &transaction->commit_time;
-		float ms = (now.tv_sec - commit->tv_sec) * 1000 +
-			(now.tv_nsec - commit->tv_nsec) / 1000000.0;
 		sway_log(SWAY_DEBUG, "Transaction %p: %.1fms waiting "
 				"(%.1f frames if 60Hz)", transaction, ms, ms / (1000.0f / 60));
 	}
 
+	transaction_send_tree_diff(transaction);
+
 	// Apply the instruction state to the node's current state
 	for (int i = 0; i < transaction->instructions->length; ++i) {
 		struct sway_transaction_instruction *instruction =
 			transaction->instructions->items[i];
 		struct sway_node *node = instruction->node;
 
+		transaction_add_affected(transaction, instruction);
+
 		switch (node->type) {
 		case N_ROOT:
 			break;
@@ -733,7 +1087,12 @@ static void transaction_apply(struct sway_transaction *transaction) {
 			break;
 		}
 
+		transaction_add_affected(transaction, instruction);
+
 		node->instruction = NULL;
+		// Disabled outputs are not part of the tree either
+		node->has_current = !node->destroying &&
+			(node->type != N_OUTPUT || node->sway_output->enabled);
 	}
 }
 
@@ -746,9 +1105,14 @@ static void transaction_progress(void) {
 	if (server.queued_transaction->num_waiting > 0) {
 		return;
 	}
-	transaction_apply(server.queued_transaction);
-	arrange_root(root);
-	cursor_rebase_all();
+	struct sway_transaction *transaction = server.queued_transaction;
+	transaction_apply(transaction);
+	arrange_root(root, transaction);
+	if (transaction->affects_all) {
+		cursor_rebase_all();
+	} else {
+		cursor_rebase_region(&transaction->affected_region);
+	}
 	transaction_destroy(server.queued_transaction);
 	server.queued_transaction = NULL;
 
@@ -760,11 +1124,71 @@ static void transaction_progress(void) {
 	transaction_commit_pending();
 }
 
+/**
+ * Returns the time in ms after the commit at which the next view still
+ * waited for misses its deadline.
+ */
+static uint32_t transaction_next_deadline(struct sway_transaction *transaction) {
+	uint32_t next = server.txn_timeout_ms;
+	for (int i = 0; i < transaction->instructions->length; ++i) {
+		struct sway_transaction_instruction *instruction =
+			transaction->instructions->items[i];
+		if (instruction->waiting && instruction->node->instruction == instruction &&
+				instruction->deadline_ms < next) {
+			next = instruction->deadline_ms;
+		}
+	}
+	return next;
+}
+
+static void transaction_arm_timer(struct sway_transaction *transaction) {
+	float elapsed = elapsed_ms(&transaction->commit_time);
+	float delay = transaction_next_deadline(transaction) - elapsed;
+	// A delay of 0 would disarm the timer
+	wl_event_source_timer_update(transaction->timer, delay >= 1 ? delay : 1);
+}
+
 static int handle_timeout(void *data) {
 	struct sway_transaction *transaction = data;
-	sway_log(SWAY_DEBUG, "Transaction %p timed out (%zi waiting)",
-			transaction, transaction->num_waiting);
-	transaction->num_waiting = 0;
+	float elapsed = elapsed_ms(&transaction->commit_time);
+
+	// Stop waiting for the views which missed their deadline. They keep
+	// showing their current buffer, centered and clipped, once the rest of
+	// the transaction is applied.
+	size_t missed = 0;
+	for (int i = 0; i < transaction->instructions->length; ++i) {
+		struct sway_transaction_instruction *instruction =
+			transaction->instructions->items[i];
+		struct sway_node *node = instruction->node;
+		if (!instruction->waiting || node->instruction != instruction ||
+				instruction->deadline_ms > elapsed + 1) {
+			continue;
+		}
+		instruction->waiting = false;
+		if (transaction->num_waiting > 0) {
+			transaction->num_waiting--;
+		}
+		if (instruction->client) {
+			client_stats_add_miss(instruction->client);
+		}
+		missed++;
+	}
+	if (missed > 0 && !transaction->timed_out) {
+		transaction->timed_out = true;
+		stats.timed_out++;
+	}
+
+	if (elapsed + 1 >= server.txn_timeout_ms) {
+		// Also covers the counter inflated by debug.txn_wait
+		transaction->num_waiting = 0;
+	}
+	sway_log(SWAY_DEBUG, "Transaction %p: %zu views missed their deadline "
+			"(%zi waiting)", transaction, missed, transaction->num_waiting);
+
+	if (transaction->num_waiting > 0) {
+		transaction_arm_timer(transaction);
+		return 0;
+	}
 	transaction_progress();
 	return 0;
 }
@@ -822,6 +1246,14 @@ static void transaction_commit(struct sway_transaction *transaction) {
 			if (!hidden) {
 				instruction->waiting = true;
 				++transaction->num_waiting;
+
+				instruction->client =
+					get_client_stats(node->sway_container->view);
+				if (instruction->client) {
+					instruction->client->configures++;
+				}
+				instruction->deadline_ms =
+					transaction_client_deadline_ms(instruction->client);
 			}
 
 			view_send_frame_done(node->sway_container->view);
@@ -833,9 +1265,8 @@ static void transaction_commit(struct sway_transaction *transaction) {
 		node->instruction = instruction;
 	}
 	transaction->num_configures = transaction->num_waiting;
-	if (debug.txn_timings) {
-		clock_gettime(CLOCK_MONOTONIC, &transaction->commit_time);
-	}
+	clock_gettime(CLOCK_MONOTONIC, &transaction->commit_time);
+	stats.committed++;
 	if (debug.noatomic) {
 		transaction->num_waiting = 0;
 	} else if (debug.txn_wait) {
@@ -849,8 +1280,7 @@ static void transaction_commit(struct sway_transaction *transaction) {
 		transaction->timer = wl_event_loop_add_timer(server.wl_event_loop,
 				handle_timeout, transaction);
 		if (transaction->timer) {
-			wl_event_source_timer_update(transaction->timer,
-					server.txn_timeout_ms);
+			transaction_arm_timer(transaction);
 		} else {
 			sway_log_errno(SWAY_ERROR, "Unable to create transaction timer "
 					"(some imperfect frames might be rendered)");
@@ -873,13 +1303,14 @@ static void transaction_commit_pending(void) {
 static void set_instruction_ready(
 		struct sway_transaction_instruction *instruction) {
 	struct sway_transaction *transaction = instruction->transaction;
+	float ms = elapsed_ms(&transaction->commit_time);
+
+	// Acks arriving after the deadline still tell how slow the client is
+	if (instruction->client) {
+		client_stats_add_ack(instruction->client, ms, instruction->waiting);
+	}
 
 	if (debug.txn_timings) {
-		struct timespec now;
-		clock_gettime(CLOCK_MONOTONIC, &now);
-		struct timespec *start = &transaction->commit_time;
-		float ms = (now.tv_sec - start->tv_sec) * 1000 +
-			(now.tv_nsec - start->tv_nsec) / 1000000.0;
 		sway_log(SWAY_DEBUG, "Transaction %p: %zi/%zi ready in %.1fms (%s)",
 				transaction,
 				transaction->num_configures - transaction->num_waiting + 1,
@@ -936,6 +1367,20 @@ static void _transaction_commit_dirty(bool server_request) {
 		}
 	}
 
+	// Rebuild the titles and representations outdated by this batch of
+	// changes, once per node
+	for (int i = 0; i < server.dirty_nodes->length; ++i) {
+		struct sway_node *node = server.dirty_nodes->items[i];
+		if (node->destroying) {
+			continue;
+		}
+		if (node->type == N_CONTAINER) {
+			container_flush_representation(node->sway_container);
+		} else if (node->type == N_WORKSPACE) {
+			workspace_flush_representation(node->sway_workspace);
+		}
+	}
+
 	for (int i = 0; i < server.dirty_nodes->length; ++i) {
 		struct sway_node *node = server.dirty_nodes->items[i];
 		transaction_add_node(server.pending_transaction, node, server_request);
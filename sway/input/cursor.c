@@ -51,6 +51,37 @@ void sway_cursor_warp(struct sway_cursor *cursor, double x, double y) {
 		(int)round(cursor->y));
 }
 
+/**
+ * Hit test the tiling layer, using the index of each output that has one
+ * instead of walking all of its scene nodes.
+ */
+static struct wlr_scene_node *tiling_node_at(double lx, double ly,
+		double *sx, double *sy) {
+	struct wlr_scene_tree *tiling = root->layers.tiling;
+	if (!tiling->node.enabled) {
+		return NULL;
+	}
+
+	struct wlr_scene_node *node;
+	wl_list_for_each_reverse(node, &tiling->children, link) {
+		if (!node->enabled) {
+			continue;
+		}
+		struct sway_output *output =
+			scene_descriptor_try_get(node, SWAY_SCENE_DESC_OUTPUT);
+		struct wlr_scene_node *hit;
+		if (output && output->enabled && output->tiling_hits.valid) {
+			hit = hit_index_node_at(&output->tiling_hits, lx, ly, sx, sy);
+		} else {
+			hit = wlr_scene_node_at(node, lx, ly, sx, sy);
+		}
+		if (hit) {
+			return hit;
+		}
+	}
+	return NULL;
+}
+
 /**
  * Returns the node at the cursor's position. If there is a surface at that
  * location, it is stored in **surface (it may not be a view).
@@ -70,7 +101,11 @@ struct sway_node *node_at_coords(
 			continue;
 		}
 
-		scene_node = wlr_scene_node_at(&layer->node, lx, ly, sx, sy);
+		if (layer == root->layers.tiling) {
+			scene_node = tiling_node_at(lx, ly, sx, sy);
+		} else {
+			scene_node = wlr_scene_node_at(&layer->node, lx, ly, sx, sy);
+		}
 		if (scene_node) {
 			break;
 		}
@@ -92,41 +127,29 @@ struct sway_node *node_at_coords(
 		// determine what container we clicked on
 		struct wlr_scene_node *current = scene_node;
 		while (true) {
-			struct sway_container *con = scene_descriptor_try_get(current,
-				SWAY_SCENE_DESC_CONTAINER);
-
-			if (!con) {
-				struct sway_view *view = scene_descriptor_try_get(current,
-					SWAY_SCENE_DESC_VIEW);
-				if (view) {
+			enum sway_scene_descriptor_type type;
+			void *data;
+			if (scene_descriptor_try_get_hit(current, &type, &data)) {
+				struct sway_container *con = NULL;
+				if (type == SWAY_SCENE_DESC_CONTAINER) {
+					con = data;
+				} else if (type == SWAY_SCENE_DESC_VIEW) {
+					struct sway_view *view = data;
 					con = view->container;
+				} else if (type == SWAY_SCENE_DESC_POPUP) {
+					struct sway_popup_desc *popup = data;
+					con = popup->view ? popup->view->container : NULL;
+				} else {
+					// We don't want to feed through the current workspace on
+					// layer shells or unmanaged xwayland surfaces
+					return NULL;
 				}
-			}
 
-			if (!con) {
-				struct sway_popup_desc *popup =
-					scene_descriptor_try_get(current, SWAY_SCENE_DESC_POPUP);
-				if (popup && popup->view) {
-					con = popup->view->container;
+				if (con && (!con->view || con->view->surface)) {
+					return &con->node;
 				}
 			}
 
-			if (con && (!con->view || con->view->surface)) {
-				return &con->node;
-			}
-
-			if (scene_descriptor_try_get(current, SWAY_SCENE_DESC_LAYER_SHELL)) {
-				// We don't want to feed through the current workspace on
-				// layer shells
-				return NULL;
-			}
-
-#if WLR_HAS_XWAYLAND
-			if (scene_descriptor_try_get(current, SWAY_SCENE_DESC_XWAYLAND_UNMANAGED)) {
-				return NULL;
-			}
-#endif
-
 			if (!current->parent) {
 				break;
 			}
@@ -172,6 +195,21 @@ void cursor_rebase_all(void) {
 	}
 }
 
+void cursor_rebase_region(const pixman_region32_t *region) {
+	if (!root->outputs->length || !pixman_region32_not_empty(region)) {
+		return;
+	}
+
+	struct sway_seat *seat;
+	wl_list_for_each(seat, &server.input->seats, link) {
+		struct wlr_cursor *wlr_cursor = seat->cursor->cursor;
+		if (pixman_region32_contains_point(region,
+				floor(wlr_cursor->x), floor(wlr_cursor->y), NULL)) {
+			cursor_rebase(seat->cursor);
+		}
+	}
+}
+
 void cursor_update_image(struct sway_cursor *cursor,
 		struct sway_node *node) {
 	if (node && node->type == N_CONTAINER) {
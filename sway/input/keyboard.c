@@ -152,107 +152,364 @@ static bool update_shortcut_state(struct sway_shortcut_state *state,
 }
 
 /**
- * If one exists, finds a binding which matches the shortcut model state,
- * current modifiers, release state, and locked state.
+ * The properties of a binding which must match the shortcut state exactly
+ * for the binding to be considered at all.
  */
-static void get_active_binding(const struct sway_shortcut_state *state,
-		list_t *bindings, struct sway_binding **current_binding,
-		uint32_t modifiers, bool release, bool locked, bool inhibited,
-		const char *input, bool exact_input, xkb_layout_index_t group) {
+struct binding_index_key {
+	uint32_t modifiers;
+	uint32_t first_key;
+	size_t nkeys;
+	bool release;
+	bool keycode;
+};
+
+struct binding_index_entry {
+	struct binding_index_key key;
+	int position; // in the mode's keysym or keycode binding list
+	struct sway_binding *binding;
+	const char *input; // interned in sway_binding_index::inputs
+};
+
+/**
+ * A run of entries sharing the same key, in binding list order.
+ */
+struct binding_index_bucket {
+	struct binding_index_key key;
+	size_t start, len;
+};
+
+struct sway_binding_index {
+	struct binding_index_entry *entries;
+	size_t entries_len;
+	struct binding_index_bucket *buckets; // open addressing, len 0 if unused
+	size_t buckets_cap; // power of two
+	list_t *inputs; // distinct binding inputs, borrowed from the bindings
+	const char *wildcard; // the interned "*", if any binding uses it
+};
+
+static int binding_index_key_cmp(const struct binding_index_key *a,
+		const struct binding_index_key *b) {
+	if (a->keycode != b->keycode) {
+		return a->keycode ? 1 : -1;
+	}
+	if (a->release != b->release) {
+		return a->release ? 1 : -1;
+	}
+	if (a->modifiers != b->modifiers) {
+		return a->modifiers < b->modifiers ? -1 : 1;
+	}
+	if (a->nkeys != b->nkeys) {
+		return a->nkeys < b->nkeys ? -1 : 1;
+	}
+	if (a->first_key != b->first_key) {
+		return a->first_key < b->first_key ? -1 : 1;
+	}
+	return 0;
+}
+
+static int binding_index_entry_qsort_cmp(const void *a, const void *b) {
+	const struct binding_index_entry *entry_a = a, *entry_b = b;
+	int cmp = binding_index_key_cmp(&entry_a->key, &entry_b->key);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return entry_a->position - entry_b->position;
+}
+
+static size_t binding_index_key_hash(const struct binding_index_key *key) {
+	uint64_t hash = key->first_key;
+	hash = hash * 31 + key->modifiers;
+	hash = hash * 31 + key->nkeys;
+	hash = hash * 4 + (key->release ? 2 : 0) + (key->keycode ? 1 : 0);
+	// Finalizer from MurmurHash3 to spread the low entropy fields
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static const struct binding_index_bucket *binding_index_find(
+		const struct sway_binding_index *index,
+		const struct binding_index_key *key) {
+	size_t mask = index->buckets_cap - 1;
+	for (size_t i = binding_index_key_hash(key) & mask;; i = (i + 1) & mask) {
+		const struct binding_index_bucket *bucket = &index->buckets[i];
+		if (bucket->len == 0) {
+			return NULL;
+		}
+		if (binding_index_key_cmp(&bucket->key, key) == 0) {
+			return bucket;
+		}
+	}
+}
+
+/**
+ * Return the interned copy of an input identifier, or NULL if no binding of
+ * the index refers to it.
+ */
+static const char *binding_index_get_input(
+		const struct sway_binding_index *index, const char *input) {
+	if (!index) {
+		return NULL;
+	}
+	for (int i = 0; i < index->inputs->length; ++i) {
+		if (strcmp(index->inputs->items[i], input) == 0) {
+			return index->inputs->items[i];
+		}
+	}
+	return NULL;
+}
+
+static void binding_index_add_list(struct sway_binding_index *index,
+		list_t *bindings, bool keycode) {
 	for (int i = 0; i < bindings->length; ++i) {
 		struct sway_binding *binding = bindings->items[i];
-		bool binding_locked = (binding->flags & BINDING_LOCKED) != 0;
-		bool binding_inhibited = (binding->flags & BINDING_INHIBITED) != 0;
-		bool binding_release = binding->flags & BINDING_RELEASE;
-
-		if (modifiers ^ binding->modifiers ||
-				release != binding_release ||
-				locked > binding_locked ||
-				inhibited > binding_inhibited ||
-				(binding->group != XKB_LAYOUT_INVALID &&
-				 binding->group != group) ||
-				(strcmp(binding->input, input) != 0 &&
-				 (strcmp(binding->input, "*") != 0 || exact_input))) {
-			continue;
+		if (binding->keys->length > SWAY_KEYBOARD_PRESSED_KEYS_CAP) {
+			continue; // there can never be that many pressed keys
 		}
 
-		bool match = false;
-		if (state->npressed == (size_t)binding->keys->length) {
-			match = true;
-			for (size_t j = 0; j < state->npressed; j++) {
-				uint32_t key = *(uint32_t *)binding->keys->items[j];
-				if (key != state->pressed_keys[j]) {
-					match = false;
-					break;
-				}
+		const char *input = binding_index_get_input(index, binding->input);
+		if (!input) {
+			input = binding->input;
+			list_add(index->inputs, binding->input);
+			if (strcmp(input, "*") == 0) {
+				index->wildcard = input;
 			}
-		} else if (binding->keys->length == 1) {
-			/*
-			 * If no multiple-key binding has matched, try looking for
-			 * single-key bindings that match the newly-pressed key.
-			 */
-			match = state->current_key == *(uint32_t *)binding->keys->items[0];
 		}
-		if (!match) {
-			continue;
+
+		struct binding_index_entry *entry =
+			&index->entries[index->entries_len++];
+		entry->key = (struct binding_index_key){
+			.modifiers = binding->modifiers,
+			.first_key = binding->keys->length > 0 ?
+				*(uint32_t *)binding->keys->items[0] : 0,
+			.nkeys = binding->keys->length,
+			.release = (binding->flags & BINDING_RELEASE) != 0,
+			.keycode = keycode,
+		};
+		entry->position = i;
+		entry->binding = binding;
+		entry->input = input;
+	}
+}
+
+static void binding_index_destroy(struct sway_binding_index *index) {
+	if (!index) {
+		return;
+	}
+	free(index->entries);
+	free(index->buckets);
+	list_free(index->inputs);
+	free(index);
+}
+
+static struct sway_binding_index *binding_index_create(struct sway_mode *mode) {
+	struct sway_binding_index *index =
+		calloc(1, sizeof(struct sway_binding_index));
+	if (!index) {
+		return NULL;
+	}
+	size_t len = mode->keysym_bindings->length +
+		mode->keycode_bindings->length;
+	index->entries = calloc(len > 0 ? len : 1,
+			sizeof(struct binding_index_entry));
+	index->inputs = create_list();
+	index->buckets_cap = 8;
+	while (index->buckets_cap < len * 2) {
+		index->buckets_cap *= 2;
+	}
+	index->buckets = calloc(index->buckets_cap,
+			sizeof(struct binding_index_bucket));
+	if (!index->entries || !index->inputs || !index->buckets) {
+		binding_index_destroy(index);
+		return NULL;
+	}
+
+	binding_index_add_list(index, mode->keysym_bindings, false);
+	binding_index_add_list(index, mode->keycode_bindings, true);
+	qsort(index->entries, index->entries_len,
+			sizeof(struct binding_index_entry), binding_index_entry_qsort_cmp);
+
+	size_t mask = index->buckets_cap - 1;
+	for (size_t start = 0, end; start < index->entries_len; start = end) {
+		const struct binding_index_key *key = &index->entries[start].key;
+		end = start + 1;
+		while (end < index->entries_len &&
+				binding_index_key_cmp(&index->entries[end].key, key) == 0) {
+			++end;
 		}
 
-		if (*current_binding) {
-			if (*current_binding == binding) {
-				continue;
-			}
+		size_t i = binding_index_key_hash(key) & mask;
+		while (index->buckets[i].len != 0) {
+			i = (i + 1) & mask;
+		}
+		index->buckets[i].key = *key;
+		index->buckets[i].start = start;
+		index->buckets[i].len = end - start;
+	}
 
-			bool current_locked =
-				((*current_binding)->flags & BINDING_LOCKED) != 0;
-			bool current_inhibited =
-				((*current_binding)->flags & BINDING_INHIBITED) != 0;
-			bool current_input = strcmp((*current_binding)->input, input) == 0;
-			bool current_group_set =
-				(*current_binding)->group != XKB_LAYOUT_INVALID;
-			bool binding_input = strcmp(binding->input, input) == 0;
-			bool binding_group_set = binding->group != XKB_LAYOUT_INVALID;
-
-			if (current_input == binding_input
-					&& current_locked == binding_locked
-					&& current_inhibited == binding_inhibited
-					&& current_group_set == binding_group_set) {
-				sway_log(SWAY_DEBUG,
-						"Encountered conflicting bindings %d and %d",
-						(*current_binding)->order, binding->order);
-				continue;
-			}
+	sway_log(SWAY_DEBUG, "Indexed %zu bindings of mode '%s' (%d inputs)",
+			index->entries_len, mode->name, index->inputs->length);
+	return index;
+}
 
-			if (current_input && !binding_input) {
-				continue; // Prefer the correct input
-			}
+static struct sway_binding_index *mode_get_binding_index(
+		struct sway_mode *mode) {
+	if (!mode->binding_index) {
+		mode->binding_index = binding_index_create(mode);
+		if (!mode->binding_index) {
+			sway_log(SWAY_ERROR, "Unable to allocate binding index");
+		}
+	}
+	return mode->binding_index;
+}
 
-			if (current_input == binding_input &&
-				   (*current_binding)->group == group) {
-				continue; // Prefer correct group for matching inputs
-			}
+void sway_keyboard_invalidate_binding_index(struct sway_mode *mode) {
+	binding_index_destroy(mode->binding_index);
+	mode->binding_index = NULL;
+}
 
-			if (current_input == binding_input &&
-					current_group_set == binding_group_set &&
-					current_locked == locked) {
-				continue; // Prefer correct lock state for matching input+group
+/**
+ * Check a single candidate binding against the current best match.
+ *
+ * Returns true if the candidate is a perfect match and searching can stop.
+ */
+static bool consider_binding(const struct sway_shortcut_state *state,
+		const struct sway_binding_index *index,
+		const struct binding_index_entry *entry,
+		const struct binding_index_entry **current_binding,
+		bool locked, bool inhibited, const char *input, bool exact_input,
+		xkb_layout_index_t group) {
+	struct sway_binding *binding = entry->binding;
+	bool binding_locked = (binding->flags & BINDING_LOCKED) != 0;
+	bool binding_inhibited = (binding->flags & BINDING_INHIBITED) != 0;
+
+	if (locked > binding_locked ||
+			inhibited > binding_inhibited ||
+			(binding->group != XKB_LAYOUT_INVALID &&
+			 binding->group != group) ||
+			(entry->input != input &&
+			 (entry->input != index->wildcard || exact_input))) {
+		return false;
+	}
+
+	if (state->npressed == (size_t)binding->keys->length) {
+		// The first key already matched through the index
+		for (size_t j = 1; j < state->npressed; j++) {
+			uint32_t key = *(uint32_t *)binding->keys->items[j];
+			if (key != state->pressed_keys[j]) {
+				return false;
 			}
+		}
+	}
 
-			if (current_input == binding_input &&
-					current_group_set == binding_group_set &&
-					current_locked == binding_locked &&
-					current_inhibited == inhibited) {
-				// Prefer correct inhibition state for matching
-				// input+group+locked
-				continue;
-			}
+	if (*current_binding) {
+		if (*current_binding == entry) {
+			return false;
+		}
+
+		struct sway_binding *current = (*current_binding)->binding;
+		bool current_locked = (current->flags & BINDING_LOCKED) != 0;
+		bool current_inhibited = (current->flags & BINDING_INHIBITED) != 0;
+		bool current_input = (*current_binding)->input == input;
+		bool current_group_set = current->group != XKB_LAYOUT_INVALID;
+		bool binding_input = entry->input == input;
+		bool binding_group_set = binding->group != XKB_LAYOUT_INVALID;
+
+		if (current_input == binding_input
+				&& current_locked == binding_locked
+				&& current_inhibited == binding_inhibited
+				&& current_group_set == binding_group_set) {
+			sway_log(SWAY_DEBUG,
+					"Encountered conflicting bindings %d and %d",
+					current->order, binding->order);
+			return false;
 		}
 
-		*current_binding = binding;
-		if (strcmp((*current_binding)->input, input) == 0 &&
-				(((*current_binding)->flags & BINDING_LOCKED) == locked) &&
-				(((*current_binding)->flags & BINDING_INHIBITED) == inhibited) &&
-				(*current_binding)->group == group) {
-			return; // If a perfect match is found, quit searching
+		if (current_input && !binding_input) {
+			return false; // Prefer the correct input
+		}
+
+		if (current_input == binding_input &&
+				current->group == group) {
+			return false; // Prefer correct group for matching inputs
+		}
+
+		if (current_input == binding_input &&
+				current_group_set == binding_group_set &&
+				current_locked == locked) {
+			return false; // Prefer correct lock state for matching input+group
+		}
+
+		if (current_input == binding_input &&
+				current_group_set == binding_group_set &&
+				current_locked == binding_locked &&
+				current_inhibited == inhibited) {
+			// Prefer correct inhibition state for matching
+			// input+group+locked
+			return false;
+		}
+	}
+
+	*current_binding = entry;
+	// If a perfect match is found, quit searching
+	return entry->input == input &&
+		((binding->flags & BINDING_LOCKED) == locked) &&
+		((binding->flags & BINDING_INHIBITED) == inhibited) &&
+		binding->group == group;
+}
+
+/**
+ * If one exists, finds a binding which matches the shortcut model state,
+ * current modifiers, release state, and locked state.
+ *
+ * `input` must have been interned with binding_index_get_input.
+ */
+static void get_active_binding(const struct sway_shortcut_state *state,
+		const struct sway_binding_index *index, bool keycode,
+		const struct binding_index_entry **current_binding,
+		uint32_t modifiers, bool release, bool locked, bool inhibited,
+		const char *input, bool exact_input, xkb_layout_index_t group) {
+	if (!index) {
+		return;
+	}
+
+	// Bindings with all keys pressed
+	struct binding_index_key key = {
+		.modifiers = modifiers,
+		.first_key = state->npressed > 0 ? state->pressed_keys[0] : 0,
+		.nkeys = state->npressed,
+		.release = release,
+		.keycode = keycode,
+	};
+	const struct binding_index_bucket *all = binding_index_find(index, &key);
+
+	// If no multiple-key binding matches, single-key bindings can still
+	// match the newly-pressed key
+	const struct binding_index_bucket *single = NULL;
+	if (state->npressed != 1) {
+		key.first_key = state->current_key;
+		key.nkeys = 1;
+		single = binding_index_find(index, &key);
+	}
+
+	// The priority rules depend on the binding list order, so merge both
+	// candidate runs back into it
+	size_t all_len = all ? all->len : 0;
+	size_t single_len = single ? single->len : 0;
+	size_t i = 0, j = 0;
+	while (i < all_len || j < single_len) {
+		const struct binding_index_entry *entry;
+		if (j == single_len || (i < all_len &&
+				index->entries[all->start + i].position <
+				index->entries[single->start + j].position)) {
+			entry = &index->entries[all->start + i++];
+		} else {
+			entry = &index->entries[single->start + j++];
+		}
+		if (consider_binding(state, index, entry, current_binding, locked,
+				inhibited, input, exact_input, group)) {
+			return;
 		}
 	}
 }
@@ -454,22 +711,24 @@ static void handle_key_event(struct sway_keyboard *keyboard,
 
 	bool handled = false;
 	// Identify active release binding
-	struct sway_binding *binding_released = NULL;
-	get_active_binding(&keyboard->state_keycodes,
-			config->current_mode->keycode_bindings, &binding_released,
-			keyinfo.code_modifiers, true, locked,
-			shortcuts_inhibited, device_identifier,
+	struct sway_binding_index *index =
+		mode_get_binding_index(config->current_mode);
+	const char *input = binding_index_get_input(index, device_identifier);
+	const struct binding_index_entry *released_entry = NULL;
+	get_active_binding(&keyboard->state_keycodes, index, true,
+			&released_entry, keyinfo.code_modifiers, true, locked,
+			shortcuts_inhibited, input,
 			exact_identifier, keyboard->effective_layout);
-	get_active_binding(&keyboard->state_keysyms_raw,
-			config->current_mode->keysym_bindings, &binding_released,
-			keyinfo.raw_modifiers, true, locked,
-			shortcuts_inhibited, device_identifier,
+	get_active_binding(&keyboard->state_keysyms_raw, index, false,
+			&released_entry, keyinfo.raw_modifiers, true, locked,
+			shortcuts_inhibited, input,
 			exact_identifier, keyboard->effective_layout);
-	get_active_binding(&keyboard->state_keysyms_translated,
-			config->current_mode->keysym_bindings, &binding_released,
-			keyinfo.translated_modifiers, true, locked,
-			shortcuts_inhibited, device_identifier,
+	get_active_binding(&keyboard->state_keysyms_translated, index, false,
+			&released_entry, keyinfo.translated_modifiers, true, locked,
+			shortcuts_inhibited, input,
 			exact_identifier, keyboard->effective_layout);
+	struct sway_binding *binding_released =
+		released_entry ? released_entry->binding : NULL;
 
 	// Execute stored release binding once no longer active
 	if (keyboard->held_binding && binding_released != keyboard->held_binding &&
@@ -485,24 +744,22 @@ static void handle_key_event(struct sway_keyboard *keyboard,
 	}
 
 	// Identify and execute active pressed binding
-	struct sway_binding *binding = NULL;
+	const struct binding_index_entry *entry = NULL;
 	if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-		get_active_binding(&keyboard->state_keycodes,
-				config->current_mode->keycode_bindings, &binding,
-				keyinfo.code_modifiers, false, locked,
-				shortcuts_inhibited, device_identifier,
+		get_active_binding(&keyboard->state_keycodes, index, true,
+				&entry, keyinfo.code_modifiers, false, locked,
+				shortcuts_inhibited, input,
 				exact_identifier, keyboard->effective_layout);
-		get_active_binding(&keyboard->state_keysyms_raw,
-				config->current_mode->keysym_bindings, &binding,
-				keyinfo.raw_modifiers, false, locked,
-				shortcuts_inhibited, device_identifier,
+		get_active_binding(&keyboard->state_keysyms_raw, index, false,
+				&entry, keyinfo.raw_modifiers, false, locked,
+				shortcuts_inhibited, input,
 				exact_identifier, keyboard->effective_layout);
-		get_active_binding(&keyboard->state_keysyms_translated,
-				config->current_mode->keysym_bindings, &binding,
-				keyinfo.translated_modifiers, false, locked,
-				shortcuts_inhibited, device_identifier,
+		get_active_binding(&keyboard->state_keysyms_translated, index, false,
+				&entry, keyinfo.translated_modifiers, false, locked,
+				shortcuts_inhibited, input,
 				exact_identifier, keyboard->effective_layout);
 	}
+	struct sway_binding *binding = entry ? entry->binding : NULL;
 
 	// Set up (or clear) keyboard repeat for a pressed binding. Since the
 	// binding may remove the keyboard, the timer needs to be updated first
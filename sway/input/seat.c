@@ -51,6 +51,7 @@ static void seat_device_destroy(struct sway_seat_device *seat_device) {
 static void seat_node_destroy(struct sway_seat_node *seat_node) {
 	wl_list_remove(&seat_node->destroy.link);
 	wl_list_remove(&seat_node->link);
+	wl_list_remove(&seat_node->node_link);
 
 	/*
 	 * This is the only time we remove items from the focus stack without
@@ -206,6 +207,80 @@ static void seat_send_focus(struct sway_node *node, struct sway_seat *seat) {
 	}
 }
 
+static struct sway_seat_node *seat_node_try_get(struct sway_seat *seat,
+		struct sway_node *node) {
+	struct sway_seat_node *seat_node;
+	wl_list_for_each(seat_node, &node->seat_nodes, node_link) {
+		if (seat_node->seat == seat) {
+			return seat_node;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Returns whichever of best and the node's seat node was focused more recently.
+ */
+static struct sway_seat_node *seat_node_most_recent(struct sway_seat *seat,
+		struct sway_node *node, struct sway_seat_node *best) {
+	struct sway_seat_node *seat_node = seat_node_try_get(seat, node);
+	if (seat_node && (!best || seat_node->focus_order > best->focus_order)) {
+		return seat_node;
+	}
+	return best;
+}
+
+/**
+ * Finds the most recently focused container among the given containers and
+ * their descendants, by comparing their positions in the focus stack. This
+ * only visits the subtree instead of the whole focus stack.
+ */
+static struct sway_seat_node *seat_get_most_recent(struct sway_seat *seat,
+		list_t *containers, bool views_only, bool descend,
+		struct sway_seat_node *best) {
+	for (int i = 0; i < containers->length; ++i) {
+		struct sway_container *con = containers->items[i];
+		struct sway_seat_node *seat_node = seat_node_try_get(seat, &con->node);
+		if (seat_node && (!views_only || con->view) &&
+				(!best || seat_node->focus_order > best->focus_order)) {
+			best = seat_node;
+		}
+		if (descend && con->pending.children) {
+			best = seat_get_most_recent(seat, con->pending.children,
+					views_only, descend, best);
+		}
+	}
+	return best;
+}
+
+static struct sway_seat_node *seat_get_most_recent_descendant(
+		struct sway_seat *seat, struct sway_node *ancestor, bool views_only) {
+	// The answer is usually near the top of the focus stack
+	int limit = 8;
+	struct sway_seat_node *current;
+	wl_list_for_each(current, &seat->focus_stack, link) {
+		if (limit-- == 0) {
+			break;
+		}
+		if ((!views_only || node_is_view(current->node)) &&
+				node_has_ancestor(current->node, ancestor)) {
+			return current;
+		}
+	}
+
+	struct sway_seat_node *best = NULL;
+	if (ancestor->type == N_WORKSPACE) {
+		struct sway_workspace *ws = ancestor->sway_workspace;
+		best = seat_get_most_recent(seat, ws->tiling, views_only, true, best);
+		best = seat_get_most_recent(seat, ws->floating, views_only, true, best);
+	} else if (ancestor->type == N_CONTAINER &&
+			ancestor->sway_container->pending.children) {
+		best = seat_get_most_recent(seat,
+				ancestor->sway_container->pending.children, views_only, true, best);
+	}
+	return best;
+}
+
 void seat_for_each_node(struct sway_seat *seat,
 		void (*f)(struct sway_node *node, void *data), void *data) {
 	struct sway_seat_node *current = NULL;
@@ -219,6 +294,11 @@ struct sway_container *seat_get_focus_inactive_view(struct sway_seat *seat,
 	if (node_is_view(ancestor)) {
 		return ancestor->sway_container;
 	}
+	if (ancestor->type == N_WORKSPACE || ancestor->type == N_CONTAINER) {
+		struct sway_seat_node *best =
+			seat_get_most_recent_descendant(seat, ancestor, true);
+		return best ? best->node->sway_container : NULL;
+	}
 	struct sway_seat_node *current;
 	wl_list_for_each(current, &seat->focus_stack, link) {
 		struct sway_node *node = current->node;
@@ -322,6 +402,16 @@ static void handle_seat_node_destroy(struct wl_listener *listener, void *data) {
 	}
 }
 
+/**
+ * Moves the seat node to the top of the focus stack.
+ */
+static void seat_node_raise(struct sway_seat_node *seat_node) {
+	struct sway_seat *seat = seat_node->seat;
+	wl_list_remove(&seat_node->link);
+	wl_list_insert(&seat->focus_stack, &seat_node->link);
+	seat_node->focus_order = ++seat->focus_order_top;
+}
+
 static struct sway_seat_node *seat_node_from_node(
 		struct sway_seat *seat, struct sway_node *node) {
 	if (node->type == N_ROOT || node->type == N_OUTPUT) {
@@ -329,11 +419,9 @@ static struct sway_seat_node *seat_node_from_node(
 		return NULL;
 	}
 
-	struct sway_seat_node *seat_node = NULL;
-	wl_list_for_each(seat_node, &seat->focus_stack, link) {
-		if (seat_node->node == node) {
-			return seat_node;
-		}
+	struct sway_seat_node *seat_node = seat_node_try_get(seat, node);
+	if (seat_node) {
+		return seat_node;
 	}
 
 	seat_node = calloc(1, sizeof(struct sway_seat_node));
@@ -345,6 +433,8 @@ static struct sway_seat_node *seat_node_from_node(
 	seat_node->node = node;
 	seat_node->seat = seat;
 	wl_list_insert(seat->focus_stack.prev, &seat_node->link);
+	seat_node->focus_order = --seat->focus_order_bottom;
+	wl_list_insert(&node->seat_nodes, &seat_node->node_link);
 	wl_signal_add(&node->events.destroy, &seat_node->destroy);
 	seat_node->destroy.notify = handle_seat_node_destroy;
 
@@ -492,8 +582,7 @@ static void collect_focus_iter(struct sway_node *node, void *data) {
 	if (!seat_node) {
 		return;
 	}
-	wl_list_remove(&seat_node->link);
-	wl_list_insert(&seat->focus_stack, &seat_node->link);
+	seat_node_raise(seat_node);
 }
 
 static void collect_focus_workspace_iter(struct sway_workspace *workspace,
@@ -1108,8 +1197,7 @@ static void set_workspace(struct sway_seat *seat,
 
 void seat_set_raw_focus(struct sway_seat *seat, struct sway_node *node) {
 	struct sway_seat_node *seat_node = seat_node_from_node(seat, node);
-	wl_list_remove(&seat_node->link);
-	wl_list_insert(&seat->focus_stack, &seat_node->link);
+	seat_node_raise(seat_node);
 	node_set_dirty(node);
 
 	// If focusing a scratchpad container that is fullscreen global, parent
@@ -1360,50 +1448,37 @@ struct sway_node *seat_get_focus_inactive(struct sway_seat *seat,
 	if (node_is_view(node)) {
 		return node;
 	}
+	if (node->type == N_WORKSPACE || node->type == N_CONTAINER) {
+		struct sway_seat_node *best =
+			seat_get_most_recent_descendant(seat, node, false);
+		if (best) {
+			return best->node;
+		}
+		return node->type == N_WORKSPACE ? node : NULL;
+	}
+	// The root and outputs hold most of the focus stack, so the first match
+	// is usually found near the top
 	struct sway_seat_node *current;
 	wl_list_for_each(current, &seat->focus_stack, link) {
 		if (node_has_ancestor(current->node, node)) {
 			return current->node;
 		}
 	}
-	if (node->type == N_WORKSPACE) {
-		return node;
-	}
 	return NULL;
 }
 
 struct sway_container *seat_get_focus_inactive_tiling(struct sway_seat *seat,
 		struct sway_workspace *workspace) {
-	if (!workspace->tiling->length) {
-		return NULL;
-	}
-	struct sway_seat_node *current;
-	wl_list_for_each(current, &seat->focus_stack, link) {
-		struct sway_node *node = current->node;
-		if (node->type == N_CONTAINER &&
-				!container_is_floating_or_child(node->sway_container) &&
-				node->sway_container->pending.workspace == workspace) {
-			return node->sway_container;
-		}
-	}
-	return NULL;
+	struct sway_seat_node *best =
+		seat_get_most_recent(seat, workspace->tiling, false, true, NULL);
+	return best ? best->node->sway_container : NULL;
 }
 
 struct sway_container *seat_get_focus_inactive_floating(struct sway_seat *seat,
 		struct sway_workspace *workspace) {
-	if (!workspace->floating->length) {
-		return NULL;
-	}
-	struct sway_seat_node *current;
-	wl_list_for_each(current, &seat->focus_stack, link) {
-		struct sway_node *node = current->node;
-		if (node->type == N_CONTAINER &&
-				container_is_floating_or_child(node->sway_container) &&
-				node->sway_container->pending.workspace == workspace) {
-			return node->sway_container;
-		}
-	}
-	return NULL;
+	struct sway_seat_node *best =
+		seat_get_most_recent(seat, workspace->floating, false, true, NULL);
+	return best ? best->node->sway_container : NULL;
 }
 
 struct sway_node *seat_get_active_tiling_child(struct sway_seat *seat,
@@ -1411,22 +1486,22 @@ struct sway_node *seat_get_active_tiling_child(struct sway_seat *seat,
 	if (node_is_view(parent)) {
 		return parent;
 	}
-	struct sway_seat_node *current;
-	wl_list_for_each(current, &seat->focus_stack, link) {
-		struct sway_node *node = current->node;
-		if (node_get_parent(node) != parent) {
-			continue;
+	struct sway_seat_node *best = NULL;
+	if (parent->type == N_OUTPUT) {
+		struct sway_output *output = parent->sway_output;
+		for (int i = 0; i < output->workspaces->length; ++i) {
+			struct sway_workspace *ws = output->workspaces->items[i];
+			best = seat_node_most_recent(seat, &ws->node, best);
 		}
-		if (parent->type == N_WORKSPACE) {
-			// Only consider tiling children
-			struct sway_workspace *ws = parent->sway_workspace;
-			if (list_find(ws->tiling, node->sway_container) == -1) {
-				continue;
-			}
-		}
-		return node;
-	}
-	return NULL;
+	} else if (parent->type == N_WORKSPACE) {
+		// Only consider tiling children of workspaces
+		best = seat_get_most_recent(seat, parent->sway_workspace->tiling,
+				false, false, NULL);
+	} else if (parent->type == N_CONTAINER) {
+		best = seat_get_most_recent(seat,
+				parent->sway_container->pending.children, false, false, NULL);
+	}
+	return best ? best->node : NULL;
 }
 
 struct sway_node *seat_get_focus(struct sway_seat *seat) {
@@ -1,8 +1,13 @@
 #include <ctype.h>
+#include <errno.h>
 #include <float.h>
+#include <inttypes.h>
 #include <json.h>
 #include <libevdev/libevdev.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wlr/config.h>
 #include <wlr/types/wlr_content_type_v1.h>
 #include <wlr/types/wlr_output.h>
@@ -10,8 +15,10 @@
 #include "config.h"
 #include "log.h"
 #include "sway/config.h"
+#include "sway/desktop/transaction.h"
 #include "sway/ipc-json.h"
 #include "sway/server.h"
+#include "sway/sway_text_node.h"
 #include "sway/tree/container.h"
 #include "sway/tree/view.h"
 #include "sway/tree/workspace.h"
@@ -511,6 +518,7 @@ static void ipc_json_describe_workspace(struct sway_workspace *workspace,
 			json_object_new_string(workspace->output->wlr_output->name) : NULL);
 	json_object_object_add(object, "urgent",
 			json_object_new_boolean(workspace->urgent));
+	workspace_flush_representation(workspace);
 	json_object_object_add(object, "representation", workspace->representation ?
 			json_object_new_string(workspace->representation) : NULL);
 
@@ -868,6 +876,1012 @@ json_object *ipc_json_describe_node_recursive(struct sway_node *node) {
 	return object;
 }
 
+/*
+ * Streaming serialization of the tree for IPC_GET_TREE.
+ *
+ * This writes the same bytes as json_object_to_json_string on the result of
+ * ipc_json_describe_node_recursive(&root->node), without building the json-c
+ * objects in between. Keys are written in the order in which the functions
+ * above first add them, with the value they end up with. Any change to the
+ * functions above must be mirrored here. Running sway with
+ * -Dipc-tree-check compares both serializations on every GET_TREE.
+ */
+
+struct ipc_json_writer {
+	char **data;
+	size_t *len, *size;
+	bool need_comma; // a value was written at the current nesting level
+	bool after_key;
+	bool failed;
+};
+
+static void writer_append(struct ipc_json_writer *w, const char *str,
+		size_t len) {
+	if (w->failed || len == 0) {
+		return;
+	}
+	if (*w->len + len >= *w->size) {
+		size_t size = *w->size > 0 ? *w->size : 1024;
+		while (*w->len + len >= size) {
+			size *= 2;
+		}
+		char *data = realloc(*w->data, size);
+		if (!data) {
+			w->failed = true;
+			return;
+		}
+		*w->data = data;
+		*w->size = size;
+	}
+	memcpy(*w->data + *w->len, str, len);
+	*w->len += len;
+}
+
+static void writer_append_str(struct ipc_json_writer *w, const char *str) {
+	writer_append(w, str, strlen(str));
+}
+
+// Escapes like json-c with JSON_C_TO_STRING_SPACED, including forward slashes
+static void writer_append_escaped(struct ipc_json_writer *w, const char *str) {
+	writer_append(w, "\"", 1);
+	const char *start = str;
+	const char *p = str;
+	for (; *p; ++p) {
+		unsigned char c = *p;
+		const char *escaped = NULL;
+		char unicode[8];
+		switch (c) {
+		case '\b':
+			escaped = "\\b";
+			break;
+		case '\n':
+			escaped = "\\n";
+			break;
+		case '\r':
+			escaped = "\\r";
+			break;
+		case '\t':
+			escaped = "\\t";
+			break;
+		case '\f':
+			escaped = "\\f";
+			break;
+		case '"':
+			escaped = "\\\"";
+			break;
+		case '\\':
+			escaped = "\\\\";
+			break;
+		case '/':
+			escaped = "\\/";
+			break;
+		default:
+			if (c < ' ') {
+				snprintf(unicode, sizeof(unicode), "\\u%04x", c);
+				escaped = unicode;
+			}
+			break;
+		}
+		if (escaped) {
+			writer_append(w, start, p - start);
+			writer_append_str(w, escaped);
+			start = p + 1;
+		}
+	}
+	writer_append(w, start, p - start);
+	writer_append(w, "\"", 1);
+}
+
+static void writer_begin_value(struct ipc_json_writer *w) {
+	if (w->after_key) {
+		w->after_key = false;
+	} else {
+		writer_append_str(w, w->need_comma ? ", " : " ");
+	}
+	w->need_comma = true;
+}
+
+static void writer_key(struct ipc_json_writer *w, const char *key) {
+	writer_append_str(w, w->need_comma ? ", " : " ");
+	writer_append_escaped(w, key);
+	writer_append(w, ": ", 2);
+	w->after_key = true;
+}
+
+// The first value of a document must not be preceded by a space
+static void writer_begin_document(struct ipc_json_writer *w) {
+	w->after_key = true;
+	w->need_comma = false;
+}
+
+static void writer_begin_object(struct ipc_json_writer *w) {
+	writer_begin_value(w);
+	writer_append(w, "{", 1);
+	w->need_comma = false;
+}
+
+static void writer_end_object(struct ipc_json_writer *w) {
+	writer_append(w, " }", 2);
+	w->need_comma = true;
+}
+
+static void writer_begin_array(struct ipc_json_writer *w) {
+	writer_begin_value(w);
+	writer_append(w, "[", 1);
+	w->need_comma = false;
+}
+
+static void writer_end_array(struct ipc_json_writer *w) {
+	writer_append(w, " ]", 2);
+	w->need_comma = true;
+}
+
+static void writer_null(struct ipc_json_writer *w) {
+	writer_begin_value(w);
+	writer_append(w, "null", 4);
+}
+
+static void writer_string(struct ipc_json_writer *w, const char *str) {
+	if (!str) {
+		writer_null(w);
+		return;
+	}
+	writer_begin_value(w);
+	writer_append_escaped(w, str);
+}
+
+static void writer_int(struct ipc_json_writer *w, int64_t value) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%" PRId64, value);
+	writer_begin_value(w);
+	writer_append_str(w, buf);
+}
+
+static void writer_bool(struct ipc_json_writer *w, bool value) {
+	writer_begin_value(w);
+	writer_append_str(w, value ? "true" : "false");
+}
+
+// Formats like json-c's default double serializer
+static void writer_double(struct ipc_json_writer *w, double value) {
+	char buf[128];
+	if (isnan(value)) {
+		snprintf(buf, sizeof(buf), "NaN");
+	} else if (isinf(value)) {
+		snprintf(buf, sizeof(buf), value > 0 ? "Infinity" : "-Infinity");
+	} else {
+		int size = snprintf(buf, sizeof(buf), "%.17g", value);
+		char *p = strchr(buf, ',');
+		if (p) {
+			*p = '.';
+		} else {
+			p = strchr(buf, '.');
+		}
+		bool looks_numeric = isdigit((unsigned char)buf[0]) ||
+			(size > 1 && buf[0] == '-' && isdigit((unsigned char)buf[1]));
+		if (size < (int)sizeof(buf) - 2 && looks_numeric && !p &&
+				strchr(buf, 'e') == NULL) {
+			strcat(buf, ".0");
+		}
+	}
+	writer_begin_value(w);
+	writer_append_str(w, buf);
+}
+
+static void writer_rect(struct ipc_json_writer *w, const struct wlr_box *box) {
+	writer_begin_object(w);
+	writer_key(w, "x");
+	writer_int(w, box->x);
+	writer_key(w, "y");
+	writer_int(w, box->y);
+	writer_key(w, "width");
+	writer_int(w, box->width);
+	writer_key(w, "height");
+	writer_int(w, box->height);
+	writer_end_object(w);
+}
+
+/**
+ * The values of the keys added by ipc_json_create_node, after they have been
+ * overridden by the type specific functions.
+ */
+struct ipc_json_node_fields {
+	int id;
+	const char *type;
+	const char *orientation;
+	bool has_percent;
+	double percent;
+	bool urgent;
+	list_t *marks;
+	bool focused;
+	const char *layout;
+	const char *border;
+	int current_border_width;
+	struct wlr_box rect, deco_rect, window_rect, geometry;
+	const char *name;
+	bool has_window;
+	uint32_t window;
+	int fullscreen_mode;
+	bool sticky;
+	const char *floating;
+	const char *scratchpad_state;
+};
+
+static void ipc_json_node_fields_init(struct ipc_json_node_fields *f, int id,
+		const char *type, const char *name, bool focused,
+		struct wlr_box *box) {
+	*f = (struct ipc_json_node_fields){
+		.id = id,
+		.type = type,
+		.orientation = ipc_json_orientation_description(L_HORIZ),
+		.focused = focused,
+		.layout = ipc_json_layout_description(L_HORIZ),
+		.border = ipc_json_border_description(B_NONE),
+		.rect = *box,
+		.name = name,
+	};
+}
+
+static void writer_node_recursive(struct ipc_json_writer *w,
+		struct sway_node *node);
+
+/**
+ * Writes all keys added by ipc_json_create_node up to "nodes" (exclusive).
+ */
+static void writer_node_head(struct ipc_json_writer *w,
+		const struct ipc_json_node_fields *f) {
+	writer_key(w, "id");
+	writer_int(w, f->id);
+	writer_key(w, "type");
+	writer_string(w, f->type);
+	writer_key(w, "orientation");
+	writer_string(w, f->orientation);
+	writer_key(w, "percent");
+	if (f->has_percent) {
+		writer_double(w, f->percent);
+	} else {
+		writer_null(w);
+	}
+	writer_key(w, "urgent");
+	writer_bool(w, f->urgent);
+	writer_key(w, "marks");
+	writer_begin_array(w);
+	for (int i = 0; f->marks && i < f->marks->length; ++i) {
+		writer_string(w, f->marks->items[i]);
+	}
+	writer_end_array(w);
+	writer_key(w, "focused");
+	writer_bool(w, f->focused);
+	writer_key(w, "layout");
+	writer_string(w, f->layout);
+	writer_key(w, "border");
+	writer_string(w, f->border);
+	writer_key(w, "current_border_width");
+	writer_int(w, f->current_border_width);
+	writer_key(w, "rect");
+	writer_rect(w, &f->rect);
+	writer_key(w, "deco_rect");
+	writer_rect(w, &f->deco_rect);
+	writer_key(w, "window_rect");
+	writer_rect(w, &f->window_rect);
+	writer_key(w, "geometry");
+	writer_rect(w, &f->geometry);
+	writer_key(w, "name");
+	writer_string(w, f->name);
+	writer_key(w, "window");
+	if (f->has_window) {
+		writer_int(w, f->window);
+	} else {
+		writer_null(w);
+	}
+}
+
+/**
+ * Writes the keys added by ipc_json_create_node after "floating_nodes",
+ * except for "focus".
+ */
+static void writer_node_tail(struct ipc_json_writer *w,
+		const struct ipc_json_node_fields *f) {
+	writer_key(w, "fullscreen_mode");
+	writer_int(w, f->fullscreen_mode);
+	writer_key(w, "sticky");
+	writer_bool(w, f->sticky);
+	writer_key(w, "floating");
+	writer_string(w, f->floating);
+	writer_key(w, "scratchpad_state");
+	writer_string(w, f->scratchpad_state);
+}
+
+static void writer_scratchpad_output(struct ipc_json_writer *w) {
+	struct wlr_box box;
+	root_get_box(root, &box);
+
+	struct ipc_json_node_fields output;
+	ipc_json_node_fields_init(&output, i3_output_id, "output", "__i3", false,
+			&box);
+	output.layout = "output";
+
+	struct ipc_json_node_fields workspace;
+	ipc_json_node_fields_init(&workspace, i3_scratch_id, "workspace",
+			"__i3_scratch", false, &box);
+	workspace.fullscreen_mode = 1;
+
+	writer_begin_object(w);
+	writer_node_head(w, &output);
+	writer_key(w, "nodes");
+	writer_begin_array(w);
+
+	writer_begin_object(w);
+	writer_node_head(w, &workspace);
+	writer_key(w, "nodes");
+	writer_begin_array(w);
+	writer_end_array(w);
+	writer_key(w, "floating_nodes");
+	writer_begin_array(w);
+	for (int i = 0; i < root->scratchpad->length; ++i) {
+		struct sway_container *container = root->scratchpad->items[i];
+		if (container_is_scratchpad_hidden(container)) {
+			writer_node_recursive(w, &container->node);
+		}
+	}
+	writer_end_array(w);
+	writer_key(w, "focus");
+	writer_begin_array(w);
+	for (int i = root->scratchpad->length - 1; i >= 0; --i) {
+		struct sway_container *container = root->scratchpad->items[i];
+		writer_int(w, (int)container->node.id);
+	}
+	writer_end_array(w);
+	writer_node_tail(w, &workspace);
+	writer_end_object(w);
+
+	writer_end_array(w);
+	writer_key(w, "floating_nodes");
+	writer_begin_array(w);
+	writer_end_array(w);
+	writer_key(w, "focus");
+	writer_begin_array(w);
+	writer_int(w, i3_scratch_id);
+	writer_end_array(w);
+	writer_node_tail(w, &output);
+	writer_end_object(w);
+}
+
+struct writer_focus_data {
+	struct ipc_json_writer *writer;
+	struct sway_node *node;
+	list_t *outputs; // outputs already written, for the root node
+};
+
+static void writer_focus_iterator(struct sway_node *node, void *_data) {
+	struct writer_focus_data *data = _data;
+	if (data->node == &root->node) {
+		struct sway_output *output = node_get_output(node);
+		if (output == NULL || list_find(data->outputs, output) != -1) {
+			return;
+		}
+		list_add(data->outputs, output);
+		node = &output->node;
+	} else if (node_get_parent(node) != data->node) {
+		return;
+	}
+	writer_int(data->writer, (int)node->id);
+}
+
+static void writer_focus(struct ipc_json_writer *w, struct sway_seat *seat,
+		struct sway_node *node) {
+	struct writer_focus_data data = {
+		.writer = w,
+		.node = node,
+		.outputs = node == &root->node ? create_list() : NULL,
+	};
+	writer_begin_array(w);
+	seat_for_each_node(seat, writer_focus_iterator, &data);
+	writer_end_array(w);
+	list_free(data.outputs);
+}
+
+static void writer_output_mode(struct ipc_json_writer *w,
+		const struct wlr_output_mode *mode, bool aspect_ratio) {
+	writer_begin_object(w);
+	writer_key(w, "width");
+	writer_int(w, mode->width);
+	writer_key(w, "height");
+	writer_int(w, mode->height);
+	writer_key(w, "refresh");
+	writer_int(w, mode->refresh);
+	if (aspect_ratio) {
+		writer_key(w, "picture_aspect_ratio");
+		writer_string(w, ipc_json_output_mode_aspect_ratio_description(
+				mode->picture_aspect_ratio));
+	}
+	writer_end_object(w);
+}
+
+static void writer_output_extra(struct ipc_json_writer *w,
+		struct sway_output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct sway_workspace *ws = output_get_active_workspace(output);
+
+	writer_key(w, "primary");
+	writer_bool(w, false);
+	writer_key(w, "make");
+	writer_string(w, wlr_output->make ? wlr_output->make : "Unknown");
+	writer_key(w, "model");
+	writer_string(w, wlr_output->model ? wlr_output->model : "Unknown");
+	writer_key(w, "serial");
+	writer_string(w, wlr_output->serial ? wlr_output->serial : "Unknown");
+	writer_key(w, "modes");
+	writer_begin_array(w);
+	struct wlr_output_mode *mode;
+	wl_list_for_each(mode, &wlr_output->modes, link) {
+		writer_output_mode(w, mode, ws != NULL);
+	}
+	writer_end_array(w);
+	writer_key(w, "non_desktop");
+	writer_bool(w, false);
+	writer_key(w, "active");
+	writer_bool(w, true);
+	writer_key(w, "dpms");
+	writer_bool(w, wlr_output->enabled);
+	writer_key(w, "power");
+	writer_bool(w, wlr_output->enabled);
+	writer_key(w, "scale");
+	writer_double(w, wlr_output->scale);
+	writer_key(w, "scale_filter");
+	writer_string(w,
+			sway_output_scale_filter_to_string(output->scale_filter));
+	writer_key(w, "transform");
+	writer_string(w,
+			ipc_json_output_transform_description(wlr_output->transform));
+	writer_key(w, "adaptive_sync_status");
+	writer_string(w, ipc_json_output_adaptive_sync_status_description(
+			wlr_output->adaptive_sync_status));
+
+	if (!sway_assert(ws, "Expected output to have a workspace")) {
+		return;
+	}
+	writer_key(w, "current_workspace");
+	writer_string(w, ws->name);
+	writer_key(w, "current_mode");
+	if (wlr_output->current_mode != NULL) {
+		writer_output_mode(w, wlr_output->current_mode, true);
+	} else {
+		struct wlr_output_mode current = {
+			.width = wlr_output->width,
+			.height = wlr_output->height,
+			.refresh = wlr_output->refresh,
+		};
+		writer_output_mode(w, &current, false);
+	}
+	writer_key(w, "max_render_time");
+	writer_int(w, output->max_render_time);
+	writer_key(w, "allow_tearing");
+	writer_bool(w, output->allow_tearing);
+}
+
+static void writer_workspace_extra(struct ipc_json_writer *w,
+		struct sway_workspace *workspace) {
+	int num = -1;
+	if (isdigit(workspace->name[0])) {
+		errno = 0;
+		char *endptr = NULL;
+		long long parsed_num = strtoll(workspace->name, &endptr, 10);
+		if (errno == 0 && parsed_num <= INT32_MAX && parsed_num >= 0 &&
+				endptr != workspace->name) {
+			num = (int) parsed_num;
+		}
+	}
+	writer_key(w, "num");
+	writer_int(w, num);
+	writer_key(w, "output");
+	writer_string(w, workspace->output ?
+			workspace->output->wlr_output->name : NULL);
+	workspace_flush_representation(workspace);
+	writer_key(w, "representation");
+	writer_string(w, workspace->representation);
+}
+
+static void writer_view_extra(struct ipc_json_writer *w,
+		struct sway_container *c) {
+	struct sway_view *view = c->view;
+	writer_key(w, "pid");
+	writer_int(w, view->pid);
+	writer_key(w, "app_id");
+	writer_string(w, view_get_app_id(view));
+	writer_key(w, "visible");
+	writer_bool(w, view_is_visible(view));
+	writer_key(w, "max_render_time");
+	writer_int(w, view->max_render_time);
+	writer_key(w, "allow_tearing");
+	writer_bool(w, view_can_tear(view));
+	writer_key(w, "shell");
+	writer_string(w, view_get_shell(view));
+	writer_key(w, "inhibit_idle");
+	writer_bool(w, view_inhibit_idle(view));
+
+	struct sway_idle_inhibitor_v1 *user_inhibitor =
+		sway_idle_inhibit_v1_user_inhibitor_for_view(view);
+	struct sway_idle_inhibitor_v1 *application_inhibitor =
+		sway_idle_inhibit_v1_application_inhibitor_for_view(view);
+	writer_key(w, "idle_inhibitors");
+	writer_begin_object(w);
+	writer_key(w, "user");
+	writer_string(w, user_inhibitor ?
+			ipc_json_user_idle_inhibitor_description(user_inhibitor->mode) :
+			"none");
+	writer_key(w, "application");
+	writer_string(w, application_inhibitor ? "enabled" : "none");
+	writer_end_object(w);
+
+	enum wp_content_type_v1_type content_type = WP_CONTENT_TYPE_V1_TYPE_NONE;
+	if (view->surface != NULL) {
+		content_type = wlr_surface_get_content_type_v1(
+			server.content_type_manager_v1, view->surface);
+	}
+	if (content_type != WP_CONTENT_TYPE_V1_TYPE_NONE) {
+		writer_key(w, "content_type");
+		writer_string(w, ipc_json_content_type_description(content_type));
+	}
+
+#if WLR_HAS_XWAYLAND
+	if (view->type == SWAY_VIEW_XWAYLAND) {
+		writer_key(w, "window_properties");
+		writer_begin_object(w);
+		const char *class = view_get_class(view);
+		if (class) {
+			writer_key(w, "class");
+			writer_string(w, class);
+		}
+		const char *instance = view_get_instance(view);
+		if (instance) {
+			writer_key(w, "instance");
+			writer_string(w, instance);
+		}
+		if (c->title) {
+			writer_key(w, "title");
+			writer_string(w, c->title);
+		}
+		uint32_t parent_id = view_get_x11_parent_id(view);
+		writer_key(w, "transient_for");
+		if (parent_id) {
+			writer_int(w, (int)parent_id);
+		} else {
+			writer_null(w);
+		}
+		const char *role = view_get_window_role(view);
+		if (role) {
+			writer_key(w, "window_role");
+			writer_string(w, role);
+		}
+		if (view_get_window_type(view)) {
+			writer_key(w, "window_type");
+			writer_string(w, ipc_json_xwindow_type_description(view));
+		}
+		writer_end_object(w);
+	}
+#endif
+}
+
+static bool get_percent(struct sway_node *node, int width, int height,
+		double *percent) {
+	struct sway_node *parent = node_get_parent(node);
+	struct wlr_box parent_box = {0, 0, 0, 0};
+	if (parent != NULL) {
+		node_get_box(parent, &parent_box);
+	}
+	if (parent_box.width == 0 || parent_box.height == 0) {
+		return false;
+	}
+	*percent = ((double)width / parent_box.width)
+			* ((double)height / parent_box.height);
+	return true;
+}
+
+static void writer_node_recursive(struct ipc_json_writer *w,
+		struct sway_node *node) {
+	struct sway_seat *seat = input_manager_get_default_seat();
+
+	struct wlr_box box;
+	node_get_box(node, &box);
+	if (node->type == N_CONTAINER) {
+		struct wlr_box deco_rect = {0, 0, 0, 0};
+		get_deco_rect(node->sway_container, &deco_rect);
+		size_t count = 1;
+		if (container_parent_layout(node->sway_container) == L_STACKED) {
+			count = container_get_siblings(node->sway_container)->length;
+		}
+		box.y += deco_rect.height * count;
+		box.height -= deco_rect.height * count;
+	}
+
+	struct ipc_json_node_fields f;
+	ipc_json_node_fields_init(&f, (int)node->id,
+			ipc_json_node_type_description(node->type), node_get_name(node),
+			seat_get_focus(seat) == node, &box);
+
+	switch (node->type) {
+	case N_ROOT:
+		break;
+	case N_OUTPUT:;
+		struct sway_output *output = node->sway_output;
+		f.layout = "output";
+		f.orientation = ipc_json_orientation_description(L_NONE);
+		if (output_get_active_workspace(output)) {
+			f.has_percent = get_percent(node, output->width, output->height,
+					&f.percent);
+		}
+		break;
+	case N_WORKSPACE:;
+		struct sway_workspace *ws = node->sway_workspace;
+		f.fullscreen_mode = 1;
+		f.urgent = ws->urgent;
+		f.layout = ipc_json_layout_description(ws->layout);
+		f.orientation = ipc_json_orientation_description(ws->layout);
+		break;
+	case N_CONTAINER:;
+		struct sway_container *c = node->sway_container;
+		bool floating = container_is_floating(c);
+		if (floating) {
+			f.type = "floating_con";
+		}
+		f.layout = ipc_json_layout_description(c->pending.layout);
+		f.orientation = ipc_json_orientation_description(c->pending.layout);
+		f.urgent = c->view ?
+			view_is_urgent(c->view) : container_has_urgent_child(c);
+		f.sticky = c->is_sticky;
+		f.floating = floating ? "user_on" : "auto_off";
+		f.fullscreen_mode = c->pending.fullscreen_mode;
+		f.scratchpad_state = !c->scratchpad ? "none" : "fresh";
+		f.has_percent = get_percent(node, c->pending.width, c->pending.height,
+				&f.percent);
+		f.border = ipc_json_border_description(c->current.border);
+		f.current_border_width = c->current.border_thickness;
+		get_deco_rect(c, &f.deco_rect);
+		f.marks = c->marks;
+		if (c->view) {
+			bool has_titlebar = c->title_bar.tree->node.enabled;
+			f.window_rect = (struct wlr_box){
+				c->pending.content_x - c->pending.x,
+				has_titlebar ? 0 : c->pending.content_y - c->pending.y,
+				c->pending.content_width,
+				c->pending.content_height
+			};
+			f.geometry = (struct wlr_box){
+				0, 0, c->view->natural_width, c->view->natural_height
+			};
+#if WLR_HAS_XWAYLAND
+			if (c->view->type == SWAY_VIEW_XWAYLAND) {
+				f.has_window = true;
+				f.window = view_get_x11_window_id(c->view);
+			}
+#endif
+		}
+		break;
+	}
+
+	writer_begin_object(w);
+	writer_node_head(w, &f);
+
+	writer_key(w, "nodes");
+	writer_begin_array(w);
+	switch (node->type) {
+	case N_ROOT:
+		writer_scratchpad_output(w);
+		for (int i = 0; i < root->outputs->length; ++i) {
+			struct sway_output *output = root->outputs->items[i];
+			writer_node_recursive(w, &output->node);
+		}
+		break;
+	case N_OUTPUT:
+		for (int i = 0; i < node->sway_output->workspaces->length; ++i) {
+			struct sway_workspace *ws = node->sway_output->workspaces->items[i];
+			writer_node_recursive(w, &ws->node);
+		}
+		break;
+	case N_WORKSPACE:
+		for (int i = 0; i < node->sway_workspace->tiling->length; ++i) {
+			struct sway_container *con = node->sway_workspace->tiling->items[i];
+			writer_node_recursive(w, &con->node);
+		}
+		break;
+	case N_CONTAINER:
+		if (node->sway_container->pending.children) {
+			list_t *children = node->sway_container->pending.children;
+			for (int i = 0; i < children->length; ++i) {
+				struct sway_container *child = children->items[i];
+				writer_node_recursive(w, &child->node);
+			}
+		}
+		break;
+	}
+	writer_end_array(w);
+
+	writer_key(w, "floating_nodes");
+	writer_begin_array(w);
+	if (node->type == N_WORKSPACE) {
+		list_t *floating = node->sway_workspace->floating;
+		for (int i = 0; i < floating->length; ++i) {
+			struct sway_container *floater = floating->items[i];
+			writer_node_recursive(w, &floater->node);
+		}
+	}
+	writer_end_array(w);
+
+	writer_key(w, "focus");
+	writer_focus(w, seat, node);
+	writer_node_tail(w, &f);
+
+	switch (node->type) {
+	case N_ROOT:
+		break;
+	case N_OUTPUT:
+		writer_output_extra(w, node->sway_output);
+		break;
+	case N_WORKSPACE:
+		writer_workspace_extra(w, node->sway_workspace);
+		break;
+	case N_CONTAINER:
+		if (node->sway_container->view) {
+			writer_view_extra(w, node->sway_container);
+		}
+		break;
+	}
+	writer_end_object(w);
+}
+
+bool ipc_json_write_tree(char **data, size_t *len, size_t *size) {
+	struct ipc_json_writer w = {
+		.data = data,
+		.len = len,
+		.size = size,
+	};
+	writer_begin_document(&w);
+	writer_node_recursive(&w, &root->node);
+	return !w.failed;
+}
+
+/*
+ * Tree diffs for the tree_diff event. Each node that is part of a
+ * transaction is described by comparing its current state with the state the
+ * transaction is about to apply.
+ */
+
+static json_object *ipc_json_create_change(const char *change,
+		struct sway_node *node) {
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "change", json_object_new_string(change));
+	json_object_object_add(object, "id", json_object_new_int((int)node->id));
+	json_object_object_add(object, "type",
+			json_object_new_string(ipc_json_node_type_description(node->type)));
+	return object;
+}
+
+static json_object *ipc_json_create_node_id(struct sway_node *node) {
+	return node ? json_object_new_int((int)node->id) : NULL;
+}
+
+static json_object *ipc_json_create_container_ids(list_t *containers) {
+	json_object *array = json_object_new_array();
+	for (int i = 0; containers && i < containers->length; ++i) {
+		struct sway_container *con = containers->items[i];
+		json_object_array_add(array, json_object_new_int((int)con->node.id));
+	}
+	return array;
+}
+
+static bool node_lists_equal(list_t *a, list_t *b) {
+	int a_length = a ? a->length : 0;
+	int b_length = b ? b->length : 0;
+	if (a_length != b_length) {
+		return false;
+	}
+	return a_length == 0 ||
+		memcmp(a->items, b->items, a_length * sizeof(void *)) == 0;
+}
+
+// Appends the change to the array, unless it only has change, id and type
+static void ipc_json_add_change(json_object *changes, json_object *change) {
+	if (json_object_object_length(change) > 3) {
+		json_object_array_add(changes, change);
+	} else {
+		json_object_put(change);
+	}
+}
+
+/**
+ * Handles nodes entering or leaving the current tree. Returns the "add"
+ * change for a new node, which the caller completes and appends. Returns NULL
+ * when the node was already in the tree, and sets *done if it has nothing
+ * more to describe.
+ */
+static json_object *ipc_json_describe_presence(json_object *changes,
+		struct sway_node *node, bool present, struct sway_node *parent,
+		struct wlr_box *box, bool *done) {
+	*done = false;
+	if (!present) {
+		if (node->has_current) {
+			json_object_array_add(changes,
+					ipc_json_create_change("remove", node));
+		}
+		*done = true;
+		return NULL;
+	}
+	if (node->has_current) {
+		return NULL;
+	}
+	json_object *add = ipc_json_create_change("add", node);
+	char *name = node_get_name(node);
+	json_object_object_add(add, "parent", ipc_json_create_node_id(parent));
+	json_object_object_add(add, "name",
+			name ? json_object_new_string(name) : NULL);
+	json_object_object_add(add, "rect", ipc_json_create_rect(box));
+	return add;
+}
+
+static void ipc_json_describe_move_resize_focus(json_object *changes,
+		struct sway_node *node, struct sway_node *old_parent,
+		struct sway_node *parent, struct wlr_box *old_box,
+		struct wlr_box *box, bool old_focused, bool focused) {
+	if (old_parent != parent) {
+		json_object *change = ipc_json_create_change("move", node);
+		json_object_object_add(change, "old_parent",
+				ipc_json_create_node_id(old_parent));
+		json_object_object_add(change, "parent",
+				ipc_json_create_node_id(parent));
+		json_object_array_add(changes, change);
+	}
+	if (old_box->x != box->x || old_box->y != box->y ||
+			old_box->width != box->width || old_box->height != box->height) {
+		json_object *change = ipc_json_create_change("resize", node);
+		json_object_object_add(change, "rect", ipc_json_create_rect(box));
+		json_object_array_add(changes, change);
+	}
+	if (old_focused != focused) {
+		json_object *change = ipc_json_create_change("focus", node);
+		json_object_object_add(change, "focused",
+				json_object_new_boolean(focused));
+		json_object_array_add(changes, change);
+	}
+}
+
+void ipc_json_describe_output_diff(json_object *changes,
+		struct sway_output *output, struct sway_output_state *state) {
+	struct sway_node *node = &output->node;
+	struct sway_output_state *old = &output->current;
+	struct wlr_box box;
+	output_get_box(output, &box);
+
+	bool done;
+	json_object *change = ipc_json_describe_presence(changes, node,
+			output->enabled && !node->destroying, &root->node, &box, &done);
+	if (done) {
+		return;
+	}
+	bool added = change != NULL;
+	if (added) {
+		old = NULL;
+	} else {
+		change = ipc_json_create_change("property", node);
+	}
+
+	if (!old || old->active_workspace != state->active_workspace) {
+		json_object_object_add(change, "active_workspace",
+				ipc_json_create_node_id(state->active_workspace ?
+					&state->active_workspace->node : NULL));
+	}
+	if (!old || !node_lists_equal(old->workspaces, state->workspaces)) {
+		json_object *nodes = json_object_new_array();
+		for (int i = 0; i < state->workspaces->length; ++i) {
+			struct sway_workspace *ws = state->workspaces->items[i];
+			json_object_array_add(nodes, json_object_new_int((int)ws->node.id));
+		}
+		json_object_object_add(change, "nodes", nodes);
+	}
+	ipc_json_add_change(changes, change);
+}
+
+void ipc_json_describe_workspace_diff(json_object *changes,
+		struct sway_workspace *ws, struct sway_workspace_state *state) {
+	struct sway_node *node = &ws->node;
+	struct sway_workspace_state *old = &ws->current;
+	struct sway_node *parent = state->output ? &state->output->node : NULL;
+	struct wlr_box box = { state->x, state->y, state->width, state->height };
+
+	bool done;
+	json_object *change = ipc_json_describe_presence(changes, node,
+			!node->destroying, parent, &box, &done);
+	if (done) {
+		return;
+	}
+	if (change) {
+		old = NULL;
+		json_object_object_add(change, "focused",
+				json_object_new_boolean(state->focused));
+	} else {
+		struct wlr_box old_box = { old->x, old->y, old->width, old->height };
+		ipc_json_describe_move_resize_focus(changes, node,
+				old->output ? &old->output->node : NULL, parent,
+				&old_box, &box, old->focused, state->focused);
+		change = ipc_json_create_change("property", node);
+	}
+
+	if (!old || old->layout != state->layout) {
+		json_object_object_add(change, "layout", json_object_new_string(
+				ipc_json_layout_description(state->layout)));
+	}
+	if (!old || old->fullscreen != state->fullscreen) {
+		json_object_object_add(change, "fullscreen",
+				ipc_json_create_node_id(state->fullscreen ?
+					&state->fullscreen->node : NULL));
+	}
+	if (!old || !node_lists_equal(old->tiling, state->tiling) ||
+			!node_lists_equal(old->floating, state->floating)) {
+		json_object_object_add(change, "nodes",
+				ipc_json_create_container_ids(state->tiling));
+		json_object_object_add(change, "floating_nodes",
+				ipc_json_create_container_ids(state->floating));
+	}
+	ipc_json_add_change(changes, change);
+}
+
+static struct sway_node *container_state_parent(
+		struct sway_container_state *state) {
+	if (state->parent) {
+		return &state->parent->node;
+	}
+	return state->workspace ? &state->workspace->node : NULL;
+}
+
+void ipc_json_describe_container_diff(json_object *changes,
+		struct sway_container *con, struct sway_container_state *state) {
+	struct sway_node *node = &con->node;
+	struct sway_container_state *old = &con->current;
+	struct sway_node *parent = container_state_parent(state);
+	struct wlr_box box = { state->x, state->y, state->width, state->height };
+
+	bool done;
+	json_object *change = ipc_json_describe_presence(changes, node,
+			!node->destroying, parent, &box, &done);
+	if (done) {
+		return;
+	}
+	if (change) {
+		old = NULL;
+		json_object_object_add(change, "focused",
+				json_object_new_boolean(state->focused));
+	} else {
+		struct wlr_box old_box = { old->x, old->y, old->width, old->height };
+		ipc_json_describe_move_resize_focus(changes, node,
+				container_state_parent(old), parent,
+				&old_box, &box, old->focused, state->focused);
+		change = ipc_json_create_change("property", node);
+	}
+
+	if (!old || old->layout != state->layout) {
+		json_object_object_add(change, "layout", json_object_new_string(
+				ipc_json_layout_description(state->layout)));
+	}
+	if (!old || old->fullscreen_mode != state->fullscreen_mode) {
+		json_object_object_add(change, "fullscreen_mode",
+				json_object_new_int(state->fullscreen_mode));
+	}
+	if (!old || old->border != state->border) {
+		json_object_object_add(change, "border", json_object_new_string(
+				ipc_json_border_description(state->border)));
+	}
+	if (!old || old->border_thickness != state->border_thickness) {
+		json_object_object_add(change, "current_border_width",
+				json_object_new_int(state->border_thickness));
+	}
+	if (!con->view &&
+			(!old || !node_lists_equal(old->children, state->children))) {
+		json_object_object_add(change, "nodes",
+				ipc_json_create_container_ids(state->children));
+	}
+	ipc_json_add_change(changes, change);
+}
+
 #if WLR_HAS_LIBINPUT_BACKEND
 static json_object *describe_libinput_device(struct libinput_device *device) {
 	json_object *object = json_object_new_object();
@@ -1440,6 +2454,87 @@ json_object *ipc_json_describe_bar_config(struct bar_config *bar) {
 	return json;
 }
 
+static json_object *ipc_json_describe_histogram(
+		const struct sway_transaction_histogram *histogram) {
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "count",
+			json_object_new_int64(histogram->count));
+	int p50 = transaction_histogram_percentile(histogram, 0.5);
+	int p99 = transaction_histogram_percentile(histogram, 0.99);
+	json_object_object_add(object, "p50_ms",
+			p50 >= 0 ? json_object_new_int(p50) : NULL);
+	json_object_object_add(object, "p99_ms",
+			p99 >= 0 ? json_object_new_int(p99) : NULL);
+
+	json_object *buckets = json_object_new_array();
+	for (size_t i = 0; i < TRANSACTION_STATS_BUCKETS; ++i) {
+		json_object *bucket = json_object_new_object();
+		json_object_object_add(bucket, "le_ms",
+				i < TRANSACTION_STATS_BUCKETS - 1 ?
+				json_object_new_int(1 << i) : NULL);
+		json_object_object_add(bucket, "count",
+				json_object_new_int64(histogram->buckets[i]));
+		json_object_array_add(buckets, bucket);
+	}
+	json_object_object_add(object, "buckets", buckets);
+	return object;
+}
+
+json_object *ipc_json_describe_stats(void) {
+	const struct sway_transaction_stats *stats = transaction_get_stats();
+
+	json_object *transactions = json_object_new_object();
+	json_object_object_add(transactions, "committed",
+			json_object_new_int64(stats->committed));
+	json_object_object_add(transactions, "applied",
+			json_object_new_int64(stats->applied));
+	json_object_object_add(transactions, "timed_out",
+			json_object_new_int64(stats->timed_out));
+	json_object_object_add(transactions, "timeout_ms",
+			json_object_new_int64(server.txn_timeout_ms));
+	json_object_object_add(transactions, "latency",
+			ipc_json_describe_histogram(&stats->latency));
+
+	json_object *clients = json_object_new_array();
+	for (int i = 0; stats->clients && i < stats->clients->length; ++i) {
+		struct sway_transaction_client_stats *client = stats->clients->items[i];
+		json_object *client_object = json_object_new_object();
+		json_object_object_add(client_object, "app_id",
+				json_object_new_string(client->app_id));
+		json_object_object_add(client_object, "configures",
+				json_object_new_int64(client->configures));
+		json_object_object_add(client_object, "timeouts",
+				json_object_new_int64(client->timeouts));
+		json_object_object_add(client_object, "ack_latency",
+				ipc_json_describe_histogram(&client->ack_latency));
+		json_object_object_add(client_object, "deadline_ms",
+				json_object_new_int64(transaction_client_deadline_ms(client)));
+		json_object_object_add(client_object, "slow",
+				json_object_new_boolean(client->slow));
+		json_object_array_add(clients, client_object);
+	}
+
+	const struct sway_text_node_cache_stats *text_stats =
+		sway_text_node_get_cache_stats();
+	json_object *text_cache = json_object_new_object();
+	json_object_object_add(text_cache, "entries",
+			json_object_new_int64(text_stats->entries));
+	json_object_object_add(text_cache, "bytes",
+			json_object_new_int64(text_stats->bytes));
+	json_object_object_add(text_cache, "hits",
+			json_object_new_int64(text_stats->hits));
+	json_object_object_add(text_cache, "misses",
+			json_object_new_int64(text_stats->misses));
+	json_object_object_add(text_cache, "evictions",
+			json_object_new_int64(text_stats->evictions));
+
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "transactions", transactions);
+	json_object_object_add(object, "clients", clients);
+	json_object_object_add(object, "text_cache", text_cache);
+	return object;
+}
+
 json_object *ipc_json_get_binding_mode(void) {
 	json_object *current_mode = json_object_new_object();
 	json_object_object_add(current_mode, "name",
@@ -1458,6 +2553,7 @@ static enum sway_scene_descriptor_type types[] = {
 	SWAY_SCENE_DESC_XWAYLAND_UNMANAGED,
 	SWAY_SCENE_DESC_POPUP,
 	SWAY_SCENE_DESC_DRAG_ICON,
+	SWAY_SCENE_DESC_OUTPUT,
 };
 
 static json_object *describe_scene_tree(struct wlr_scene_tree *tree) {
@@ -1551,6 +2647,12 @@ static json_object *describe_scene_tree(struct wlr_scene_tree *tree) {
 			case SWAY_SCENE_DESC_DRAG_ICON:;
 				type_string = "SWAY_SCENE_DESC_DRAG_ICON";
 				break;
+			case SWAY_SCENE_DESC_OUTPUT:;
+				type_string = "SWAY_SCENE_DESC_OUTPUT";
+				struct sway_output *output = data;
+				json_object_object_add(json_node_data, "name",
+					json_object_new_string(output->wlr_output->name));
+				break;
 			}
 			json_object_object_add(json_node_data, "type",
 				json_object_new_string(type_string));
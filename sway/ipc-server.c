@@ -11,7 +11,9 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include "sway/commands.h"
@@ -41,15 +43,33 @@ static const char ipc_magic[] = {'i', '3', '-', 'i', 'p', 'c'};
 
 #define IPC_HEADER_SIZE (sizeof(ipc_magic) + 8)
 
+// Bytes queued for a client above which pending events are dropped
+#define IPC_CLIENT_QUEUE_LIMIT (4 * 1024 * 1024)
+// Maximum number of messages flushed by a single writev call
+#define IPC_CLIENT_IOV_MAX 64
+
+/**
+ * A complete message, header included. Event messages are shared by all the
+ * subscribed clients they are queued for.
+ */
+struct ipc_message {
+	int refcount;
+	bool droppable; // events may be dropped for clients that fall behind
+	size_t length;
+	char *data;
+};
+
 struct ipc_client {
 	struct wl_event_source *event_source;
 	struct wl_event_source *writable_event_source;
 	struct sway_server *server;
 	int fd;
 	enum ipc_command_type subscribed_events;
-	size_t write_buffer_len;
-	size_t write_buffer_size;
-	char *write_buffer;
+	// Ring buffer of messages waiting to be written
+	struct ipc_message **write_queue;
+	size_t write_queue_head, write_queue_len, write_queue_cap;
+	size_t write_offset; // bytes of the first queued message already written
+	size_t write_queued_bytes; // bytes of all queued messages not yet written
 	// The following are for storing data between event_loop calls
 	uint32_t pending_length;
 	enum ipc_command_type pending_type;
@@ -63,6 +83,13 @@ void ipc_client_handle_command(struct ipc_client *client, uint32_t payload_lengt
 	enum ipc_command_type payload_type);
 bool ipc_send_reply(struct ipc_client *client, enum ipc_command_type payload_type,
 	const char *payload, uint32_t payload_length);
+static struct ipc_message *ipc_message_create(enum ipc_command_type payload_type,
+	const char *payload, uint32_t payload_length);
+static void ipc_message_unref(struct ipc_message *message);
+static bool ipc_client_queue_message(struct ipc_client *client,
+	struct ipc_message *message);
+static bool ipc_send_tree_reply(struct ipc_client *client,
+	enum ipc_command_type payload_type);
 
 static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	if (ipc_event_source) {
@@ -184,14 +211,12 @@ int ipc_handle_connection(int fd, uint32_t mask, void *data) {
 			client_fd, WL_EVENT_READABLE, ipc_client_handle_readable, client);
 	client->writable_event_source = NULL;
 
-	client->write_buffer_size = 128;
-	client->write_buffer_len = 0;
-	client->write_buffer = malloc(client->write_buffer_size);
-	if (!client->write_buffer) {
-		sway_log(SWAY_ERROR, "Unable to allocate ipc client write buffer");
-		close(client_fd);
-		return 0;
-	}
+	client->write_queue = NULL;
+	client->write_queue_head = 0;
+	client->write_queue_len = 0;
+	client->write_queue_cap = 0;
+	client->write_offset = 0;
+	client->write_queued_bytes = 0;
 
 	sway_log(SWAY_DEBUG, "New client: fd %d", client_fd);
 	list_add(ipc_client_list, client);
@@ -275,21 +300,30 @@ static bool ipc_has_event_listeners(enum ipc_command_type event) {
 }
 
 static void ipc_send_event(const char *json_string, enum ipc_command_type event) {
+	// The message is built once and shared by all subscribers
+	struct ipc_message *message = ipc_message_create(event, json_string,
+			(uint32_t)strlen(json_string));
+	if (!message) {
+		sway_log(SWAY_ERROR, "Unable to allocate ipc event");
+		return;
+	}
+	message->droppable = true;
+
 	struct ipc_client *client;
 	for (int i = 0; i < ipc_client_list->length; i++) {
 		client = ipc_client_list->items[i];
 		if ((client->subscribed_events & event_mask(event)) == 0) {
 			continue;
 		}
-		if (!ipc_send_reply(client, event, json_string,
-				(uint32_t)strlen(json_string))) {
+		if (!ipc_client_queue_message(client, message)) {
 			sway_log_errno(SWAY_INFO, "Unable to send reply to IPC client");
-			/* ipc_send_reply destroys client on error, which also
-			 * removes it from the list, so we need to process
+			/* ipc_client_queue_message destroys client on error, which
+			 * also removes it from the list, so we need to process
 			 * current index again */
 			i--;
 		}
 	}
+	ipc_message_unref(message);
 }
 
 void ipc_event_workspace(struct sway_workspace *old,
@@ -507,6 +541,25 @@ void ipc_event_input(const char *change, struct sway_input_device *device) {
 	json_object_put(json);
 }
 
+bool ipc_event_tree_diff_wanted(void) {
+	return ipc_has_event_listeners(IPC_EVENT_TREE_DIFF);
+}
+
+void ipc_event_tree_diff(json_object *changes) {
+	if (json_object_array_length(changes) == 0) {
+		json_object_put(changes);
+		return;
+	}
+	sway_log(SWAY_DEBUG, "Sending tree_diff event");
+
+	json_object *json = json_object_new_object();
+	json_object_object_add(json, "changes", changes);
+
+	const char *json_string = json_object_to_json_string(json);
+	ipc_send_event(json_string, IPC_EVENT_TREE_DIFF);
+	json_object_put(json);
+}
+
 void ipc_event_output(void) {
 	if (!ipc_has_event_listeners(IPC_EVENT_OUTPUT)) {
 		return;
@@ -521,6 +574,18 @@ void ipc_event_output(void) {
 	json_object_put(json);
 }
 
+/**
+ * Stops waiting for the socket to become writable once nothing is queued.
+ * The socket is nearly always writable, so leaving the source armed on an
+ * empty queue would wake the event loop on every iteration.
+ */
+static void ipc_client_disarm_if_idle(struct ipc_client *client) {
+	if (client->write_queue_len == 0 && client->writable_event_source) {
+		wl_event_source_remove(client->writable_event_source);
+		client->writable_event_source = NULL;
+	}
+}
+
 int ipc_client_handle_writable(int client_fd, uint32_t mask, void *data) {
 	struct ipc_client *client = data;
 
@@ -535,11 +600,23 @@ int ipc_client_handle_writable(int client_fd, uint32_t mask, void *data) {
 		return 0;
 	}
 
-	if (client->write_buffer_len <= 0) {
+	if (client->write_queue_len == 0) {
+		ipc_client_disarm_if_idle(client);
 		return 0;
 	}
 
-	ssize_t written = write(client->fd, client->write_buffer, client->write_buffer_len);
+	struct iovec iov[IPC_CLIENT_IOV_MAX];
+	int iovcnt = 0;
+	for (size_t i = 0; i < client->write_queue_len && iovcnt < IPC_CLIENT_IOV_MAX; ++i) {
+		struct ipc_message *message = client->write_queue[
+			(client->write_queue_head + i) % client->write_queue_cap];
+		size_t offset = i == 0 ? client->write_offset : 0;
+		iov[iovcnt].iov_base = message->data + offset;
+		iov[iovcnt].iov_len = message->length - offset;
+		iovcnt++;
+	}
+
+	ssize_t written = writev(client->fd, iov, iovcnt);
 
 	if (written == -1 && errno == EAGAIN) {
 		return 0;
@@ -549,14 +626,26 @@ int ipc_client_handle_writable(int client_fd, uint32_t mask, void *data) {
 		return 0;
 	}
 
-	memmove(client->write_buffer, client->write_buffer + written, client->write_buffer_len - written);
-	client->write_buffer_len -= written;
-
-	if (client->write_buffer_len == 0 && client->writable_event_source) {
-		wl_event_source_remove(client->writable_event_source);
-		client->writable_event_source = NULL;
+	client->write_queued_bytes -= written;
+	size_t remaining = written;
+	while (remaining > 0) {
+		struct ipc_message *message =
+			client->write_queue[client->write_queue_head];
+		size_t left = message->length - client->write_offset;
+		if (remaining < left) {
+			client->write_offset += remaining;
+			break;
+		}
+		remaining -= left;
+		client->write_offset = 0;
+		client->write_queue_head =
+			(client->write_queue_head + 1) % client->write_queue_cap;
+		client->write_queue_len--;
+		ipc_message_unref(message);
 	}
 
+	ipc_client_disarm_if_idle(client);
+
 	return 0;
 }
 
@@ -577,7 +666,11 @@ void ipc_client_disconnect(struct ipc_client *client) {
 		i++;
 	}
 	list_del(ipc_client_list, i);
-	free(client->write_buffer);
+	for (size_t j = 0; j < client->write_queue_len; ++j) {
+		ipc_message_unref(client->write_queue[
+			(client->write_queue_head + j) % client->write_queue_cap]);
+	}
+	free(client->write_queue);
 	close(client->fd);
 	free(client);
 }
@@ -757,6 +850,8 @@ void ipc_client_handle_command(struct ipc_client *client, uint32_t payload_lengt
 				is_tick = true;
 			} else if (strcmp(event_type, "input") == 0) {
 				client->subscribed_events |= event_mask(IPC_EVENT_INPUT);
+			} else if (strcmp(event_type, "tree_diff") == 0) {
+				client->subscribed_events |= event_mask(IPC_EVENT_TREE_DIFF);
 			} else {
 				const char msg[] = "{\"success\": false}";
 				ipc_send_reply(client, payload_type, msg, strlen(msg));
@@ -806,12 +901,16 @@ void ipc_client_handle_command(struct ipc_client *client, uint32_t payload_lengt
 	}
 
 	case IPC_GET_TREE:
+		ipc_send_tree_reply(client, payload_type);
+		goto exit_cleanup;
+
+	case IPC_GET_STATS:
 	{
-		json_object *tree = ipc_json_describe_node_recursive(&root->node);
-		const char *json_string = json_object_to_json_string(tree);
+		json_object *stats = ipc_json_describe_stats();
+		const char *json_string = json_object_to_json_string(stats);
 		ipc_send_reply(client, payload_type, json_string,
 			(uint32_t)strlen(json_string));
-		json_object_put(tree);
+		json_object_put(stats);
 		goto exit_cleanup;
 	}
 
@@ -936,40 +1035,133 @@ exit_cleanup:
 	free(buf);
 }
 
-bool ipc_send_reply(struct ipc_client *client, enum ipc_command_type payload_type,
-		const char *payload, uint32_t payload_length) {
-	assert(payload);
-
-	char data[IPC_HEADER_SIZE];
-
+static void ipc_write_header(char *data, enum ipc_command_type payload_type,
+		uint32_t payload_length) {
 	memcpy(data, ipc_magic, sizeof(ipc_magic));
 	memcpy(data + sizeof(ipc_magic), &payload_length, sizeof(payload_length));
 	memcpy(data + sizeof(ipc_magic) + sizeof(payload_length), &payload_type, sizeof(payload_type));
+}
+
+static struct ipc_message *ipc_message_create_from_data(char *data,
+		size_t length) {
+	struct ipc_message *message = calloc(1, sizeof(struct ipc_message));
+	if (!message) {
+		return NULL;
+	}
+	message->refcount = 1;
+	message->length = length;
+	message->data = data;
+	return message;
+}
+
+static struct ipc_message *ipc_message_create(enum ipc_command_type payload_type,
+		const char *payload, uint32_t payload_length) {
+	char *data = malloc(IPC_HEADER_SIZE + payload_length);
+	if (!data) {
+		return NULL;
+	}
+	ipc_write_header(data, payload_type, payload_length);
+	memcpy(data + IPC_HEADER_SIZE, payload, payload_length);
+
+	struct ipc_message *message =
+		ipc_message_create_from_data(data, IPC_HEADER_SIZE + payload_length);
+	if (!message) {
+		free(data);
+	}
+	return message;
+}
+
+static void ipc_message_unref(struct ipc_message *message) {
+	if (--message->refcount > 0) {
+		return;
+	}
+	free(message->data);
+	free(message);
+}
+
+/**
+ * Drops queued events that have not started being written, oldest first,
+ * until the queue is at most target bytes long.
+ */
+static void ipc_client_drop_events(struct ipc_client *client, size_t target) {
+	size_t dropped = 0;
+	size_t kept = 0;
+	for (size_t i = 0; i < client->write_queue_len; ++i) {
+		size_t index = (client->write_queue_head + i) % client->write_queue_cap;
+		struct ipc_message *message = client->write_queue[index];
+		bool started = i == 0 && client->write_offset > 0;
+		if (client->write_queued_bytes > target && message->droppable &&
+				!started) {
+			client->write_queued_bytes -= message->length;
+			ipc_message_unref(message);
+			dropped++;
+			continue;
+		}
+		client->write_queue[
+			(client->write_queue_head + kept) % client->write_queue_cap] = message;
+		kept++;
+	}
+	client->write_queue_len = kept;
+	ipc_client_disarm_if_idle(client);
+	if (dropped > 0) {
+		sway_log(SWAY_INFO, "IPC client %d is not reading, dropped %zu events",
+				client->fd, dropped);
+	}
+}
 
-	while (client->write_buffer_len + IPC_HEADER_SIZE + payload_length >=
-				 client->write_buffer_size) {
-		client->write_buffer_size *= 2;
+static bool ipc_client_grow_queue(struct ipc_client *client) {
+	size_t cap = client->write_queue_cap ? client->write_queue_cap * 2 : 16;
+	struct ipc_message **queue = malloc(cap * sizeof(struct ipc_message *));
+	if (!queue) {
+		return false;
 	}
+	for (size_t i = 0; i < client->write_queue_len; ++i) {
+		queue[i] = client->write_queue[
+			(client->write_queue_head + i) % client->write_queue_cap];
+	}
+	free(client->write_queue);
+	client->write_queue = queue;
+	client->write_queue_head = 0;
+	client->write_queue_cap = cap;
+	return true;
+}
 
-	if (client->write_buffer_size > 4e6) { // 4 MB
-		sway_log(SWAY_ERROR, "Client write buffer too big (%zu), disconnecting client",
-				client->write_buffer_size);
+/**
+ * Queues a message for the client, taking a reference to it. When the client
+ * falls behind, pending events are dropped to make room. Disconnects the
+ * client and returns false if the message can't be queued.
+ */
+static bool ipc_client_queue_message(struct ipc_client *client,
+		struct ipc_message *message) {
+	if (client->write_queued_bytes + message->length > IPC_CLIENT_QUEUE_LIMIT) {
+		size_t target = message->length < IPC_CLIENT_QUEUE_LIMIT ?
+			IPC_CLIENT_QUEUE_LIMIT - message->length : 0;
+		ipc_client_drop_events(client, target);
+	}
+	if (client->write_queued_bytes + message->length > IPC_CLIENT_QUEUE_LIMIT) {
+		if (message->droppable) {
+			sway_log(SWAY_INFO, "IPC client %d is not reading, dropped an event",
+					client->fd);
+			return true;
+		}
+		sway_log(SWAY_ERROR, "Client write queue too big (%zu), disconnecting client",
+				client->write_queued_bytes + message->length);
 		ipc_client_disconnect(client);
 		return false;
 	}
 
-	char *new_buffer = realloc(client->write_buffer, client->write_buffer_size);
-	if (!new_buffer) {
-		sway_log(SWAY_ERROR, "Unable to reallocate ipc client write buffer");
+	if (client->write_queue_len == client->write_queue_cap &&
+			!ipc_client_grow_queue(client)) {
+		sway_log(SWAY_ERROR, "Unable to grow ipc client write queue");
 		ipc_client_disconnect(client);
 		return false;
 	}
-	client->write_buffer = new_buffer;
 
-	memcpy(client->write_buffer + client->write_buffer_len, data, IPC_HEADER_SIZE);
-	client->write_buffer_len += IPC_HEADER_SIZE;
-	memcpy(client->write_buffer + client->write_buffer_len, payload, payload_length);
-	client->write_buffer_len += payload_length;
+	message->refcount++;
+	client->write_queue[(client->write_queue_head + client->write_queue_len)
+		% client->write_queue_cap] = message;
+	client->write_queue_len++;
+	client->write_queued_bytes += message->length;
 
 	if (!client->writable_event_source) {
 		client->writable_event_source = wl_event_loop_add_fd(
@@ -979,3 +1171,90 @@ bool ipc_send_reply(struct ipc_client *client, enum ipc_command_type payload_typ
 
 	return true;
 }
+
+bool ipc_send_reply(struct ipc_client *client, enum ipc_command_type payload_type,
+		const char *payload, uint32_t payload_length) {
+	assert(payload);
+
+	struct ipc_message *message =
+		ipc_message_create(payload_type, payload, payload_length);
+	if (!message) {
+		sway_log(SWAY_ERROR, "Unable to allocate ipc reply");
+		ipc_client_disconnect(client);
+		return false;
+	}
+	bool queued = ipc_client_queue_message(client, message);
+	ipc_message_unref(message);
+	return queued;
+}
+
+/**
+ * Serializes the tree straight into the reply message, instead of building a
+ * json_object tree and copying its string representation.
+ */
+static float elapsed_ms(const struct timespec *start,
+		const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000 +
+		(end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Checks the streamed GET_TREE reply against the json-c serialization it
+ * replaces, and logs how long each of them took. Enabled with the
+ * ipc-tree-check debug flag.
+ */
+static void ipc_check_tree_reply(const char *streamed, size_t len,
+		float streamed_ms) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	json_object *tree = ipc_json_describe_node_recursive(&root->node);
+	const char *expected = json_object_to_json_string(tree);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	size_t expected_len = strlen(expected);
+	size_t i = 0;
+	while (i < len && i < expected_len && streamed[i] == expected[i]) {
+		++i;
+	}
+	if (i < len || i < expected_len) {
+		int shown = len - i < 40 ? (int)(len - i) : 40;
+		sway_log(SWAY_ERROR, "Streamed tree differs from json-c at byte %zu: "
+				"'%.*s' instead of '%.40s'", i, shown, &streamed[i],
+				&expected[i]);
+	}
+	sway_log(SWAY_DEBUG, "Tree reply of %zu bytes: %.2fms streamed, "
+			"%.2fms with json-c", len, streamed_ms, elapsed_ms(&start, &end));
+	json_object_put(tree);
+}
+
+static bool ipc_send_tree_reply(struct ipc_client *client,
+		enum ipc_command_type payload_type) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	size_t size = 4096;
+	size_t len = IPC_HEADER_SIZE;
+	char *data = malloc(size);
+	if (!data || !ipc_json_write_tree(&data, &len, &size)) {
+		sway_log(SWAY_ERROR, "Unable to allocate ipc tree reply");
+		free(data);
+		ipc_client_disconnect(client);
+		return false;
+	}
+	if (debug.ipc_tree_check) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ipc_check_tree_reply(data + IPC_HEADER_SIZE, len - IPC_HEADER_SIZE,
+				elapsed_ms(&start, &end));
+	}
+	ipc_write_header(data, payload_type, (uint32_t)(len - IPC_HEADER_SIZE));
+
+	struct ipc_message *message = ipc_message_create_from_data(data, len);
+	if (!message) {
+		sway_log(SWAY_ERROR, "Unable to allocate ipc tree reply");
+		free(data);
+		ipc_client_disconnect(client);
+		return false;
+	}
+	bool queued = ipc_client_queue_message(client, message);
+	ipc_message_unref(message);
+	return queued;
+}
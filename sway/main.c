@@ -163,6 +163,8 @@ void enable_debug_flag(const char *flag) {
 		server.txn_timeout_ms = atoi(&flag[12]);
 	} else if (strcmp(flag, "legacy-wl-drm") == 0) {
 		debug.legacy_wl_drm = true;
+	} else if (strcmp(flag, "ipc-tree-check") == 0) {
+		debug.ipc_tree_check = true;
 	} else {
 		sway_log(SWAY_ERROR, "Unknown debug flag: %s", flag);
 	}
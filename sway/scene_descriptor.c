@@ -5,9 +5,27 @@
 
 struct scene_descriptor {
 	void *data;
+	enum sway_scene_descriptor_type type;
+	struct wlr_scene_node *node;
 	struct wlr_addon addon;
 };
 
+// Stored in wlr_scene_node.data when a node has more than one hit descriptor
+static char multiple_hit_descriptors;
+
+static bool is_hit_type(enum sway_scene_descriptor_type type) {
+	switch (type) {
+	case SWAY_SCENE_DESC_CONTAINER:
+	case SWAY_SCENE_DESC_VIEW:
+	case SWAY_SCENE_DESC_POPUP:
+	case SWAY_SCENE_DESC_LAYER_SHELL:
+	case SWAY_SCENE_DESC_XWAYLAND_UNMANAGED:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static const struct wlr_addon_interface addon_interface;
 
 static struct scene_descriptor *scene_node_get_descriptor(
@@ -22,6 +40,9 @@ static struct scene_descriptor *scene_node_get_descriptor(
 }
 
 static void descriptor_destroy(struct scene_descriptor *desc) {
+	if (desc->node->data == desc) {
+		desc->node->data = NULL;
+	}
 	wlr_addon_finish(&desc->addon);
 	free(desc);
 }
@@ -65,5 +86,42 @@ bool scene_descriptor_assign(struct wlr_scene_node *node,
 
 	wlr_addon_init(&desc->addon, &node->addons, (void *)type, &addon_interface);
 	desc->data = data;
+	desc->type = type;
+	desc->node = node;
+
+	if (is_hit_type(type)) {
+		node->data = node->data ? &multiple_hit_descriptors : desc;
+	}
 	return true;
 }
+
+bool scene_descriptor_try_get_hit(struct wlr_scene_node *node,
+		enum sway_scene_descriptor_type *type, void **data) {
+	if (!node->data) {
+		return false;
+	}
+	if (node->data != &multiple_hit_descriptors) {
+		struct scene_descriptor *desc = node->data;
+		*type = desc->type;
+		*data = desc->data;
+		return true;
+	}
+
+	static const enum sway_scene_descriptor_type priority[] = {
+		SWAY_SCENE_DESC_CONTAINER,
+		SWAY_SCENE_DESC_VIEW,
+		SWAY_SCENE_DESC_POPUP,
+		SWAY_SCENE_DESC_LAYER_SHELL,
+		SWAY_SCENE_DESC_XWAYLAND_UNMANAGED,
+	};
+	for (size_t i = 0; i < sizeof(priority) / sizeof(priority[0]); ++i) {
+		struct scene_descriptor *desc =
+			scene_node_get_descriptor(node, priority[i]);
+		if (desc) {
+			*type = desc->type;
+			*data = desc->data;
+			return true;
+		}
+	}
+	return false;
+}
@@ -6,6 +6,7 @@
 #include <wlr/types/wlr_raster.h>
 #include <wlr/interfaces/wlr_buffer.h>
 #include "cairo_util.h"
+#include "hashmap.h"
 #include "log.h"
 #include "pango.h"
 #include "sway/config.h"
@@ -44,10 +45,34 @@ static const struct wlr_buffer_impl cairo_buffer_impl = {
 	.end_data_ptr_access = cairo_buffer_handle_end_data_ptr_access,
 };
 
+// Rasters no text node shows are kept up to this many bytes
+#define TEXT_CACHE_UNUSED_MAX_BYTES (8 * 1024 * 1024)
+
+/**
+ * A rasterized text, shared by all the text nodes showing the same text with
+ * the same font, colors, size, scale and subpixel layout.
+ */
+struct text_cache_entry {
+	char *key; // NULL once the entry can't be shared anymore
+	PangoFontDescription *font;
+	struct wlr_buffer *buffer; // locked by the cache
+	size_t size;
+	int refs; // text nodes showing the raster
+	struct wl_list link; // text_cache.unused, if refs == 0
+};
+
+static struct {
+	hashmap_t *entries_by_key; // struct text_cache_entry
+	struct wl_list unused; // most recently used first
+	size_t unused_bytes;
+	struct sway_text_node_cache_stats stats;
+} text_cache;
+
 struct text_buffer {
 	struct wlr_scene_buffer *buffer_node;
 	char *text;
 	struct sway_text_node props;
+	struct text_cache_entry *cache_entry;
 
 	bool visible;
 	float scale;
@@ -78,13 +103,181 @@ static void update_source_box(struct text_buffer *buffer) {
 	wlr_scene_buffer_set_source_box(buffer->buffer_node, &source_box);
 }
 
+const struct sway_text_node_cache_stats *sway_text_node_get_cache_stats(void) {
+	return &text_cache.stats;
+}
+
+static void text_cache_entry_destroy(struct text_cache_entry *entry) {
+	if (entry->key) {
+		hashmap_remove(text_cache.entries_by_key, entry->key);
+		free(entry->key);
+	}
+	text_cache.stats.entries--;
+	text_cache.stats.bytes -= entry->size;
+	wlr_buffer_unlock(entry->buffer);
+	pango_font_description_free(entry->font);
+	free(entry);
+}
+
+/**
+ * Stops sharing the entry with text nodes rendering the same text later on.
+ */
+static void text_cache_entry_forget(struct text_cache_entry *entry) {
+	if (entry->key) {
+		hashmap_remove(text_cache.entries_by_key, entry->key);
+		free(entry->key);
+		entry->key = NULL;
+	}
+}
+
+static void text_cache_entry_unref(struct text_cache_entry *entry) {
+	if (!entry || --entry->refs > 0) {
+		return;
+	}
+	if (!entry->key) {
+		text_cache_entry_destroy(entry);
+		return;
+	}
+
+	wl_list_insert(&text_cache.unused, &entry->link);
+	text_cache.unused_bytes += entry->size;
+	while (text_cache.unused_bytes > TEXT_CACHE_UNUSED_MAX_BYTES) {
+		struct text_cache_entry *oldest =
+			wl_container_of(text_cache.unused.prev, oldest, link);
+		wl_list_remove(&oldest->link);
+		text_cache.unused_bytes -= oldest->size;
+		text_cache.stats.evictions++;
+		text_cache_entry_destroy(oldest);
+	}
+}
+
+/**
+ * Returns a new reference to the cached entry for the key, if any.
+ */
+static struct text_cache_entry *text_cache_get(const char *key) {
+	if (!text_cache.entries_by_key) {
+		text_cache.entries_by_key = create_hashmap();
+		wl_list_init(&text_cache.unused);
+		if (!text_cache.entries_by_key) {
+			return NULL;
+		}
+	}
+
+	struct text_cache_entry *entry =
+		hashmap_get(text_cache.entries_by_key, key);
+	if (entry && !pango_font_description_equal(entry->font,
+			config->font_description)) {
+		// Hash collision between two fonts
+		text_cache_entry_forget(entry);
+		entry = NULL;
+	}
+	if (!entry) {
+		text_cache.stats.misses++;
+		return NULL;
+	}
+
+	text_cache.stats.hits++;
+	if (entry->refs++ == 0) {
+		wl_list_remove(&entry->link);
+		text_cache.unused_bytes -= entry->size;
+	}
+	return entry;
+}
+
+/**
+ * Adds the buffer to the cache and returns a reference to its entry.
+ */
+static struct text_cache_entry *text_cache_add(const char *key,
+		struct wlr_buffer *buffer) {
+	struct text_cache_entry *entry = calloc(1, sizeof(*entry));
+	if (!entry) {
+		return NULL;
+	}
+	entry->font = pango_font_description_copy(config->font_description);
+	if (key && text_cache.entries_by_key) {
+		entry->key = strdup(key);
+	}
+	if (entry->key) {
+		hashmap_set(text_cache.entries_by_key, entry->key, entry);
+	}
+	entry->buffer = wlr_buffer_lock(buffer);
+	entry->size = (size_t)buffer->width * buffer->height * 4;
+	entry->refs = 1;
+	text_cache.stats.entries++;
+	text_cache.stats.bytes += entry->size;
+	return entry;
+}
+
+static char *text_cache_key(struct text_buffer *buffer, int width, int height,
+		double y) {
+	float *color = buffer->props.color;
+	float *background = buffer->props.background;
+	char prefix[256];
+	int len = snprintf(prefix, sizeof(prefix),
+			"%a,%a,%a,%a:%a,%a,%a,%a:%a:%d:%dx%d%+a:%x:%d:",
+			color[0], color[1], color[2], color[3],
+			background[0], background[1], background[2], background[3],
+			buffer->scale, buffer->subpixel, width, height, y,
+			pango_font_description_hash(config->font_description),
+			buffer->props.pango_markup);
+	if (len < 0 || (size_t)len >= sizeof(prefix)) {
+		return NULL;
+	}
+	size_t text_len = strlen(buffer->text);
+	char *key = malloc(len + text_len + 1);
+	if (key) {
+		memcpy(key, prefix, len);
+		memcpy(key + len, buffer->text, text_len + 1);
+	}
+	return key;
+}
+
 static void render_backing_buffer(struct text_buffer *buffer);
 
 static void handle_invalidated(struct wl_listener *listener, void *data) {
 	struct text_buffer *buffer = wl_container_of(listener, buffer, invalidated);
+	// Rasterize the text again rather than reusing the same buffer
+	if (buffer->cache_entry) {
+		text_cache_entry_forget(buffer->cache_entry);
+	}
 	render_backing_buffer(buffer);
 };
 
+static void set_backing_buffer(struct text_buffer *buffer,
+		struct text_cache_entry *entry) {
+	struct text_cache_entry *prev = buffer->cache_entry;
+	buffer->cache_entry = entry;
+	if (entry == prev) {
+		// Same raster, only the source box might have changed
+		text_cache_entry_unref(prev);
+		update_source_box(buffer);
+		return;
+	}
+
+	wl_list_remove(&buffer->invalidated.link);
+
+	wlr_scene_buffer_set_buffer(buffer->buffer_node, entry->buffer);
+	text_cache_entry_unref(prev);
+
+	if (buffer->buffer_node->raster) {
+		buffer->invalidated.notify = handle_invalidated;
+		wl_signal_add(&buffer->buffer_node->raster->events.invalidated, &buffer->invalidated);
+	} else {
+		wl_list_init(&buffer->invalidated.link);
+	}
+
+	update_source_box(buffer);
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	if (buffer->props.background[3] == 1) {
+		pixman_region32_union_rect(&opaque, &opaque, 0, 0,
+			buffer->props.width, buffer->props.height);
+	}
+	wlr_scene_buffer_set_opaque_region(buffer->buffer_node, &opaque);
+	pixman_region32_fini(&opaque);
+}
+
 static void render_backing_buffer(struct text_buffer *buffer) {
 	if (!buffer->visible) {
 		return;
@@ -92,16 +285,27 @@ static void render_backing_buffer(struct text_buffer *buffer) {
 
 	if (buffer->props.max_width == 0) {
 		wlr_scene_buffer_set_buffer(buffer->buffer_node, NULL);
+		text_cache_entry_unref(buffer->cache_entry);
+		buffer->cache_entry = NULL;
 		return;
 	}
 
 	float scale = buffer->scale;
 	int width = ceil(buffer->props.width * scale);
 	int height = ceil(buffer->props.height * scale);
+	double y = (config->font_baseline - buffer->props.baseline) * scale;
 	float *color = (float *)&buffer->props.color;
 	float *background = (float *)&buffer->props.background;
 	PangoContext *pango = NULL;
 
+	char *key = text_cache_key(buffer, width, height, y);
+	struct text_cache_entry *entry = key ? text_cache_get(key) : NULL;
+	if (entry) {
+		set_backing_buffer(buffer, entry);
+		free(key);
+		return;
+	}
+
 	cairo_font_options_t *fo = cairo_font_options_create();
 	cairo_font_options_set_hint_style(fo, CAIRO_HINT_STYLE_FULL);
 	enum wl_output_subpixel subpixel = buffer->subpixel;
@@ -143,7 +347,7 @@ static void render_backing_buffer(struct text_buffer *buffer) {
 	cairo_fill(cairo);
 
 	cairo_set_source_rgba(cairo, color[0], color[1], color[2], color[3]);
-	cairo_move_to(cairo, 0, (config->font_baseline - buffer->props.baseline) * scale);
+	cairo_move_to(cairo, 0, y);
 
 	render_text(cairo, config->font_description, scale, buffer->props.pango_markup,
 		"%s", buffer->text);
@@ -154,32 +358,18 @@ static void render_backing_buffer(struct text_buffer *buffer) {
 	cairo_buffer->surface = surface;
 	cairo_buffer->cairo = cairo;
 
-	wl_list_remove(&buffer->invalidated.link);
-
-	wlr_scene_buffer_set_buffer(buffer->buffer_node, &cairo_buffer->base);
-
-	if (buffer->buffer_node->raster) {
-		buffer->invalidated.notify = handle_invalidated;
-		wl_signal_add(&buffer->buffer_node->raster->events.invalidated, &buffer->invalidated);
-	} else {
-		wl_list_init(&buffer->invalidated.link);
+	entry = text_cache_add(key, &cairo_buffer->base);
+	if (entry) {
+		set_backing_buffer(buffer, entry);
 	}
-
 	wlr_buffer_drop(&cairo_buffer->base);
-	update_source_box(buffer);
-
-	pixman_region32_t opaque;
-	pixman_region32_init(&opaque);
-	if (background[3] == 1) {
-		pixman_region32_union_rect(&opaque, &opaque, 0, 0,
-			buffer->props.width, buffer->props.height);
-	}
-	wlr_scene_buffer_set_opaque_region(buffer->buffer_node, &opaque);
-	pixman_region32_fini(&opaque);
+	surface = NULL;
 
 err:
+	if (surface) cairo_surface_destroy(surface);
 	if (pango) g_object_unref(pango);
 	cairo_font_options_destroy(fo);
+	free(key);
 }
 
 static void handle_outputs_update(struct wl_listener *listener, void *data) {
@@ -224,6 +414,7 @@ static void handle_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&buffer->destroy.link);
 	wl_list_remove(&buffer->invalidated.link);
 
+	text_cache_entry_unref(buffer->cache_entry);
 	free(buffer->text);
 	free(buffer);
 }
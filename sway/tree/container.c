@@ -73,6 +73,10 @@ static struct wlr_scene_rect *alloc_rect_node(struct wlr_scene_tree *parent,
 	return rect;
 }
 
+static void container_id_key(size_t id, char *key, size_t size) {
+	snprintf(key, size, "%zu", id);
+}
+
 struct sway_container *container_create(struct sway_view *view) {
 	struct sway_container *c = calloc(1, sizeof(struct sway_container));
 	if (!c) {
@@ -160,6 +164,10 @@ struct sway_container *container_create(struct sway_view *view) {
 	c->alpha = 1.0f;
 	c->marks = create_list();
 
+	char key[32];
+	container_id_key(c->node.id, key, sizeof(key));
+	hashmap_set(root->containers_by_id, key, c);
+
 	wl_signal_init(&c->events.destroy);
 	wl_signal_emit_mutable(&root->events.new_node, &c->node);
 
@@ -500,10 +508,16 @@ void container_destroy(struct sway_container *con) {
 	}
 	free(con->title);
 	free(con->formatted_title);
-	free(con->title_format);
+	container_set_title_format(con, NULL);
 	list_free(con->pending.children);
 	list_free(con->current.children);
 
+	char key[32];
+	container_id_key(con->node.id, key, sizeof(key));
+	hashmap_remove(root->containers_by_id, key);
+	for (int i = 0; i < con->marks->length; ++i) {
+		root_index_remove(root->containers_by_mark, con->marks->items[i], con);
+	}
 	list_free_items_and_destroy(con->marks);
 
 	if (con->view && con->view->container == con) {
@@ -515,6 +529,10 @@ void container_destroy(struct sway_container *con) {
 	}
 
 	scene_node_disown_children(con->content_tree);
+	for (int i = 0; i < root->outputs->length; ++i) {
+		struct sway_output *output = root->outputs->items[i];
+		hit_index_forget(&output->tiling_hits, &con->scene_tree->node);
+	}
 	wlr_scene_node_destroy(&con->scene_tree->node);
 	free(con);
 }
@@ -647,120 +665,281 @@ bool container_has_ancestor(struct sway_container *descendant,
 	return false;
 }
 
-static char *escape_pango_markup(const char *buffer) {
-	size_t length = escape_markup_text(buffer, NULL);
-	char *escaped_title = calloc(length + 1, sizeof(char));
-	escape_markup_text(buffer, escaped_title);
-	return escaped_title;
+/**
+ * A growing string, appended to at a tracked cursor.
+ */
+struct title_buffer {
+	char *data;
+	size_t len;
+	size_t size;
+	bool failed;
+};
+
+static char *title_buffer_reserve(struct title_buffer *buf, size_t len) {
+	if (buf->failed) {
+		return NULL;
+	}
+	if (buf->len + len + 1 > buf->size) {
+		size_t size = buf->size ? buf->size * 2 : 64;
+		while (size < buf->len + len + 1) {
+			size *= 2;
+		}
+		char *data = realloc(buf->data, size);
+		if (!data) {
+			buf->failed = true;
+			return NULL;
+		}
+		buf->data = data;
+		buf->size = size;
+	}
+	return buf->data + buf->len;
 }
 
-static size_t append_prop(char *buffer, const char *value) {
+static void title_buffer_append(struct title_buffer *buf,
+		const char *str, size_t len) {
+	char *dest = title_buffer_reserve(buf, len);
+	if (!dest) {
+		return;
+	}
+	memcpy(dest, str, len);
+	buf->len += len;
+	buf->data[buf->len] = '\0';
+}
+
+static void title_buffer_append_prop(struct title_buffer *buf,
+		const char *value) {
 	if (!value) {
-		return 0;
+		return;
 	}
 	// If using pango_markup in font, we need to escape all markup chars
 	// from values to make sure tags are not inserted by clients
 	if (config->pango_markup) {
-		char *escaped_value = escape_pango_markup(value);
-		lenient_strcat(buffer, escaped_value);
-		size_t len = strlen(escaped_value);
-		free(escaped_value);
-		return len;
+		size_t len = escape_markup_text(value, NULL);
+		char *dest = title_buffer_reserve(buf, len);
+		if (!dest) {
+			return;
+		}
+		escape_markup_text(value, dest);
+		buf->len += len;
 	} else {
-		lenient_strcat(buffer, value);
-		return strlen(value);
+		title_buffer_append(buf, value, strlen(value));
+	}
+}
+
+static char *title_buffer_finish(struct title_buffer *buf) {
+	// Make sure even an empty result is an allocated string
+	if (!title_buffer_reserve(buf, 0)) {
+		free(buf->data);
+		return NULL;
+	}
+	buf->data[buf->len] = '\0';
+	return buf->data;
+}
+
+enum title_format_token_type {
+	TITLE_FORMAT_TEXT,
+	TITLE_FORMAT_TITLE,
+	// The following are only replaced for views
+	TITLE_FORMAT_APP_ID,
+	TITLE_FORMAT_CLASS,
+	TITLE_FORMAT_INSTANCE,
+	TITLE_FORMAT_SHELL,
+};
+
+struct title_format_token {
+	enum title_format_token_type type;
+	const char *text; // points into the format string
+	size_t len;
+};
+
+struct title_format {
+	struct title_format_token *tokens;
+	size_t length;
+};
+
+static const struct {
+	const char *placeholder;
+	enum title_format_token_type type;
+} title_format_placeholders[] = {
+	{ "%title", TITLE_FORMAT_TITLE },
+	{ "%app_id", TITLE_FORMAT_APP_ID },
+	{ "%class", TITLE_FORMAT_CLASS },
+	{ "%instance", TITLE_FORMAT_INSTANCE },
+	{ "%shell", TITLE_FORMAT_SHELL },
+};
+
+static bool title_format_add(struct title_format *program,
+		enum title_format_token_type type, const char *text, size_t len) {
+	if (type == TITLE_FORMAT_TEXT && len == 0) {
+		return true;
+	}
+	struct title_format_token *tokens = realloc(program->tokens,
+			(program->length + 1) * sizeof(struct title_format_token));
+	if (!tokens) {
+		return false;
+	}
+	program->tokens = tokens;
+	program->tokens[program->length++] = (struct title_format_token){
+		.type = type,
+		.text = text,
+		.len = len,
+	};
+	return true;
+}
+
+static void title_format_destroy(struct title_format *program) {
+	if (!program) {
+		return;
 	}
+	free(program->tokens);
+	free(program);
 }
 
 /**
- * Calculate and return the length of the formatted title.
- * If buffer is not NULL, also populate the buffer with the formatted title.
+ * Splits a title format into literal text and placeholders, so it doesn't have
+ * to be scanned again each time the title is formatted. The tokens point into
+ * format, which has to outlive the result.
  */
-size_t parse_title_format(struct sway_container *container, char *buffer) {
-	if (!container->title_format || strcmp(container->title_format, "%title") == 0) {
-		if (container->view) {
-			return append_prop(buffer, view_get_title(container->view));
-		} else {
-			return container_build_representation(container->pending.layout, container->pending.children, buffer);
+static struct title_format *title_format_compile(const char *format) {
+	struct title_format *program = calloc(1, sizeof(struct title_format));
+	if (!program) {
+		return NULL;
+	}
+	const char *text = format;
+	const char *next = format;
+	while ((next = strchr(next, '%'))) {
+		size_t i = 0;
+		size_t count = sizeof(title_format_placeholders) /
+			sizeof(title_format_placeholders[0]);
+		size_t len = 0;
+		for (; i < count; ++i) {
+			len = strlen(title_format_placeholders[i].placeholder);
+			if (strncmp(next, title_format_placeholders[i].placeholder, len) == 0) {
+				break;
+			}
+		}
+		if (i == count) {
+			// Not a placeholder, the % is kept as text
+			++next;
+			continue;
+		}
+		if (!title_format_add(program, TITLE_FORMAT_TEXT, text, next - text) ||
+				!title_format_add(program,
+					title_format_placeholders[i].type, next, len)) {
+			title_format_destroy(program);
+			return NULL;
+		}
+		next += len;
+		text = next;
+	}
+	if (!title_format_add(program, TITLE_FORMAT_TEXT, text, strlen(text))) {
+		title_format_destroy(program);
+		return NULL;
+	}
+	return program;
+}
+
+void container_set_title_format(struct sway_container *container,
+		char *format) {
+	title_format_destroy(container->title_format_program);
+	free(container->title_format);
+	container->title_format = format;
+	container->title_format_program = NULL;
+	if (format && strcmp(format, "%title") != 0) {
+		container->title_format_program = title_format_compile(format);
+		if (!container->title_format_program) {
+			sway_log(SWAY_ERROR, "Unable to compile title format '%s'", format);
 		}
 	}
+}
 
-	size_t len = 0;
-	char *format = container->title_format;
-	char *next = strchr(format, '%');
-	while (next) {
-		// Copy everything up to the %
-		lenient_strncat(buffer, format, next - format);
-		len += next - format;
-		format = next;
+static void append_representation(struct title_buffer *buf,
+		enum sway_container_layout layout, list_t *children);
 
-		if (strncmp(next, "%title", 6) == 0) {
-			if (container->view) {
-				len += append_prop(buffer, view_get_title(container->view));
+static void append_title(struct title_buffer *buf,
+		struct sway_container *container) {
+	if (container->view) {
+		title_buffer_append_prop(buf, view_get_title(container->view));
+	} else {
+		append_representation(buf, container->pending.layout,
+				container->pending.children);
+	}
+}
+
+char *parse_title_format(struct sway_container *container) {
+	struct title_buffer buf = {0};
+	struct title_format *program = container->title_format_program;
+	if (!program) {
+		// No format, "%title" or a format which failed to compile
+		append_title(&buf, container);
+		return title_buffer_finish(&buf);
+	}
+
+	struct sway_view *view = container->view;
+	for (size_t i = 0; i < program->length; ++i) {
+		struct title_format_token *token = &program->tokens[i];
+		switch (token->type) {
+		case TITLE_FORMAT_TEXT:
+			title_buffer_append(&buf, token->text, token->len);
+			break;
+		case TITLE_FORMAT_TITLE:
+			append_title(&buf, container);
+			break;
+		case TITLE_FORMAT_APP_ID:
+			if (view) {
+				title_buffer_append_prop(&buf, view_get_app_id(view));
 			} else {
-				len += container_build_representation(container->pending.layout, container->pending.children, buffer);
+				title_buffer_append(&buf, token->text, token->len);
 			}
-			format += 6;
-		} else if (container->view) {
-			if (strncmp(next, "%app_id", 7) == 0) {
-				len += append_prop(buffer, view_get_app_id(container->view));
-				format += 7;
-			} else if (strncmp(next, "%class", 6) == 0) {
-				len += append_prop(buffer, view_get_class(container->view));
-				format += 6;
-			} else if (strncmp(next, "%instance", 9) == 0) {
-				len += append_prop(buffer, view_get_instance(container->view));
-				format += 9;
-			} else if (strncmp(next, "%shell", 6) == 0) {
-				len += append_prop(buffer, view_get_shell(container->view));
-				format += 6;
+			break;
+		case TITLE_FORMAT_CLASS:
+			if (view) {
+				title_buffer_append_prop(&buf, view_get_class(view));
 			} else {
-				lenient_strcat(buffer, "%");
-				++format;
-				++len;
+				title_buffer_append(&buf, token->text, token->len);
 			}
-		} else {
-			lenient_strcat(buffer, "%");
-			++format;
-			++len;
+			break;
+		case TITLE_FORMAT_INSTANCE:
+			if (view) {
+				title_buffer_append_prop(&buf, view_get_instance(view));
+			} else {
+				title_buffer_append(&buf, token->text, token->len);
+			}
+			break;
+		case TITLE_FORMAT_SHELL:
+			if (view) {
+				title_buffer_append_prop(&buf, view_get_shell(view));
+			} else {
+				title_buffer_append(&buf, token->text, token->len);
+			}
+			break;
 		}
-		next = strchr(format, '%');
 	}
-	lenient_strcat(buffer, format);
-	len += strlen(format);
-
-	return len;
+	return title_buffer_finish(&buf);
 }
 
-/**
- * Calculate and return the length of the tree representation.
- * An example tree representation is: V[Terminal, Firefox]
- * If buffer is not NULL, also populate the buffer with the representation.
- */
-size_t container_build_representation(enum sway_container_layout layout,
-		list_t *children, char *buffer) {
-	size_t len = 2;
+static void append_representation(struct title_buffer *buf,
+		enum sway_container_layout layout, list_t *children) {
 	switch (layout) {
 	case L_VERT:
-		lenient_strcat(buffer, "V[");
+		title_buffer_append(buf, "V[", 2);
 		break;
 	case L_HORIZ:
-		lenient_strcat(buffer, "H[");
+		title_buffer_append(buf, "H[", 2);
 		break;
 	case L_TABBED:
-		lenient_strcat(buffer, "T[");
+		title_buffer_append(buf, "T[", 2);
 		break;
 	case L_STACKED:
-		lenient_strcat(buffer, "S[");
+		title_buffer_append(buf, "S[", 2);
 		break;
 	case L_NONE:
-		lenient_strcat(buffer, "D[");
+		title_buffer_append(buf, "D[", 2);
 		break;
 	}
 	for (int i = 0; i < children->length; ++i) {
 		if (i != 0) {
-			++len;
-			lenient_strcat(buffer, " ");
+			title_buffer_append(buf, " ", 1);
 		}
 		struct sway_container *child = children->items[i];
 		const char *identifier = NULL;
@@ -772,41 +951,59 @@ size_t container_build_representation(enum sway_container_layout layout,
 		} else {
 			identifier = child->formatted_title;
 		}
-		if (identifier) {
-			len += strlen(identifier);
-			lenient_strcat(buffer, identifier);
-		} else {
-			len += 6;
-			lenient_strcat(buffer, "(null)");
+		if (!identifier) {
+			identifier = "(null)";
 		}
+		title_buffer_append(buf, identifier, strlen(identifier));
 	}
-	++len;
-	lenient_strcat(buffer, "]");
-	return len;
+	title_buffer_append(buf, "]", 1);
+}
+
+char *container_build_representation(enum sway_container_layout layout,
+		list_t *children) {
+	struct title_buffer buf = {0};
+	append_representation(&buf, layout, children);
+	return title_buffer_finish(&buf);
 }
 
 void container_update_representation(struct sway_container *con) {
-	if (!con->view) {
-		size_t len = parse_title_format(con, NULL);
-		free(con->formatted_title);
-		con->formatted_title = calloc(len + 1, sizeof(char));
-		if (!sway_assert(con->formatted_title,
-					"Unable to allocate title string")) {
-			return;
+	// Only mark the path to the workspace here. Rebuilding is left to the
+	// transaction commit, so a batch of tree changes formats each ancestor
+	// once instead of once per change.
+	while (con) {
+		if (!con->view) {
+			con->representation_dirty = true;
+			node_set_dirty(&con->node);
 		}
-		parse_title_format(con, con->formatted_title);
-
-		if (con->title_bar.title_text) {
-			sway_text_node_set_text(con->title_bar.title_text, con->formatted_title);
-			container_arrange_title_bar(con);
-		} else {
-			container_update_title_bar(con);
+		if (!con->pending.parent && con->pending.workspace) {
+			workspace_update_representation(con->pending.workspace);
 		}
+		con = con->pending.parent;
 	}
-	if (con->pending.parent) {
-		container_update_representation(con->pending.parent);
-	} else if (con->pending.workspace) {
-		workspace_update_representation(con->pending.workspace);
+}
+
+void container_flush_representation(struct sway_container *con) {
+	if (!con->representation_dirty) {
+		return;
+	}
+	con->representation_dirty = false;
+	// Split containers name their split children by their formatted titles
+	for (int i = 0; i < con->pending.children->length; ++i) {
+		container_flush_representation(con->pending.children->items[i]);
+	}
+
+	char *title = parse_title_format(con);
+	if (!sway_assert(title, "Unable to allocate title string")) {
+		return;
+	}
+	free(con->formatted_title);
+	con->formatted_title = title;
+
+	if (con->title_bar.title_text) {
+		sway_text_node_set_text(con->title_bar.title_text, con->formatted_title);
+		container_arrange_title_bar(con);
+	} else {
+		container_update_title_bar(con);
 	}
 }
 
@@ -1614,12 +1811,31 @@ static bool find_by_mark_iterator(struct sway_container *con, void *data) {
 }
 
 struct sway_container *container_find_mark(char *mark) {
-	return root_find_container(find_by_mark_iterator, mark);
+	list_t *candidates = hashmap_get(root->containers_by_mark, mark);
+	struct sway_container *match = NULL;
+	for (int i = 0; candidates && i < candidates->length; ++i) {
+		struct sway_container *con = candidates->items[i];
+		if (!root_has_container(con)) {
+			continue;
+		}
+		if (match) {
+			// Let the traversal pick between duplicates
+			return root_find_container(find_by_mark_iterator, mark);
+		}
+		match = con;
+	}
+	return match;
+}
+
+struct sway_container *container_by_id(size_t id) {
+	char key[32];
+	container_id_key(id, key, sizeof(key));
+	struct sway_container *con = hashmap_get(root->containers_by_id, key);
+	return con && root_has_container(con) ? con : NULL;
 }
 
 bool container_find_and_unmark(char *mark) {
-	struct sway_container *con = root_find_container(
-		find_by_mark_iterator, mark);
+	struct sway_container *con = container_find_mark(mark);
 	if (!con) {
 		return false;
 	}
@@ -1627,6 +1843,7 @@ bool container_find_and_unmark(char *mark) {
 	for (int i = 0; i < con->marks->length; ++i) {
 		char *con_mark = con->marks->items[i];
 		if (strcmp(con_mark, mark) == 0) {
+			root_index_remove(root->containers_by_mark, con_mark, con);
 			free(con_mark);
 			list_del(con->marks, i);
 			container_update_marks(con);
@@ -1639,6 +1856,7 @@ bool container_find_and_unmark(char *mark) {
 
 void container_clear_marks(struct sway_container *con) {
 	for (int i = 0; i < con->marks->length; ++i) {
+		root_index_remove(root->containers_by_mark, con->marks->items[i], con);
 		free(con->marks->items[i]);
 	}
 	con->marks->length = 0;
@@ -1657,6 +1875,7 @@ bool container_has_mark(struct sway_container *con, char *mark) {
 
 void container_add_mark(struct sway_container *con, char *mark) {
 	list_add(con->marks, strdup(mark));
+	root_index_add(root->containers_by_mark, mark, con);
 	ipc_event_window(con, "mark");
 }
 
@@ -5,6 +5,7 @@
 #include "sway/ipc-server.h"
 #include "sway/layers.h"
 #include "sway/output.h"
+#include "sway/scene_descriptor.h"
 #include "sway/tree/arrange.h"
 #include "sway/tree/workspace.h"
 #include "sway/server.h"
@@ -124,6 +125,23 @@ struct sway_output *output_create(struct wlr_output *wlr_output) {
 		}
 	}
 
+	// Lets the repaint of an output skip the layers of all other outputs
+	struct wlr_scene_tree *layers[] = {
+		output->layers.shell_background,
+		output->layers.shell_bottom,
+		output->layers.tiling,
+		output->layers.fullscreen,
+		output->layers.shell_top,
+		output->layers.shell_overlay,
+		output->layers.session_lock,
+	};
+	for (size_t i = 0; !failed && i < sizeof(layers) / sizeof(layers[0]); ++i) {
+		if (!scene_descriptor_assign(&layers[i]->node,
+				SWAY_SCENE_DESC_OUTPUT, output)) {
+			failed = true;
+		}
+	}
+
 	if (failed) {
 		destroy_scene_layers(output);
 		wlr_scene_output_destroy(output->scene_output);
@@ -271,6 +289,7 @@ void output_destroy(struct sway_output *output) {
 	}
 
 	destroy_scene_layers(output);
+	hit_index_finish(&output->tiling_hits);
 	list_free(output->workspaces);
 	list_free(output->current.workspaces);
 	wl_event_source_remove(output->repaint_timer);
@@ -290,6 +309,10 @@ void output_disable(struct sway_output *output) {
 	sway_log(SWAY_DEBUG, "Disabling output '%s'", output->wlr_output->name);
 	wl_signal_emit_mutable(&output->events.disable, output);
 
+	// The index may outlive the containers it refers to until the output is
+	// arranged again
+	output->tiling_hits.valid = false;
+
 	output_evacuate(output);
 
 	list_del(root->outputs, index);
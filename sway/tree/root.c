@@ -80,11 +80,28 @@ struct sway_root *root_create(struct wl_display *wl_display) {
 	root->outputs = create_list();
 	root->non_desktop_outputs = create_list();
 	root->scratchpad = create_list();
+	root->workspaces_by_name = create_hashmap();
+	root->workspaces_by_number = create_hashmap();
+	root->containers_by_mark = create_hashmap();
+	root->containers_by_id = create_hashmap();
 
 	return root;
 }
 
+static void free_index_list(const char *key, void *value, void *data) {
+	list_free(value);
+}
+
+static void index_destroy(hashmap_t *index) {
+	hashmap_for_each(index, free_index_list, NULL);
+	hashmap_free(index);
+}
+
 void root_destroy(struct sway_root *root) {
+	index_destroy(root->workspaces_by_name);
+	index_destroy(root->workspaces_by_number);
+	index_destroy(root->containers_by_mark);
+	hashmap_free(root->containers_by_id);
 	list_free(root->scratchpad);
 	list_free(root->non_desktop_outputs);
 	list_free(root->outputs);
@@ -326,6 +343,53 @@ struct sway_container *root_find_container(
 	return NULL;
 }
 
+void root_index_add(hashmap_t *index, const char *key, void *item) {
+	list_t *items = hashmap_get(index, key);
+	if (!items) {
+		items = create_list();
+		hashmap_set(index, key, items);
+	}
+	list_add(items, item);
+}
+
+void root_index_remove(hashmap_t *index, const char *key, void *item) {
+	list_t *items = hashmap_get(index, key);
+	if (!items) {
+		return;
+	}
+	int i = list_find(items, item);
+	if (i != -1) {
+		list_del(items, i);
+	}
+	if (!items->length) {
+		hashmap_remove(index, key);
+		list_free(items);
+	}
+}
+
+bool root_has_workspace(struct sway_workspace *ws) {
+	struct sway_output *output = ws->output;
+	return output && list_find(root->outputs, output) != -1 &&
+		list_find(output->workspaces, ws) != -1;
+}
+
+bool root_has_container(struct sway_container *con) {
+	if (con->node.destroying) {
+		return false;
+	}
+	while (con->pending.parent) {
+		con = con->pending.parent;
+	}
+	struct sway_workspace *ws = con->pending.workspace;
+	if (!ws) {
+		return container_is_scratchpad_hidden(con);
+	}
+	if (ws->output && ws->output == root->fallback_output) {
+		return list_find(ws->output->workspaces, ws) != -1;
+	}
+	return root_has_workspace(ws);
+}
+
 void root_get_box(struct sway_root *root, struct wlr_box *box) {
 	box->x = root->x;
 	box->y = root->y;
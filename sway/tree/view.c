@@ -1014,17 +1014,18 @@ void view_update_title(struct sway_view *view, bool force) {
 	free(view->container->title);
 	free(view->container->formatted_title);
 
-	size_t len = parse_title_format(view->container, NULL);
+	char *buffer = parse_title_format(view->container);
+	if (!sway_assert(buffer, "Unable to allocate title string")) {
+		view->container->title = NULL;
+		view->container->formatted_title = NULL;
+		return;
+	}
+	size_t len = strlen(buffer);
 
 	if (len) {
-		char *buffer = calloc(len + 1, sizeof(char));
-		if (!sway_assert(buffer, "Unable to allocate title string")) {
-			return;
-		}
-
-		parse_title_format(view->container, buffer);
 		view->container->formatted_title = buffer;
 	} else {
+		free(buffer);
 		view->container->formatted_title = NULL;
 	}
 
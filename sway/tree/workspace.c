@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include "stringop.h"
 #include "sway/input/input-manager.h"
@@ -14,6 +15,7 @@
 #include "sway/tree/arrange.h"
 #include "sway/tree/container.h"
 #include "sway/tree/node.h"
+#include "sway/tree/root.h"
 #include "sway/tree/view.h"
 #include "sway/tree/workspace.h"
 #include "list.h"
@@ -54,6 +56,38 @@ struct sway_output *workspace_get_initial_output(const char *name) {
 	return root->outputs->length ? root->outputs->items[0] : root->fallback_output;
 }
 
+/**
+ * Returns the key used for the workspace in root->workspaces_by_name, which
+ * folds case the same way strcasecmp does for the names we compare.
+ */
+static char *workspace_name_key(const char *name) {
+	char *key = strdup(name);
+	for (char *p = key; p && *p; ++p) {
+		if (*p >= 'A' && *p <= 'Z') {
+			*p += 'a' - 'A';
+		}
+	}
+	return key;
+}
+
+/**
+ * Adds the workspace to, or removes it from, the root name and number indexes
+ * depending on which of root_index_add or root_index_remove is passed.
+ */
+static void workspace_update_index(struct sway_workspace *ws,
+		void (*update)(hashmap_t *index, const char *key, void *item)) {
+	char *key = workspace_name_key(ws->name);
+	if (key) {
+		update(root->workspaces_by_name, key, ws);
+		free(key);
+	}
+	size_t len = strspn(ws->name, "0123456789");
+	if (len && (key = strndup(ws->name, len))) {
+		update(root->workspaces_by_number, key, ws);
+		free(key);
+	}
+}
+
 struct sway_workspace *workspace_create(struct sway_output *output,
 		const char *name) {
 	sway_assert(name, "NULL name given to workspace_create");
@@ -84,6 +118,7 @@ struct sway_workspace *workspace_create(struct sway_output *output,
 	}
 
 	ws->name = strdup(name);
+	workspace_update_index(ws, root_index_add);
 	ws->prev_split_layout = L_NONE;
 	ws->layout = output_get_default_layout(output);
 	ws->floating = create_list();
@@ -148,6 +183,7 @@ void workspace_destroy(struct sway_workspace *workspace) {
 	wlr_scene_node_destroy(&workspace->layers.tiling->node);
 	wlr_scene_node_destroy(&workspace->layers.fullscreen->node);
 
+	workspace_update_index(workspace, root_index_remove);
 	free(workspace->name);
 	free(workspace->representation);
 	list_free_items_and_destroy(workspace->output_priority);
@@ -158,6 +194,13 @@ void workspace_destroy(struct sway_workspace *workspace) {
 	free(workspace);
 }
 
+void workspace_set_name(struct sway_workspace *workspace, char *name) {
+	workspace_update_index(workspace, root_index_remove);
+	free(workspace->name);
+	workspace->name = name;
+	workspace_update_index(workspace, root_index_add);
+}
+
 void workspace_begin_destroy(struct sway_workspace *workspace) {
 	sway_log(SWAY_DEBUG, "Destroying workspace '%s'", workspace->name);
 	ipc_event_workspace(NULL, workspace, "empty"); // intentional
@@ -354,14 +397,54 @@ static bool _workspace_by_number(struct sway_workspace *ws, void *data) {
 	return !isdigit(*ws_name);
 }
 
+/**
+ * Picks the result of a lookup from the candidates stored in an index. If
+ * more than one of them is in the tree, falls back to the traversal so the
+ * same workspace is returned as before.
+ */
+static struct sway_workspace *find_indexed_workspace(list_t *candidates,
+		bool (*test)(struct sway_workspace *ws, void *data), void *data) {
+	struct sway_workspace *match = NULL;
+	for (int i = 0; candidates && i < candidates->length; ++i) {
+		struct sway_workspace *ws = candidates->items[i];
+		if (!root_has_workspace(ws)) {
+			continue;
+		}
+		if (match) {
+			return root_find_workspace(test, data);
+		}
+		match = ws;
+	}
+	return match;
+}
+
 struct sway_workspace *workspace_by_number(const char* name) {
-	return root_find_workspace(_workspace_by_number, (void *) name);
+	size_t len = strspn(name, "0123456789");
+	char *key = len ? strndup(name, len) : NULL;
+	if (!key) {
+		return root_find_workspace(_workspace_by_number, (void *) name);
+	}
+	list_t *candidates = hashmap_get(root->workspaces_by_number, key);
+	free(key);
+	return find_indexed_workspace(candidates, _workspace_by_number,
+			(void *) name);
 }
 
 static bool _workspace_by_name(struct sway_workspace *ws, void *data) {
 	return strcasecmp(ws->name, data) == 0;
 }
 
+static struct sway_workspace *find_workspace_by_name(const char *name) {
+	char *key = workspace_name_key(name);
+	if (!key) {
+		return root_find_workspace(_workspace_by_name, (void *) name);
+	}
+	list_t *candidates = hashmap_get(root->workspaces_by_name, key);
+	free(key);
+	return find_indexed_workspace(candidates, _workspace_by_name,
+			(void *) name);
+}
+
 struct sway_workspace *workspace_by_name(const char *name) {
 	struct sway_seat *seat = input_manager_current_seat();
 	struct sway_workspace *current = seat_get_focused_workspace(seat);
@@ -381,10 +464,9 @@ struct sway_workspace *workspace_by_name(const char *name) {
 		if (!seat->prev_workspace_name) {
 			return NULL;
 		}
-		return root_find_workspace(_workspace_by_name,
-				(void*)seat->prev_workspace_name);
+		return find_workspace_by_name(seat->prev_workspace_name);
 	} else {
-		return root_find_workspace(_workspace_by_name, (void*)name);
+		return find_workspace_by_name(name);
 	}
 }
 
@@ -935,13 +1017,24 @@ struct sway_container *workspace_split(struct sway_workspace *workspace,
 }
 
 void workspace_update_representation(struct sway_workspace *ws) {
-	size_t len = container_build_representation(ws->layout, ws->tiling, NULL);
-	free(ws->representation);
-	ws->representation = calloc(len + 1, sizeof(char));
-	if (!sway_assert(ws->representation, "Unable to allocate title string")) {
+	ws->representation_dirty = true;
+	node_set_dirty(&ws->node);
+}
+
+void workspace_flush_representation(struct sway_workspace *ws) {
+	if (!ws->representation_dirty) {
+		return;
+	}
+	ws->representation_dirty = false;
+	for (int i = 0; i < ws->tiling->length; ++i) {
+		container_flush_representation(ws->tiling->items[i]);
+	}
+	char *representation = container_build_representation(ws->layout, ws->tiling);
+	if (!sway_assert(representation, "Unable to allocate title string")) {
 		return;
 	}
-	container_build_representation(ws->layout, ws->tiling, ws->representation);
+	free(ws->representation);
+	ws->representation = representation;
 }
 
 void workspace_get_box(struct sway_workspace *workspace, struct wlr_box *box) {
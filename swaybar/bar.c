@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -18,6 +19,7 @@
 #include "swaybar/ipc.h"
 #include "swaybar/status_line.h"
 #include "swaybar/render.h"
+#include "swaybar/text.h"
 #if HAVE_TRAY
 #include "swaybar/tray/tray.h"
 #endif
@@ -43,7 +45,9 @@ static void swaybar_output_free(struct swaybar_output *output) {
 	if (!output) {
 		return;
 	}
-	sway_log(SWAY_DEBUG, "Removing output %s", output->name);
+	sway_log(SWAY_DEBUG, "Removing output %s (%" PRIu64 " of %" PRIu64
+			" updates coalesced)", output->name, output->coalesced_updates,
+			output->updates);
 	if (output->layer_surface != NULL) {
 		zwlr_layer_surface_v1_destroy(output->layer_surface);
 	}
@@ -51,8 +55,8 @@ static void swaybar_output_free(struct swaybar_output *output) {
 		wl_surface_destroy(output->surface);
 	}
 	wl_output_destroy(output->output);
-	destroy_buffer(&output->buffers[0]);
-	destroy_buffer(&output->buffers[1]);
+	buffer_pool_finish(&output->buffer_pool);
+	render_invalidate(output);
 	free_hotspots(&output->hotspots);
 	free_workspaces(&output->workspaces);
 	wl_list_remove(&output->link);
@@ -61,11 +65,27 @@ static void swaybar_output_free(struct swaybar_output *output) {
 	free(output);
 }
 
+/**
+ * Marks the output as needing a new frame. The frame is rendered once the
+ * pending events have been handled, or when the compositor is ready for it
+ * if a frame is still scheduled, so that a burst of updates only results in
+ * rendering the latest state once.
+ */
 static void set_output_dirty(struct swaybar_output *output) {
-	if (output->frame_scheduled) {
-		output->dirty = true;
-	} else if (output->surface) {
-		render_frame(output);
+	++output->updates;
+	if (output->dirty) {
+		++output->coalesced_updates;
+	}
+	output->dirty = true;
+}
+
+static void render_dirty_outputs(struct swaybar *bar) {
+	struct swaybar_output *output;
+	wl_list_for_each(output, &bar->outputs, link) {
+		if (output->dirty && !output->frame_scheduled && output->surface) {
+			output->dirty = false;
+			render_frame(output);
+		}
 	}
 }
 
@@ -129,6 +149,7 @@ void destroy_layer_surface(struct swaybar_output *output) {
 	output->layer_surface = NULL;
 	output->width = 0;
 	output->frame_scheduled = false;
+	render_invalidate(output);
 }
 
 void set_bar_dirty(struct swaybar *bar) {
@@ -352,6 +373,7 @@ static void handle_global(void *data, struct wl_registry *registry,
 		wl_list_init(&output->workspaces);
 		wl_list_init(&output->hotspots);
 		wl_list_init(&output->link);
+		buffer_pool_init(&output->buffer_pool);
 		if (bar->xdg_output_manager != NULL) {
 			add_xdg_output(output);
 		}
@@ -404,6 +426,11 @@ bool bar_setup(struct swaybar *bar, const char *socket_path) {
 	wl_list_init(&bar->unused_outputs);
 	wl_list_init(&bar->seats);
 	bar->eventloop = loop_create();
+	bar->text_cache = text_cache_create();
+	if (!bar->text_cache) {
+		sway_log(SWAY_ERROR, "Unable to allocate text cache");
+		return false;
+	}
 
 	bar->ipc_socketfd = ipc_open_socket(socket_path);
 	bar->ipc_event_socketfd = ipc_open_socket(socket_path);
@@ -512,6 +539,7 @@ void bar_run(struct swaybar *bar) {
 	}
 #endif
 	while (bar->running) {
+		render_dirty_outputs(bar);
 		errno = 0;
 		if (wl_display_flush(bar->display) == -1 && errno != EAGAIN) {
 			break;
@@ -549,6 +577,7 @@ void bar_teardown(struct swaybar *bar) {
 	if (bar->status) {
 		status_line_free(bar->status);
 	}
+	text_cache_destroy(bar->text_cache);
 	free(bar->id);
 	free(bar->mode);
 }
@@ -1,6 +1,7 @@
 #include <json.h>
 #include <linux/input-event-codes.h>
 #include <ctype.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -23,6 +24,7 @@ void i3bar_block_unref(struct i3bar_block *block) {
 		free(block->min_width_str);
 		free(block->name);
 		free(block->instance);
+		free(block->json);
 		free(block);
 	}
 }
@@ -40,82 +42,313 @@ static bool i3bar_parse_json_color(json_object *json, uint32_t *color) {
 	return color_set;
 }
 
-static void i3bar_parse_json(struct status_line *status,
-		struct json_object *json_array) {
+static struct i3bar_block *i3bar_block_create(json_object *json) {
+	json_object *full_text, *short_text, *color, *min_width, *align, *urgent;
+	json_object *name, *instance, *separator, *separator_block_width;
+	json_object *background, *border, *border_top, *border_bottom;
+	json_object *border_left, *border_right, *markup;
+	json_object_object_get_ex(json, "full_text", &full_text);
+	json_object_object_get_ex(json, "short_text", &short_text);
+	json_object_object_get_ex(json, "color", &color);
+	json_object_object_get_ex(json, "min_width", &min_width);
+	json_object_object_get_ex(json, "align", &align);
+	json_object_object_get_ex(json, "urgent", &urgent);
+	json_object_object_get_ex(json, "name", &name);
+	json_object_object_get_ex(json, "instance", &instance);
+	json_object_object_get_ex(json, "markup", &markup);
+	json_object_object_get_ex(json, "separator", &separator);
+	json_object_object_get_ex(json, "separator_block_width", &separator_block_width);
+	json_object_object_get_ex(json, "background", &background);
+	json_object_object_get_ex(json, "border", &border);
+	json_object_object_get_ex(json, "border_top", &border_top);
+	json_object_object_get_ex(json, "border_bottom", &border_bottom);
+	json_object_object_get_ex(json, "border_left", &border_left);
+	json_object_object_get_ex(json, "border_right", &border_right);
+
+	struct i3bar_block *block = calloc(1, sizeof(struct i3bar_block));
+	if (!block) {
+		return NULL;
+	}
+	block->ref_count = 1;
+	wl_list_init(&block->link);
+	block->full_text = full_text ?
+		strdup(json_object_get_string(full_text)) : NULL;
+	block->short_text = short_text ?
+		strdup(json_object_get_string(short_text)) : NULL;
+	block->color_set = i3bar_parse_json_color(color, &block->color);
+	if (min_width) {
+		json_type type = json_object_get_type(min_width);
+		if (type == json_type_int) {
+			block->min_width = json_object_get_int(min_width);
+		} else if (type == json_type_string) {
+			/* the width will be calculated when rendering */
+			block->min_width_str = strdup(json_object_get_string(min_width));
+		}
+	}
+	block->align = strdup(align ? json_object_get_string(align) : "left");
+	block->urgent = urgent ? json_object_get_int(urgent) : false;
+	block->name = name ? strdup(json_object_get_string(name)) : NULL;
+	block->instance = instance ?
+		strdup(json_object_get_string(instance)) : NULL;
+	if (markup) {
+		block->markup = false;
+		const char *markup_str = json_object_get_string(markup);
+		if (strcmp(markup_str, "pango") == 0) {
+			block->markup = true;
+		}
+	}
+	block->separator = separator ? json_object_get_int(separator) : true;
+	block->separator_block_width = separator_block_width ?
+		json_object_get_int(separator_block_width) : 9;
+	// Airblader features
+	i3bar_parse_json_color(background, &block->background);
+	block->border_set = i3bar_parse_json_color(border, &block->border);
+	block->border_top = border_top ? json_object_get_int(border_top) : 1;
+	block->border_bottom = border_bottom ?
+		json_object_get_int(border_bottom) : 1;
+	block->border_left = border_left ? json_object_get_int(border_left) : 1;
+	block->border_right = border_right ?
+		json_object_get_int(border_right) : 1;
+	return block;
+}
+
+static bool str_equal(const char *a, const char *b) {
+	return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static bool i3bar_block_same_id(const struct i3bar_block *a,
+		const struct i3bar_block *b) {
+	return str_equal(a->name, b->name) && str_equal(a->instance, b->instance);
+}
+
+static bool i3bar_block_equal(const struct i3bar_block *a,
+		const struct i3bar_block *b) {
+	// min_width is computed from min_width_str when rendering
+	return str_equal(a->full_text, b->full_text) &&
+		str_equal(a->short_text, b->short_text) &&
+		str_equal(a->align, b->align) &&
+		str_equal(a->min_width_str, b->min_width_str) &&
+		(a->min_width_str || a->min_width == b->min_width) &&
+		a->urgent == b->urgent &&
+		a->color == b->color && a->color_set == b->color_set &&
+		a->separator == b->separator &&
+		a->separator_block_width == b->separator_block_width &&
+		a->markup == b->markup &&
+		a->background == b->background &&
+		a->border == b->border && a->border_set == b->border_set &&
+		a->border_top == b->border_top &&
+		a->border_bottom == b->border_bottom &&
+		a->border_left == b->border_left &&
+		a->border_right == b->border_right;
+}
+
+/**
+ * Finds the end of the JSON value at the start of text, which must not start
+ * with whitespace. Returns its length, 0 if it is incomplete or -1 if it is
+ * invalid. Only the nesting is checked here, values are validated when they
+ * are parsed.
+ */
+static ssize_t i3bar_scan_value(const char *text, size_t len) {
+	if (len == 0) {
+		return 0;
+	}
+	if (text[0] != '[' && text[0] != '{' && text[0] != '"') {
+		// Literal, ends at the next delimiter
+		for (size_t i = 0; i < len; ++i) {
+			if (text[i] == ',' || text[i] == ']' || text[i] == '}' ||
+					isspace((unsigned char)text[i])) {
+				return i > 0 ? (ssize_t)i : -1;
+			}
+		}
+		return 0;
+	}
+
+	size_t depth = 0;
+	bool in_string = false;
+	for (size_t i = 0; i < len; ++i) {
+		char c = text[i];
+		if (in_string) {
+			if (c == '\\') {
+				++i;
+			} else if (c == '"') {
+				in_string = false;
+				if (depth == 0) {
+					return i + 1;
+				}
+			}
+		} else if (c == '"') {
+			in_string = true;
+		} else if (c == '[' || c == '{') {
+			++depth;
+		} else if (c == ']' || c == '}') {
+			if (depth == 0) {
+				return -1;
+			}
+			if (--depth == 0) {
+				return i + 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Checks that a complete value is valid JSON. Used for the values that are
+ * not parsed into blocks, so that a malformed status line is still reported.
+ */
+static bool i3bar_validate_value(struct status_line *status, const char *text,
+		size_t len) {
+	json_tokener_reset(status->tokener);
+	json_object *json = json_tokener_parse_ex(status->tokener, text, len);
+	enum json_tokener_error err = json_tokener_get_error(status->tokener);
+	json_object_put(json);
+	if (err != json_tokener_success) {
+		sway_log(SWAY_DEBUG, "Failed to parse i3bar json - %s: '%.*s'",
+				json_tokener_error_desc(err), (int)len, text);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Updates the blocks from the text of a complete status array. Blocks whose
+ * JSON text did not change are kept without parsing them again, and blocks
+ * with the same name and instance whose properties did not change are kept
+ * as well. Returns false if the array is invalid.
+ */
+static bool i3bar_parse_array(struct status_line *status, const char *text,
+		size_t len, bool *changed) {
+	// The blocks are listed from right to left
+	int old_len = wl_list_length(&status->blocks);
+	struct i3bar_block **old = calloc(2 * old_len + 1, sizeof(*old));
+	if (!old) {
+		return false;
+	}
+	struct i3bar_block **prev = &old[old_len];
+	int i = old_len;
 	struct i3bar_block *block, *tmp;
-	wl_list_for_each_safe(block, tmp, &status->blocks, link) {
-		wl_list_remove(&block->link);
-		i3bar_block_unref(block);
+	wl_list_for_each(block, &status->blocks, link) {
+		old[--i] = block;
+		prev[i] = block;
+	}
+
+	struct wl_list blocks;
+	wl_list_init(&blocks);
+	*changed = false;
+	bool valid = true;
+	int index = 0;
+
+	size_t pos = 1; // skip '['
+	size_t end = len - 1; // the closing ']'
+	while (pos < end && isspace(text[pos])) {
+		++pos;
 	}
-	for (size_t i = 0; i < json_object_array_length(json_array); ++i) {
-		json_object *full_text, *short_text, *color, *min_width, *align, *urgent;
-		json_object *name, *instance, *separator, *separator_block_width;
-		json_object *background, *border, *border_top, *border_bottom;
-		json_object *border_left, *border_right, *markup;
-		json_object *json = json_object_array_get_idx(json_array, i);
-		if (!json) {
-			continue;
+	while (pos < end) {
+		const char *element = &text[pos];
+		ssize_t element_len = i3bar_scan_value(element, end - pos);
+		if (element_len <= 0) {
+			valid = false;
+			break;
+		}
+		pos += element_len;
+		while (pos < end && isspace(text[pos])) {
+			++pos;
+		}
+		if (pos < end) {
+			if (text[pos] != ',') {
+				valid = false;
+				break;
+			}
+			++pos;
+			while (pos < end && isspace(text[pos])) {
+				++pos;
+			}
+			if (pos == end) {
+				valid = false; // trailing comma
+				break;
+			}
+		}
+		if (element[0] != '{') {
+			continue; // not a block
 		}
-		json_object_object_get_ex(json, "full_text", &full_text);
-		json_object_object_get_ex(json, "short_text", &short_text);
-		json_object_object_get_ex(json, "color", &color);
-		json_object_object_get_ex(json, "min_width", &min_width);
-		json_object_object_get_ex(json, "align", &align);
-		json_object_object_get_ex(json, "urgent", &urgent);
-		json_object_object_get_ex(json, "name", &name);
-		json_object_object_get_ex(json, "instance", &instance);
-		json_object_object_get_ex(json, "markup", &markup);
-		json_object_object_get_ex(json, "separator", &separator);
-		json_object_object_get_ex(json, "separator_block_width", &separator_block_width);
-		json_object_object_get_ex(json, "background", &background);
-		json_object_object_get_ex(json, "border", &border);
-		json_object_object_get_ex(json, "border_top", &border_top);
-		json_object_object_get_ex(json, "border_bottom", &border_bottom);
-		json_object_object_get_ex(json, "border_left", &border_left);
-		json_object_object_get_ex(json, "border_right", &border_right);
 
-		struct i3bar_block *block = calloc(1, sizeof(struct i3bar_block));
-		block->ref_count = 1;
-		block->full_text = full_text ?
-			strdup(json_object_get_string(full_text)) : NULL;
-		block->short_text = short_text ?
-			strdup(json_object_get_string(short_text)) : NULL;
-		block->color_set = i3bar_parse_json_color(color, &block->color);
-		if (min_width) {
-			json_type type = json_object_get_type(min_width);
-			if (type == json_type_int) {
-				block->min_width = json_object_get_int(min_width);
-			} else if (type == json_type_string) {
-				/* the width will be calculated when rendering */
-				block->min_width_str = strdup(json_object_get_string(min_width));
+		// Look for a block with the same JSON text, first at the same index
+		block = NULL;
+		for (int j = 0; j < old_len; ++j) {
+			struct i3bar_block *candidate = old[(index + j) % old_len];
+			if (candidate && candidate->json_len == (size_t)element_len &&
+					memcmp(candidate->json, element, element_len) == 0) {
+				block = candidate;
+				old[(index + j) % old_len] = NULL;
+				break;
 			}
 		}
-		block->align = strdup(align ? json_object_get_string(align) : "left");
-		block->urgent = urgent ? json_object_get_int(urgent) : false;
-		block->name = name ? strdup(json_object_get_string(name)) : NULL;
-		block->instance = instance ?
-			strdup(json_object_get_string(instance)) : NULL;
-		if (markup) {
-			block->markup = false;
-			const char *markup_str = json_object_get_string(markup);
-			if (strcmp(markup_str, "pango") == 0) {
-				block->markup = true;
+
+		if (!block) {
+			json_tokener_reset(status->tokener);
+			json_object *json = json_tokener_parse_ex(status->tokener,
+					element, element_len);
+			if (json_tokener_get_error(status->tokener) != json_tokener_success) {
+				sway_log(SWAY_DEBUG, "Failed to parse i3bar block - %s: '%.*s'",
+						json_tokener_error_desc(
+							json_tokener_get_error(status->tokener)),
+						(int)element_len, element);
+				json_object_put(json);
+				valid = false;
+				break;
+			}
+			struct i3bar_block *parsed = i3bar_block_create(json);
+			json_object_put(json);
+			char *raw = strndup(element, element_len);
+			if (!parsed || !raw) {
+				i3bar_block_unref(parsed);
+				free(raw);
+				valid = false;
+				break;
 			}
+
+			// Keep the block with the same name and instance if only the
+			// formatting of its JSON changed
+			for (int j = 0; j < old_len; ++j) {
+				struct i3bar_block *candidate = old[(index + j) % old_len];
+				if (candidate && i3bar_block_same_id(candidate, parsed)) {
+					if (i3bar_block_equal(candidate, parsed)) {
+						block = candidate;
+						old[(index + j) % old_len] = NULL;
+					}
+					break;
+				}
+			}
+			if (block) {
+				i3bar_block_unref(parsed);
+				free(block->json);
+			} else {
+				block = parsed;
+			}
+			block->json = raw;
+			block->json_len = element_len;
+		}
+
+		if (index >= old_len || block != prev[index]) {
+			*changed = true;
+		}
+		wl_list_remove(&block->link);
+		wl_list_insert(&blocks, &block->link);
+		++index;
+	}
+
+	if (valid) {
+		if (index != old_len) {
+			*changed = true;
+		}
+		wl_list_for_each_safe(block, tmp, &status->blocks, link) {
+			wl_list_remove(&block->link);
+			i3bar_block_unref(block);
 		}
-		block->separator = separator ? json_object_get_int(separator) : true;
-		block->separator_block_width = separator_block_width ?
-			json_object_get_int(separator_block_width) : 9;
-		// Airblader features
-		i3bar_parse_json_color(background, &block->background);
-		block->border_set = i3bar_parse_json_color(border, &block->border);
-		block->border_top = border_top ? json_object_get_int(border_top) : 1;
-		block->border_bottom = border_bottom ?
-			json_object_get_int(border_bottom) : 1;
-		block->border_left = border_left ? json_object_get_int(border_left) : 1;
-		block->border_right = border_right ?
-			json_object_get_int(border_right) : 1;
-		wl_list_insert(&status->blocks, &block->link);
 	}
+	wl_list_insert_list(&status->blocks, &blocks);
+	free(old);
+	return valid;
 }
 
 bool i3bar_handle_readable(struct status_line *status) {
@@ -149,15 +382,16 @@ bool i3bar_handle_readable(struct status_line *status) {
 		}
 	}
 
-	struct json_object *last_object = NULL;
-	struct json_object *test_object;
+	// Only the last complete array is used, so the arrays are not parsed
+	// here. Their text is kept until the blocks are updated from it.
+	char *last_array = NULL;
+	size_t last_array_len = 0;
 	size_t buffer_pos = 0;
 	while (true) {
 		// since the incoming stream is an infinite array
 		// parsing is split into two parts
-		// first, attempt to parse the current object, reading more if the
-		// parser indicates that the current object is incomplete, and failing
-		// if the parser fails
+		// first, find the end of the current value, reading more if it is
+		// incomplete, and failing if it is invalid
 		// second, look for separating comma, ignoring whitespace, failing if
 		// any other characters are encountered
 		if (status->expecting_comma) {
@@ -170,53 +404,63 @@ bool i3bar_handle_readable(struct status_line *status) {
 					sway_log(SWAY_DEBUG, "Invalid i3bar json: expected ',' but encountered '%c'",
 							status->buffer[buffer_pos]);
 					status_error(status, "[invalid i3bar json]");
+					free(last_array);
 					return true;
 				}
 			}
 			if (buffer_pos < status->buffer_index) {
-				continue; // look for new object without reading more input
+				continue; // look for new value without reading more input
 			}
 			buffer_pos = status->buffer_index = 0;
 		} else {
-			test_object = json_tokener_parse_ex(status->tokener,
-					&status->buffer[buffer_pos], status->buffer_index - buffer_pos);
-			enum json_tokener_error err = json_tokener_get_error(status->tokener);
-			if (err == json_tokener_success) {
-				if (json_object_get_type(test_object) == json_type_array) {
-					if (last_object) {
-						json_object_put(last_object);
-					}
-					last_object = test_object;
-				} else {
-					json_object_put(test_object);
+			while (buffer_pos < status->buffer_index &&
+					isspace(status->buffer[buffer_pos])) {
+				++buffer_pos;
+			}
+			const char *value = &status->buffer[buffer_pos];
+			ssize_t value_len = i3bar_scan_value(value,
+					status->buffer_index - buffer_pos);
+			if (value_len > 0) {
+				sway_log(SWAY_DEBUG, "Received i3bar json: '%.*s'",
+						(int)value_len, value);
+				// Only the last array is parsed into blocks, check the
+				// values that are skipped. A literal is passed along with
+				// the delimiter after it, json-c can't tell where it ends
+				// otherwise.
+				const char *skipped = value;
+				size_t skipped_len = value_len;
+				if (value[0] == '[') {
+					skipped = last_array;
+					skipped_len = last_array_len;
+				} else if (value[0] != '{' && value[0] != '"') {
+					++skipped_len;
 				}
-
-				// in order to print the json for debugging purposes
-				// the last character is temporarily replaced with a null character
-				// (the last character is used in case the buffer is full)
-				char *last_char_pos =
-					&status->buffer[buffer_pos + status->tokener->char_offset - 1];
-				char last_char = *last_char_pos;
-				while (isspace(last_char)) {
-					last_char = *--last_char_pos;
+				if (skipped && !i3bar_validate_value(status, skipped,
+							skipped_len)) {
+					status_error(status, "[failed to parse i3bar json]");
+					free(last_array);
+					return true;
+				}
+				if (value[0] == '[') {
+					free(last_array);
+					last_array = strndup(value, value_len);
+					last_array_len = value_len;
+					if (!last_array) {
+						status_error(status, "[failed to allocate buffer]");
+						return true;
+					}
 				}
-				*last_char_pos = '\0';
-				size_t offset = strspn(&status->buffer[buffer_pos], " \f\n\r\t\v");
-				sway_log(SWAY_DEBUG, "Received i3bar json: '%s%c'",
-						&status->buffer[buffer_pos + offset], last_char);
-				*last_char_pos = last_char;
 
-				buffer_pos += status->tokener->char_offset;
+				buffer_pos += value_len;
 				status->expecting_comma = true;
 
 				if (buffer_pos < status->buffer_index) {
 					continue; // look for comma without reading more input
 				}
 				buffer_pos = status->buffer_index = 0;
-			} else if (err == json_tokener_continue) {
-				json_tokener_reset(status->tokener);
-				if (status->buffer_index < status->buffer_size) {
-					// move the object to the start of the buffer
+			} else if (value_len == 0) {
+				if (buffer_pos > 0 || status->buffer_index < status->buffer_size) {
+					// move the value to the start of the buffer
 					status->buffer_index -= buffer_pos;
 					memmove(status->buffer, &status->buffer[buffer_pos],
 							status->buffer_index);
@@ -229,16 +473,17 @@ bool i3bar_handle_readable(struct status_line *status) {
 						status->buffer = new_buffer;
 					} else {
 						free(status->buffer);
+						status->buffer = NULL;
 						status_error(status, "[failed to allocate buffer]");
+						free(last_array);
 						return true;
 					}
 				}
 			} else {
-				char last_char = status->buffer[status->buffer_index - 1];
-				status->buffer[status->buffer_index - 1] = '\0';
-				sway_log(SWAY_DEBUG, "Failed to parse i3bar json - %s: '%s%c'",
-						json_tokener_error_desc(err), &status->buffer[buffer_pos], last_char);
+				sway_log(SWAY_DEBUG, "Failed to parse i3bar json: '%.*s'",
+						(int)(status->buffer_index - buffer_pos), value);
 				status_error(status, "[failed to parse i3bar json]");
+				free(last_array);
 				return true;
 			}
 		}
@@ -252,18 +497,25 @@ bool i3bar_handle_readable(struct status_line *status) {
 			break;
 		} else {
 			status_error(status, "[error reading from status command]");
+			free(last_array);
 			return true;
 		}
 	}
 
-	if (last_object) {
-		sway_log(SWAY_DEBUG, "Rendering last received json");
-		i3bar_parse_json(status, last_object);
-		json_object_put(last_object);
-		return true;
-	} else {
+	if (!last_array) {
 		return false;
 	}
+	bool changed;
+	if (!i3bar_parse_array(status, last_array, last_array_len, &changed)) {
+		status_error(status, "[failed to parse i3bar json]");
+		free(last_array);
+		return true;
+	}
+	free(last_array);
+	if (changed) {
+		sway_log(SWAY_DEBUG, "Rendering last received json");
+	}
+	return changed;
 }
 
 enum hotspot_event_handling i3bar_block_send_click(struct status_line *status,
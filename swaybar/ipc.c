@@ -6,6 +6,7 @@
 #include <json.h>
 #include "swaybar/config.h"
 #include "swaybar/ipc.h"
+#include "swaybar/render.h"
 #include "swaybar/status_line.h"
 #if HAVE_TRAY
 #include "swaybar/tray/tray.h"
@@ -532,6 +533,11 @@ static bool handle_barconfig_update(struct swaybar *bar, const char *payload,
 
 	bool moving_layer = strcmp(oldcfg->mode, newcfg->mode) != 0;
 
+	// Colors, fonts and paddings may have changed
+	wl_list_for_each(output, &bar->outputs, link) {
+		render_invalidate(output);
+	}
+
 	free_config(oldcfg);
 	determine_bar_visibility(bar, moving_layer);
 	return true;
@@ -1,11 +1,11 @@
 #include <assert.h>
 #include <linux/input-event-codes.h>
 #include <limits.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include "cairo_util.h"
-#include "pango.h"
 #include "pool-buffer.h"
 #include "swaybar/bar.h"
 #include "swaybar/config.h"
@@ -13,6 +13,7 @@
 #include "swaybar/ipc.h"
 #include "swaybar/render.h"
 #include "swaybar/status_line.h"
+#include "swaybar/text.h"
 #include "log.h"
 #if HAVE_TRAY
 #include "swaybar/tray/tray.h"
@@ -22,6 +23,8 @@
 static const int WS_HORIZONTAL_PADDING = 5;
 static const double WS_VERTICAL_PADDING = 1.5;
 static const double BORDER_WIDTH = 1;
+// Text may be drawn slightly outside of its element, e.g. italics
+static const double DAMAGE_MARGIN = 2;
 
 struct render_context {
 	cairo_t *cairo;
@@ -29,8 +32,191 @@ struct render_context {
 	cairo_font_options_t *textaa_sharp;
 	cairo_font_options_t *textaa_safe;
 	uint32_t background_color;
+	struct swaybar_render_frame *frame;
 };
 
+struct render_interval {
+	int start, end;
+};
+
+#define HASH_INIT 2166136261u
+#define HASH_VALUE(hash, value) hash_bytes(hash, &(value), sizeof(value))
+
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t len) {
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t hash_str(uint32_t hash, const char *str) {
+	// Include the terminator so that NULL and "" differ
+	return str ? hash_bytes(hash, str, strlen(str) + 1) : hash;
+}
+
+/**
+ * Starts the hash of an element, which also depends on the background color
+ * left by the previous elements since it picks the text antialiasing.
+ */
+static uint32_t hash_element(struct render_context *ctx) {
+	return HASH_VALUE(HASH_INIT, ctx->background_color);
+}
+
+static void add_region(struct render_context *ctx, double x, double width,
+		uint32_t hash, bool always_damaged) {
+	struct swaybar_render_frame *frame = ctx->frame;
+	if (width <= 0) {
+		return;
+	}
+	if (frame->regions_len == frame->regions_cap) {
+		size_t cap = frame->regions_cap ? frame->regions_cap * 2 : 16;
+		struct swaybar_render_region *regions =
+			realloc(frame->regions, cap * sizeof(*regions));
+		if (!regions) {
+			// Without the region the frame can't be compared to others
+			frame->valid = false;
+			return;
+		}
+		frame->regions = regions;
+		frame->regions_cap = cap;
+	}
+	frame->regions[frame->regions_len++] = (struct swaybar_render_region){
+		.x = x,
+		.width = width,
+		.hash = hash,
+		.always_damaged = always_damaged,
+	};
+}
+
+static bool frame_has_region(const struct swaybar_render_frame *frame,
+		const struct swaybar_render_region *region) {
+	if (region->always_damaged) {
+		return false;
+	}
+	for (size_t i = 0; i < frame->regions_len; ++i) {
+		const struct swaybar_render_region *other = &frame->regions[i];
+		if (other->x == region->x && other->width == region->width &&
+				other->hash == region->hash && !other->always_damaged) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void add_interval(struct render_interval *intervals, size_t *len,
+		const struct swaybar_render_region *region, int32_t scale, int width) {
+	int start = floor((region->x - DAMAGE_MARGIN) * scale);
+	int end = ceil((region->x + region->width + DAMAGE_MARGIN) * scale);
+	intervals[(*len)++] = (struct render_interval){
+		.start = start < 0 ? 0 : start,
+		.end = end > width ? width : end,
+	};
+}
+
+static int interval_compare(const void *a, const void *b) {
+	const struct render_interval *ia = a, *ib = b;
+	return ia->start - ib->start;
+}
+
+/**
+ * Fills intervals, which must fit the regions of both frames, with the
+ * sorted and disjoint horizontal spans in buffer coordinates where the
+ * frames differ. Returns the number of intervals.
+ */
+static size_t frame_damage(const struct swaybar_render_frame *frame,
+		const struct swaybar_render_frame *prev, int32_t scale, int width,
+		struct render_interval *intervals) {
+	if (!frame->valid || !prev->valid || frame->hash != prev->hash) {
+		intervals[0] = (struct render_interval){ .start = 0, .end = width };
+		return 1;
+	}
+
+	size_t len = 0;
+	for (size_t i = 0; i < frame->regions_len; ++i) {
+		if (!frame_has_region(prev, &frame->regions[i])) {
+			add_interval(intervals, &len, &frame->regions[i], scale, width);
+		}
+	}
+	for (size_t i = 0; i < prev->regions_len; ++i) {
+		if (!frame_has_region(frame, &prev->regions[i])) {
+			add_interval(intervals, &len, &prev->regions[i], scale, width);
+		}
+	}
+	if (len == 0) {
+		return 0;
+	}
+
+	qsort(intervals, len, sizeof(*intervals), interval_compare);
+	size_t merged = 0;
+	for (size_t i = 1; i < len; ++i) {
+		if (intervals[i].start <= intervals[merged].end) {
+			if (intervals[i].end > intervals[merged].end) {
+				intervals[merged].end = intervals[i].end;
+			}
+		} else {
+			intervals[++merged] = intervals[i];
+		}
+	}
+	return merged + 1;
+}
+
+static void frame_finish(struct swaybar_render_frame *frame) {
+	free(frame->regions);
+	*frame = (struct swaybar_render_frame){0};
+}
+
+static void frame_copy(struct swaybar_render_frame *dst,
+		const struct swaybar_render_frame *src) {
+	if (dst->regions_cap < src->regions_len) {
+		struct swaybar_render_region *regions = realloc(dst->regions,
+				src->regions_len * sizeof(*regions));
+		if (!regions) {
+			frame_finish(dst);
+			return;
+		}
+		dst->regions = regions;
+		dst->regions_cap = src->regions_len;
+	}
+	if (src->regions_len > 0) {
+		memcpy(dst->regions, src->regions,
+				src->regions_len * sizeof(*dst->regions));
+	}
+	dst->regions_len = src->regions_len;
+	dst->hash = src->hash;
+	dst->valid = src->valid;
+}
+
+void render_invalidate(struct swaybar_output *output) {
+	struct pool_buffer *buffer;
+	wl_list_for_each(buffer, &output->buffer_pool.buffers, link) {
+		if (buffer->user_data) {
+			frame_finish(buffer->user_data);
+		}
+	}
+	frame_finish(&output->surface_frame);
+}
+
+static void destroy_buffer_frame(void *data) {
+	struct swaybar_render_frame *frame = data;
+	frame_finish(frame);
+	free(frame);
+}
+
+/**
+ * Returns the frame which was last drawn to the buffer.
+ */
+static struct swaybar_render_frame *get_buffer_frame(
+		struct pool_buffer *buffer) {
+	if (!buffer->user_data) {
+		buffer->user_data = calloc(1, sizeof(struct swaybar_render_frame));
+		if (buffer->user_data) {
+			buffer->destroy_user_data = destroy_buffer_frame;
+		}
+	}
+	return buffer->user_data;
+}
+
 static void choose_text_aa_mode(struct render_context *ctx, uint32_t fontcolor) {
 	uint32_t salpha = fontcolor & 0xFF;
 	uint32_t balpha = ctx->background_color & 0xFF;
@@ -63,8 +249,8 @@ static uint32_t render_status_line_error(struct render_context *ctx, double *x)
 
 	PangoFontDescription *font = output->bar->config->font_description;
 	int text_width, text_height;
-	get_text_size(cairo, font, &text_width, &text_height, NULL,
-			1, false, "%s", error);
+	text_cache_get_size(output->bar->text_cache, cairo, font, &text_width,
+			&text_height, NULL, 1, false, error);
 
 	uint32_t ideal_height = text_height + ws_vertical_padding * 2;
 	uint32_t ideal_surface_height = ideal_height;
@@ -77,7 +263,7 @@ static uint32_t render_status_line_error(struct render_context *ctx, double *x)
 	double text_y = height / 2.0 - text_height / 2.0;
 	cairo_move_to(cairo, *x, (int)floor(text_y));
 	choose_text_aa_mode(ctx, 0xFF0000FF);
-	render_text(cairo, font, 1, false, "%s", error);
+	text_cache_render(output->bar->text_cache, cairo, font, 1, false, error);
 	*x -= margin;
 	return output->height;
 }
@@ -96,8 +282,9 @@ static uint32_t render_status_line_text(struct render_context *ctx, double *x) {
 	cairo_set_source_u32(cairo, fontcolor);
 
 	int text_width, text_height;
-	get_text_size(cairo, config->font_description, &text_width, &text_height, NULL,
-			1, config->pango_markup, "%s", text);
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, &text_width, &text_height, NULL, 1,
+			config->pango_markup, text);
 
 	double ws_vertical_padding = config->status_padding;
 	int margin = 3;
@@ -114,7 +301,8 @@ static uint32_t render_status_line_text(struct render_context *ctx, double *x) {
 	double text_y = height / 2.0 - text_height / 2.0;
 	cairo_move_to(cairo, *x, (int)floor(text_y));
 	choose_text_aa_mode(ctx, fontcolor);
-	render_text(cairo, config->font_description, 1, config->pango_markup, "%s", text);
+	text_cache_render(output->bar->text_cache, cairo, config->font_description,
+			1, config->pango_markup, text);
 	*x -= margin;
 	return output->height;
 }
@@ -185,12 +373,34 @@ static uint32_t render_status_block(struct render_context *ctx,
 		text = block->short_text;
 	}
 
+	double x_start = *x;
+	uint32_t hash = hash_element(ctx);
+	hash = hash_str(hash, text);
+	hash = hash_str(hash, block->align);
+	hash = hash_str(hash, block->min_width_str);
+	hash = HASH_VALUE(hash, block->min_width);
+	hash = HASH_VALUE(hash, block->urgent);
+	hash = HASH_VALUE(hash, block->color);
+	hash = HASH_VALUE(hash, block->color_set);
+	hash = HASH_VALUE(hash, block->separator);
+	hash = HASH_VALUE(hash, block->separator_block_width);
+	hash = HASH_VALUE(hash, block->markup);
+	hash = HASH_VALUE(hash, block->background);
+	hash = HASH_VALUE(hash, block->border);
+	hash = HASH_VALUE(hash, block->border_set);
+	hash = HASH_VALUE(hash, block->border_top);
+	hash = HASH_VALUE(hash, block->border_bottom);
+	hash = HASH_VALUE(hash, block->border_left);
+	hash = HASH_VALUE(hash, block->border_right);
+	hash = HASH_VALUE(hash, edge);
+
 	cairo_t *cairo = ctx->cairo;
 	struct swaybar_output *output = ctx->output;
 	struct swaybar_config *config = output->bar->config;
 	int text_width, text_height;
-	get_text_size(cairo, config->font_description, &text_width, &text_height, NULL, 1,
-			block->markup, "%s", text);
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, &text_width, &text_height, NULL, 1,
+			block->markup, text);
 
 	int margin = 3;
 	double ws_vertical_padding = config->status_padding;
@@ -198,8 +408,9 @@ static uint32_t render_status_block(struct render_context *ctx,
 	int width = text_width;
 	if (block->min_width_str) {
 		int w;
-		get_text_size(cairo, config->font_description, &w, NULL, NULL, 1, block->markup,
-				"%s", block->min_width_str);
+		text_cache_get_size(output->bar->text_cache, cairo,
+				config->font_description, &w, NULL, NULL, 1, block->markup,
+				block->min_width_str);
 		block->min_width = w;
 	}
 	if (width < block->min_width) {
@@ -228,8 +439,9 @@ static uint32_t render_status_block(struct render_context *ctx,
 	int sep_block_width = block->separator_block_width;
 	if (!edge) {
 		if (config->sep_symbol) {
-			get_text_size(cairo, config->font_description, &sep_width, &sep_height, NULL,
-					1, false, "%s", config->sep_symbol);
+			text_cache_get_size(output->bar->text_cache, cairo,
+					config->font_description, &sep_width, &sep_height, NULL, 1,
+					false, config->sep_symbol);
 			uint32_t _ideal_height = sep_height + ws_vertical_padding * 2;
 			uint32_t _ideal_surface_height = _ideal_height;
 			if (!output->bar->config->height &&
@@ -306,7 +518,8 @@ static uint32_t render_status_block(struct render_context *ctx,
 	color = block->urgent ? config->colors.urgent_workspace.text : color;
 	cairo_set_source_u32(cairo, color);
 	choose_text_aa_mode(ctx, color);
-	render_text(cairo, config->font_description, 1, block->markup, "%s", text);
+	text_cache_render(output->bar->text_cache, cairo, config->font_description,
+			1, block->markup, text);
 	x_pos += width;
 
 	if (block->border_set || block->urgent) {
@@ -330,8 +543,8 @@ static uint32_t render_status_block(struct render_context *ctx,
 			double sep_y = height / 2.0 - sep_height / 2.0;
 			cairo_move_to(cairo, offset, (int)floor(sep_y));
 			choose_text_aa_mode(ctx, color);
-			render_text(cairo, config->font_description, 1, false,
-					"%s", config->sep_symbol);
+			text_cache_render(output->bar->text_cache, cairo,
+					config->font_description, 1, false, config->sep_symbol);
 		} else {
 			cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
 			cairo_set_line_width(cairo, 1);
@@ -340,6 +553,8 @@ static uint32_t render_status_block(struct render_context *ctx,
 			cairo_stroke(cairo);
 		}
 	}
+
+	add_region(ctx, *x, x_start - *x, hash, false);
 	return output->height;
 }
 
@@ -353,8 +568,9 @@ static void predict_status_block_pos(cairo_t *cairo,
 	struct swaybar_config *config = output->bar->config;
 
 	int text_width, text_height;
-	get_text_size(cairo, config->font_description, &text_width, &text_height, NULL, 1,
-			block->markup, "%s", block->full_text);
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, &text_width, &text_height, NULL, 1,
+			block->markup, block->full_text);
 
 	int margin = 3;
 	double ws_vertical_padding = config->status_padding;
@@ -363,8 +579,9 @@ static void predict_status_block_pos(cairo_t *cairo,
 
 	if (block->min_width_str) {
 		int w;
-		get_text_size(cairo, config->font_description, &w, NULL, NULL,
-				1, block->markup, "%s", block->min_width_str);
+		text_cache_get_size(output->bar->text_cache, cairo,
+				config->font_description, &w, NULL, NULL, 1, block->markup,
+				block->min_width_str);
 		block->min_width = w;
 	}
 	if (width < block->min_width) {
@@ -390,8 +607,9 @@ static void predict_status_block_pos(cairo_t *cairo,
 	int sep_block_width = block->separator_block_width;
 	if (!edge) {
 		if (config->sep_symbol) {
-			get_text_size(cairo, config->font_description, &sep_width, &sep_height, NULL,
-					1, false, "%s", config->sep_symbol);
+			text_cache_get_size(output->bar->text_cache, cairo,
+					config->font_description, &sep_width, &sep_height, NULL, 1,
+					false, config->sep_symbol);
 			uint32_t _ideal_height = sep_height + ws_vertical_padding * 2;
 			uint32_t _ideal_surface_height = _ideal_height;
 			if (!output->bar->config->height &&
@@ -425,8 +643,9 @@ static uint32_t predict_workspace_button_length(cairo_t *cairo,
 	struct swaybar_config *config = output->bar->config;
 
 	int text_width, text_height;
-	get_text_size(cairo, config->font_description, &text_width, &text_height, NULL, 1,
-			config->pango_markup, "%s", ws->label);
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, &text_width, &text_height, NULL, 1,
+			config->pango_markup, ws->label);
 
 	int ws_vertical_padding = WS_VERTICAL_PADDING;
 	int ws_horizontal_padding = WS_HORIZONTAL_PADDING;
@@ -473,9 +692,9 @@ static uint32_t predict_binding_mode_indicator_length(cairo_t *cairo,
 	}
 
 	int text_width, text_height;
-	get_text_size(cairo, config->font_description, &text_width, &text_height, NULL,
-			1, output->bar->mode_pango_markup,
-			"%s", mode);
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, &text_width, &text_height, NULL, 1,
+			output->bar->mode_pango_markup, mode);
 
 	int ws_vertical_padding = WS_VERTICAL_PADDING;
 	int ws_horizontal_padding = WS_HORIZONTAL_PADDING;
@@ -526,11 +745,20 @@ static uint32_t render_status_line_i3bar(struct render_context *ctx, double *x)
 
 static uint32_t render_status_line(struct render_context *ctx, double *x) {
 	struct status_line *status = ctx->output->bar->status;
+	double x_start = *x;
+	uint32_t hash = hash_element(ctx);
+	hash = HASH_VALUE(hash, status->protocol);
+	hash = hash_str(hash, status->text);
+	uint32_t h;
 	switch (status->protocol) {
 	case PROTOCOL_ERROR:
-		return render_status_line_error(ctx, x);
+		h = render_status_line_error(ctx, x);
+		add_region(ctx, *x, x_start - *x, hash, false);
+		return h;
 	case PROTOCOL_TEXT:
-		return render_status_line_text(ctx, x);
+		h = render_status_line_text(ctx, x);
+		add_region(ctx, *x, x_start - *x, hash, false);
+		return h;
 	case PROTOCOL_I3BAR:
 		return render_status_line_i3bar(ctx, x);
 	case PROTOCOL_UNDEF:
@@ -550,9 +778,9 @@ static uint32_t render_binding_mode_indicator(struct render_context *ctx,
 	cairo_t *cairo = ctx->cairo;
 	struct swaybar_config *config = output->bar->config;
 	int text_width, text_height;
-	get_text_size(cairo, config->font_description, &text_width, &text_height, NULL,
-			1, output->bar->mode_pango_markup,
-			"%s", mode);
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, &text_width, &text_height, NULL, 1,
+			output->bar->mode_pango_markup, mode);
 
 	int ws_vertical_padding = WS_VERTICAL_PADDING;
 	int ws_horizontal_padding = WS_HORIZONTAL_PADDING;
@@ -570,6 +798,11 @@ static uint32_t render_binding_mode_indicator(struct render_context *ctx,
 		width = config->workspace_min_width;
 	}
 
+	uint32_t hash = hash_element(ctx);
+	hash = hash_str(hash, mode);
+	hash = HASH_VALUE(hash, output->bar->mode_pango_markup);
+	add_region(ctx, x, width, hash, false);
+
 	uint32_t height = output->height;
 	cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
 	cairo_set_source_u32(cairo, config->colors.binding_mode.background);
@@ -591,8 +824,8 @@ static uint32_t render_binding_mode_indicator(struct render_context *ctx,
 	cairo_set_source_u32(cairo, config->colors.binding_mode.text);
 	cairo_move_to(cairo, x + width / 2 - text_width / 2, (int)floor(text_y));
 	choose_text_aa_mode(ctx, config->colors.binding_mode.text);
-	render_text(cairo, config->font_description, 1, output->bar->mode_pango_markup,
-			"%s", mode);
+	text_cache_render(output->bar->text_cache, cairo, config->font_description,
+			1, output->bar->mode_pango_markup, mode);
 	return output->height;
 }
 
@@ -630,8 +863,9 @@ static uint32_t render_workspace_button(struct render_context *ctx,
 
 	cairo_t *cairo = ctx->cairo;
 	int text_width, text_height;
-	get_text_size(cairo, config->font_description, &text_width, &text_height, NULL,
-			1, config->pango_markup, "%s", ws->label);
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, &text_width, &text_height, NULL, 1,
+			config->pango_markup, ws->label);
 
 	int ws_vertical_padding = WS_VERTICAL_PADDING;
 	int ws_horizontal_padding = WS_HORIZONTAL_PADDING;
@@ -650,6 +884,11 @@ static uint32_t render_workspace_button(struct render_context *ctx,
 		width = config->workspace_min_width;
 	}
 
+	uint32_t hash = hash_element(ctx);
+	hash = hash_str(hash, ws->label);
+	hash = HASH_VALUE(hash, box_colors);
+	add_region(ctx, *x, width, hash, false);
+
 	cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
 	cairo_set_source_u32(cairo, box_colors.background);
 	ctx->background_color = box_colors.background;
@@ -670,8 +909,8 @@ static uint32_t render_workspace_button(struct render_context *ctx,
 	cairo_set_source_u32(cairo, box_colors.text);
 	cairo_move_to(cairo, *x + width / 2 - text_width / 2, (int)floor(text_y));
 	choose_text_aa_mode(ctx, box_colors.text);
-	render_text(cairo, config->font_description, 1, config->pango_markup,
-			"%s", ws->label);
+	text_cache_render(output->bar->text_cache, cairo, config->font_description,
+			1, config->pango_markup, ws->label);
 
 	struct swaybar_hotspot *hotspot = calloc(1, sizeof(struct swaybar_hotspot));
 	hotspot->x = *x;
@@ -694,7 +933,8 @@ static uint32_t render_to_cairo(struct render_context *ctx) {
 	struct swaybar_config *config = bar->config;
 
 	int th;
-	get_text_size(cairo, config->font_description, NULL, &th, NULL, 1, false, "");
+	text_cache_get_size(output->bar->text_cache, cairo,
+			config->font_description, NULL, &th, NULL, 1, false, "");
 	uint32_t max_height = (th + WS_VERTICAL_PADDING * 4);
 	/*
 	 * Each render_* function takes the actual height of the bar, and returns
@@ -706,8 +946,11 @@ static uint32_t render_to_cairo(struct render_context *ctx) {
 	double x = output->width;
 #if HAVE_TRAY
 	if (bar->tray) {
+		// Icons are not tracked, always repaint the tray
+		double tray_x = x;
 		uint32_t h = render_tray(cairo, output, &x);
 		max_height = h > max_height ? h : max_height;
+		add_region(ctx, x, tray_x - x, 0, true);
 	}
 #endif
 	if (bar->status) {
@@ -736,8 +979,9 @@ static void output_frame_handle_done(void *data, struct wl_callback *callback,
 	struct swaybar_output *output = data;
 	output->frame_scheduled = false;
 	if (output->dirty) {
-		render_frame(output);
+		// render_frame sets dirty again if it has to retry
 		output->dirty = false;
+		render_frame(output);
 	}
 }
 
@@ -765,6 +1009,15 @@ void render_frame(struct swaybar_output *output) {
 	// initial background color used for deciding the best way to antialias text
 	ctx.background_color = background_color;
 
+	struct swaybar_render_frame frame = { .valid = true };
+	frame.hash = HASH_VALUE(HASH_INIT, background_color);
+	frame.hash = HASH_VALUE(frame.hash, output->focused);
+	frame.hash = HASH_VALUE(frame.hash, output->width);
+	frame.hash = HASH_VALUE(frame.hash, output->height);
+	frame.hash = HASH_VALUE(frame.hash, output->scale);
+	frame.hash = HASH_VALUE(frame.hash, output->subpixel);
+	ctx.frame = &frame;
+
 	cairo_surface_t *recorder = cairo_recording_surface_create(
 			CAIRO_CONTENT_COLOR_ALPHA, NULL);
 	cairo_t *cairo = cairo_create(recorder);
@@ -811,28 +1064,73 @@ void render_frame(struct swaybar_output *output) {
 		wl_surface_commit(output->surface);
 	} else if (height > 0) {
 		// Replay recording into shm and send it off
+		int buffer_width = output->width * output->scale;
+		int buffer_height = output->height * output->scale;
 		output->current_buffer = get_next_buffer(output->bar->shm,
-				output->buffers,
-				output->width * output->scale,
-				output->height * output->scale);
+				&output->buffer_pool, buffer_width, buffer_height);
 		if (!output->current_buffer) {
+			// Try again once the compositor releases a buffer
+			output->dirty = true;
+			goto cleanup;
+		}
+		struct swaybar_render_frame *buffer_frame =
+			get_buffer_frame(output->current_buffer);
+		if (!buffer_frame) {
+			output->current_buffer->busy = false;
 			goto cleanup;
 		}
-		cairo_t *shm = output->current_buffer->cairo;
 
-		cairo_save(shm);
-		cairo_set_operator(shm, CAIRO_OPERATOR_CLEAR);
-		cairo_paint(shm);
-		cairo_restore(shm);
+		struct render_interval *damage = calloc(1 + frame.regions_len +
+				(buffer_frame->regions_len > output->surface_frame.regions_len ?
+				buffer_frame->regions_len : output->surface_frame.regions_len),
+				sizeof(*damage));
+		if (!damage) {
+			output->current_buffer->busy = false;
+			goto cleanup;
+		}
+
+		size_t damage_len = frame_damage(&frame, &output->surface_frame,
+				output->scale, buffer_width, damage);
+		if (damage_len == 0) {
+			// Nothing changed since the last commit
+			output->current_buffer->busy = false;
+			free(damage);
+			goto cleanup;
+		}
+		for (size_t i = 0; i < damage_len; ++i) {
+			wl_surface_damage_buffer(output->surface, damage[i].start, 0,
+					damage[i].end - damage[i].start, buffer_height);
+		}
+
+		// Repaint what changed since the buffer was last drawn to, which may
+		// be more than the surface damage since buffers are rotated
+		damage_len = frame_damage(&frame, buffer_frame,
+				output->scale, buffer_width, damage);
+		if (damage_len > 0) {
+			cairo_t *shm = output->current_buffer->cairo;
+			cairo_save(shm);
+			for (size_t i = 0; i < damage_len; ++i) {
+				cairo_rectangle(shm, damage[i].start, 0,
+						damage[i].end - damage[i].start, buffer_height);
+			}
+			cairo_clip(shm);
+
+			cairo_set_operator(shm, CAIRO_OPERATOR_CLEAR);
+			cairo_paint(shm);
+
+			cairo_set_operator(shm, CAIRO_OPERATOR_OVER);
+			cairo_set_source_surface(shm, recorder, 0.0, 0.0);
+			cairo_paint(shm);
+			cairo_restore(shm);
+		}
+		free(damage);
 
-		cairo_set_source_surface(shm, recorder, 0.0, 0.0);
-		cairo_paint(shm);
+		frame_copy(buffer_frame, &frame);
+		frame_copy(&output->surface_frame, &frame);
 
 		wl_surface_set_buffer_scale(output->surface, output->scale);
 		wl_surface_attach(output->surface,
 				output->current_buffer->buffer, 0, 0);
-		wl_surface_damage(output->surface, 0, 0,
-				output->width, output->height);
 
 		uint32_t bg_alpha = background_color & 0xFF;
 		if (bg_alpha == 0xFF) {
@@ -859,4 +1157,5 @@ cleanup:
 	cairo_font_options_destroy(ctx.textaa_safe);
 	cairo_surface_destroy(recorder);
 	cairo_destroy(cairo);
+	frame_finish(&frame);
 }
@@ -0,0 +1,185 @@
+#include <cairo.h>
+#include <inttypes.h>
+#include <pango/pangocairo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hashmap.h"
+#include "log.h"
+#include "pango.h"
+#include "swaybar/text.h"
+
+#define TEXT_CACHE_SIZE 256
+
+struct text_cache_entry {
+	struct wl_list link; // text_cache::entries
+	char *key;
+	PangoFontDescription *desc;
+	cairo_font_options_t *options; // NULL if the layout is only measured
+	PangoLayout *layout;
+};
+
+struct text_cache *text_cache_create(void) {
+	struct text_cache *cache = calloc(1, sizeof(struct text_cache));
+	if (!cache) {
+		return NULL;
+	}
+	cache->entries_by_key = create_hashmap();
+	if (!cache->entries_by_key) {
+		free(cache);
+		return NULL;
+	}
+	wl_list_init(&cache->entries);
+	return cache;
+}
+
+static void entry_destroy(struct text_cache_entry *entry) {
+	wl_list_remove(&entry->link);
+	g_object_unref(entry->layout);
+	pango_font_description_free(entry->desc);
+	if (entry->options) {
+		cairo_font_options_destroy(entry->options);
+	}
+	free(entry->key);
+	free(entry);
+}
+
+void text_cache_destroy(struct text_cache *cache) {
+	if (!cache) {
+		return;
+	}
+	uint64_t lookups = cache->hits + cache->misses;
+	sway_log(SWAY_DEBUG, "Text cache: %" PRIu64 " hits, %" PRIu64 " misses "
+			"(%.1f%% hit rate), %" PRIu64 " evictions", cache->hits,
+			cache->misses, lookups ? 100.0 * cache->hits / lookups : 0.0,
+			cache->evictions);
+
+	struct text_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &cache->entries, link) {
+		entry_destroy(entry);
+	}
+	hashmap_free(cache->entries_by_key);
+	free(cache->key);
+	free(cache);
+}
+
+static const char *build_key(struct text_cache *cache,
+		const PangoFontDescription *desc, double scale, bool markup,
+		const cairo_font_options_t *options, const char *text) {
+	// Measured and drawn layouts, with and without markup, are kept apart
+	char kind = (options ? 'd' : 'm') - (markup ? 'a' - 'A' : 0);
+	unsigned long options_hash =
+		options ? cairo_font_options_hash(options) : 0;
+	guint desc_hash = pango_font_description_hash(desc);
+	const char *fmt = "%c%lx:%x:%a:%s";
+	int len = snprintf(NULL, 0, fmt, kind, options_hash, desc_hash,
+			scale, text);
+	if (len < 0) {
+		return NULL;
+	}
+	if ((size_t)len >= cache->key_size) {
+		char *key = realloc(cache->key, len + 1);
+		if (!key) {
+			return NULL;
+		}
+		cache->key = key;
+		cache->key_size = len + 1;
+	}
+	snprintf(cache->key, cache->key_size, fmt, kind, options_hash, desc_hash,
+			scale, text);
+	return cache->key;
+}
+
+static bool options_equal(const cairo_font_options_t *a,
+		const cairo_font_options_t *b) {
+	if (!a || !b) {
+		return a == b;
+	}
+	return cairo_font_options_equal(a, b);
+}
+
+static void evict_oldest(struct text_cache *cache) {
+	struct text_cache_entry *oldest =
+		wl_container_of(cache->entries.prev, oldest, link);
+	hashmap_remove(cache->entries_by_key, oldest->key);
+	entry_destroy(oldest);
+	cache->length--;
+	cache->evictions++;
+}
+
+/**
+ * Returns a reference to a layout of the text, updated for the cairo context.
+ */
+static PangoLayout *text_cache_get(struct text_cache *cache, cairo_t *cairo,
+		const PangoFontDescription *desc, double scale, bool markup,
+		const cairo_font_options_t *options, const char *text) {
+	const char *key = build_key(cache, desc, scale, markup, options, text);
+	struct text_cache_entry *entry =
+		key ? hashmap_get(cache->entries_by_key, key) : NULL;
+	if (entry && (!pango_font_description_equal(entry->desc, desc) ||
+			!options_equal(entry->options, options))) {
+		// Hash collision, replace the entry
+		hashmap_remove(cache->entries_by_key, key);
+		entry_destroy(entry);
+		cache->length--;
+		entry = NULL;
+	}
+
+	if (entry) {
+		cache->hits++;
+		wl_list_remove(&entry->link);
+		wl_list_insert(&cache->entries, &entry->link);
+		pango_cairo_update_layout(cairo, entry->layout);
+		return g_object_ref(entry->layout);
+	}
+
+	cache->misses++;
+	PangoLayout *layout = get_pango_layout(cairo, desc, text, scale, markup);
+	if (options) {
+		pango_cairo_context_set_font_options(pango_layout_get_context(layout),
+				options);
+	}
+	pango_cairo_update_layout(cairo, layout);
+	if (!key) {
+		return layout;
+	}
+
+	entry = calloc(1, sizeof(struct text_cache_entry));
+	if (!entry || !(entry->key = strdup(key))) {
+		free(entry);
+		return layout;
+	}
+	entry->desc = pango_font_description_copy(desc);
+	entry->options = options ? cairo_font_options_copy(options) : NULL;
+	entry->layout = g_object_ref(layout);
+	wl_list_insert(&cache->entries, &entry->link);
+	hashmap_set(cache->entries_by_key, entry->key, entry);
+	if (++cache->length > TEXT_CACHE_SIZE) {
+		evict_oldest(cache);
+	}
+	return layout;
+}
+
+void text_cache_get_size(struct text_cache *cache, cairo_t *cairo,
+		const PangoFontDescription *desc, int *width, int *height,
+		int *baseline, double scale, bool markup, const char *text) {
+	PangoLayout *layout =
+		text_cache_get(cache, cairo, desc, scale, markup, NULL, text);
+	pango_layout_get_pixel_size(layout, width, height);
+	if (baseline) {
+		*baseline = pango_layout_get_baseline(layout) / PANGO_SCALE;
+	}
+	g_object_unref(layout);
+}
+
+void text_cache_render(struct text_cache *cache, cairo_t *cairo,
+		const PangoFontDescription *desc, double scale, bool markup,
+		const char *text) {
+	cairo_font_options_t *fo = cairo_font_options_create();
+	cairo_get_font_options(cairo, fo);
+	PangoLayout *layout =
+		text_cache_get(cache, cairo, desc, scale, markup, fo, text);
+	cairo_font_options_destroy(fo);
+	pango_cairo_show_layout(cairo, layout);
+	g_object_unref(layout);
+}
@@ -1,5 +1,7 @@
 #include <ctype.h>
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +11,10 @@
 #include <wordexp.h>
 #include "swaybar/tray/icon.h"
 #include "config.h"
+#if HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+#include "hashmap.h"
 #include "list.h"
 #include "log.h"
 #include "stringop.h"
@@ -395,8 +401,200 @@ void finish_themes(list_t *themes, list_t *basedirs) {
 	list_free_items_and_destroy(basedirs);
 }
 
-static char *find_icon_in_subdir(char *name, char *basedir, char *theme,
-		char *subdir) {
+struct icon_dir {
+	char *path;
+	hashmap_t *files; // file name -> struct icon_dir *, NULL if unreadable
+	int wd; // inotify watch descriptor, -1 if not watched
+};
+
+struct icon_index *create_icon_index(void) {
+	struct icon_index *index = calloc(1, sizeof(struct icon_index));
+	if (!index) {
+		return NULL;
+	}
+	index->dirs = create_hashmap();
+	index->watched = create_list();
+	if (!index->dirs || !index->watched) {
+		hashmap_free(index->dirs);
+		list_free(index->watched);
+		free(index);
+		return NULL;
+	}
+	index->fd = -1;
+#if HAVE_INOTIFY
+	index->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (index->fd == -1) {
+		sway_log_errno(SWAY_INFO, "Unable to watch icon directories");
+	}
+#endif
+	return index;
+}
+
+static void destroy_icon_dir(const char *path, void *value, void *data) {
+	struct icon_dir *dir = value;
+	hashmap_free(dir->files);
+	free(dir->path);
+	free(dir);
+}
+
+void destroy_icon_index(struct icon_index *index) {
+	if (!index) {
+		return;
+	}
+	hashmap_for_each(index->dirs, destroy_icon_dir, NULL);
+	hashmap_free(index->dirs);
+	list_free(index->watched);
+	if (index->fd != -1) {
+		close(index->fd);
+	}
+	free(index);
+}
+
+static struct icon_dir *index_dir(struct icon_index *index, const char *path);
+
+/**
+ * Reads the file names of the directory. Returns false if they could not be
+ * stored, in which case the directory must not be used from the index.
+ */
+static bool index_dir_files(struct icon_index *index, struct icon_dir *dir) {
+	DIR *d = opendir(dir->path);
+	if (!d) {
+		// Watch the parent instead, so that the directory is indexed again
+		// if it is created
+		char *parent = strdup(dir->path);
+		char *slash = parent ? strrchr(parent, '/') : NULL;
+		if (slash && slash != parent) {
+			*slash = '\0';
+			index_dir(index, parent);
+		}
+		free(parent);
+		return true;
+	}
+
+	dir->files = create_hashmap();
+	if (!dir->files) {
+		closedir(d);
+		return false;
+	}
+	struct dirent *entry;
+	while ((entry = readdir(d))) {
+		if (entry->d_name[0] != '.') {
+			hashmap_set(dir->files, entry->d_name, dir);
+		}
+	}
+	closedir(d);
+
+#if HAVE_INOTIFY
+	if (index->fd != -1) {
+		dir->wd = inotify_add_watch(index->fd, dir->path,
+				IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+				IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+		if (dir->wd != -1) {
+			list_add(index->watched, dir);
+		}
+	}
+#endif
+	return true;
+}
+
+/**
+ * Returns the index of the files in the directory at path, reading it the
+ * first time it is looked up.
+ */
+static struct icon_dir *index_dir(struct icon_index *index, const char *path) {
+	struct icon_dir *dir = hashmap_get(index->dirs, path);
+	if (dir) {
+		return dir;
+	}
+	dir = calloc(1, sizeof(struct icon_dir));
+	if (!dir) {
+		return NULL;
+	}
+	dir->path = strdup(path);
+	dir->wd = -1;
+	if (!dir->path || !index_dir_files(index, dir)) {
+		sway_log(SWAY_ERROR, "Unable to index icon directory %s", path);
+		destroy_icon_dir(path, dir, NULL);
+		return NULL;
+	}
+	hashmap_set(index->dirs, path, dir);
+	return dir;
+}
+
+struct icon_dir_prefix {
+	const char *prefix;
+	size_t len;
+	list_t *matches;
+};
+
+static void find_subdirs_iterator(const char *path, void *value, void *data) {
+	struct icon_dir_prefix *prefix = data;
+	if (strncmp(path, prefix->prefix, prefix->len) == 0 &&
+			path[prefix->len] == '/') {
+		list_add(prefix->matches, value);
+	}
+}
+
+static void forget_dir(struct icon_index *index, struct icon_dir *dir) {
+	hashmap_remove(index->dirs, dir->path);
+	if (dir->wd != -1) {
+#if HAVE_INOTIFY
+		inotify_rm_watch(index->fd, dir->wd);
+#endif
+		int i = list_find(index->watched, dir);
+		if (i != -1) {
+			list_del(index->watched, i);
+		}
+	}
+	destroy_icon_dir(dir->path, dir, NULL);
+}
+
+/**
+ * Drops the directory and everything below it from the index. Its files are
+ * read again the next time an icon is looked up in it.
+ */
+static void invalidate_dir(struct icon_index *index, struct icon_dir *dir) {
+	sway_log(SWAY_DEBUG, "Icon directory %s changed", dir->path);
+	struct icon_dir_prefix prefix = {
+		.prefix = dir->path,
+		.len = strlen(dir->path),
+		.matches = create_list(),
+	};
+	hashmap_for_each(index->dirs, find_subdirs_iterator, &prefix);
+	for (int i = 0; i < prefix.matches->length; ++i) {
+		forget_dir(index, prefix.matches->items[i]);
+	}
+	list_free(prefix.matches);
+	forget_dir(index, dir);
+}
+
+void icon_index_handle_events(struct icon_index *index) {
+#if HAVE_INOTIFY
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(index->fd, buf, sizeof(buf))) > 0) {
+		const struct inotify_event *event;
+		for (char *ptr = buf; ptr < buf + len;
+				ptr += sizeof(struct inotify_event) + event->len) {
+			event = (const struct inotify_event *)ptr;
+			for (int i = 0; i < index->watched->length; ++i) {
+				struct icon_dir *dir = index->watched->items[i];
+				if (dir->wd == event->wd) {
+					invalidate_dir(index, dir);
+					break;
+				}
+			}
+		}
+	}
+	if (len == -1 && errno != EAGAIN) {
+		sway_log_errno(SWAY_ERROR, "Failed to read icon directory events");
+	}
+#endif
+}
+
+static char *find_icon_in_subdir(struct icon_index *index, char *name,
+		char *basedir, char *theme, char *subdir) {
 	static const char *extensions[] = {
 #if HAVE_GDK_PIXBUF
 		"svg",
@@ -407,27 +605,61 @@ static char *find_icon_in_subdir(char *name, char *basedir, char *theme,
 #endif
 	};
 
+	char *path = *theme ? format_str("%s/%s/%s", basedir, theme, subdir) :
+		strdup(basedir);
+	if (!path) {
+		return NULL;
+	}
+	struct icon_dir *dir = index ? index_dir(index, path) : NULL;
+	if (dir && !dir->files) {
+		free(path);
+		return NULL;
+	}
+
+	// Without an index entry, probe the candidate files directly
+	char *icon = NULL;
 	for (size_t i = 0; i < sizeof(extensions) / sizeof(*extensions); ++i) {
-		char *path = format_str("%s/%s/%s/%s.%s",
-			basedir, theme, subdir, name, extensions[i]);
-		if (access(path, R_OK) == 0) {
-			return path;
+		char *file = format_str("%s.%s", name, extensions[i]);
+		if (!file) {
+			continue;
 		}
-		free(path);
+		if (!dir) {
+			icon = format_str("%s/%s", path, file);
+			free(file);
+			if (icon && access(icon, R_OK) == 0) {
+				break;
+			}
+			free(icon);
+			icon = NULL;
+			continue;
+		}
+		if (hashmap_get(dir->files, file)) {
+			icon = format_str("%s/%s", path, file);
+			free(file);
+			break;
+		}
+		free(file);
 	}
 
-	return NULL;
+	free(path);
+	return icon;
 }
 
-static bool theme_exists_in_basedir(char *theme, char *basedir) {
+static bool theme_exists_in_basedir(struct icon_index *index, char *theme,
+		char *basedir) {
 	char *path = format_str("%s/%s", basedir, theme);
-	bool ret = dir_exists(path);
+	if (!path) {
+		return false;
+	}
+	struct icon_dir *dir = index ? index_dir(index, path) : NULL;
+	bool ret = dir ? dir->files != NULL : dir_exists(path);
 	free(path);
 	return ret;
 }
 
-static char *find_icon_with_theme(list_t *basedirs, list_t *themes, char *name,
-		int size, char *theme_name, int *min_size, int *max_size) {
+static char *find_icon_with_theme(struct icon_index *index, list_t *basedirs,
+		list_t *themes, char *name, int size, char *theme_name,
+		int *min_size, int *max_size) {
 	struct icon_theme *theme = NULL;
 	for (int i = 0; i < themes->length; ++i) {
 		theme = themes->items[i];
@@ -440,14 +672,14 @@ static char *find_icon_with_theme(list_t *basedirs, list_t *themes, char *name,
 
 	char *icon = NULL;
 	for (int i = 0; i < basedirs->length; ++i) {
-		if (!theme_exists_in_basedir(theme->dir, basedirs->items[i])) {
+		if (!theme_exists_in_basedir(index, theme->dir, basedirs->items[i])) {
 			continue;
 		}
 		// search backwards to hopefully hit scalable/larger icons first
 		for (int j = theme->subdirs->length - 1; j >= 0; --j) {
 			struct icon_theme_subdir *subdir = theme->subdirs->items[j];
 			if (size >= subdir->min_size && size <= subdir->max_size) {
-				if ((icon = find_icon_in_subdir(name, basedirs->items[i],
+				if ((icon = find_icon_in_subdir(index, name, basedirs->items[i],
 								theme->dir, subdir->name))) {
 					*min_size = subdir->min_size;
 					*max_size = subdir->max_size;
@@ -460,7 +692,7 @@ static char *find_icon_with_theme(list_t *basedirs, list_t *themes, char *name,
 	// inexact match
 	unsigned smallest_error = -1; // UINT_MAX
 	for (int i = 0; i < basedirs->length; ++i) {
-		if (!theme_exists_in_basedir(theme->dir, basedirs->items[i])) {
+		if (!theme_exists_in_basedir(index, theme->dir, basedirs->items[i])) {
 			continue;
 		}
 		for (int j = theme->subdirs->length - 1; j >= 0; --j) {
@@ -468,9 +700,10 @@ static char *find_icon_with_theme(list_t *basedirs, list_t *themes, char *name,
 			unsigned error = (size > subdir->max_size ? size - subdir->max_size : 0)
 				+ (size < subdir->min_size ? subdir->min_size - size : 0);
 			if (error < smallest_error) {
-				char *test_icon = find_icon_in_subdir(name, basedirs->items[i],
+				char *test_icon = find_icon_in_subdir(index, name, basedirs->items[i],
 						theme->dir, subdir->name);
 				if (test_icon) {
+					free(icon);
 					icon = test_icon;
 					smallest_error = error;
 					*min_size = subdir->min_size;
@@ -482,7 +715,7 @@ static char *find_icon_with_theme(list_t *basedirs, list_t *themes, char *name,
 
 	if (!icon && theme->inherits) {
 		for (int i = 0; i < theme->inherits->length; ++i) {
-			icon = find_icon_with_theme(basedirs, themes, name, size,
+			icon = find_icon_with_theme(index, basedirs, themes, name, size,
 					theme->inherits->items[i], min_size, max_size);
 			if (icon) {
 				break;
@@ -493,10 +726,10 @@ static char *find_icon_with_theme(list_t *basedirs, list_t *themes, char *name,
 	return icon;
 }
 
-static char *find_fallback_icon(list_t *basedirs, char *name, int *min_size,
-		int *max_size) {
+static char *find_fallback_icon(struct icon_index *index, list_t *basedirs,
+		char *name, int *min_size, int *max_size) {
 	for (int i = 0; i < basedirs->length; ++i) {
-		char *icon = find_icon_in_subdir(name, basedirs->items[i], "", "");
+		char *icon = find_icon_in_subdir(index, name, basedirs->items[i], "", "");
 		if (icon) {
 			*min_size = 1;
 			*max_size = 512;
@@ -506,20 +739,20 @@ static char *find_fallback_icon(list_t *basedirs, char *name, int *min_size,
 	return NULL;
 }
 
-char *find_icon(list_t *themes, list_t *basedirs, char *name, int size,
-		char *theme, int *min_size, int *max_size) {
+char *find_icon(struct icon_index *index, list_t *themes, list_t *basedirs,
+		char *name, int size, char *theme, int *min_size, int *max_size) {
 	// TODO https://specifications.freedesktop.org/icon-theme-spec/icon-theme-spec-latest.html#implementation_notes
 	char *icon = NULL;
 	if (theme) {
-		icon = find_icon_with_theme(basedirs, themes, name, size, theme,
+		icon = find_icon_with_theme(index, basedirs, themes, name, size, theme,
 				min_size, max_size);
 	}
 	if (!icon && !(theme && strcmp(theme, "Hicolor") == 0)) {
-		icon = find_icon_with_theme(basedirs, themes, name, size, "Hicolor",
-				min_size, max_size);
+		icon = find_icon_with_theme(index, basedirs, themes, name, size,
+				"Hicolor", min_size, max_size);
 	}
 	if (!icon) {
-		icon = find_fallback_icon(basedirs, name, min_size, max_size);
+		icon = find_fallback_icon(index, basedirs, name, min_size, max_size);
 	}
 	return icon;
 }
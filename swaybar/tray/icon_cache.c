@@ -0,0 +1,162 @@
+#include <cairo.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "cairo_util.h"
+#include "hashmap.h"
+#include "log.h"
+#include "stringop.h"
+#include "swaybar/image.h"
+#include "swaybar/tray/icon_cache.h"
+
+#define ICON_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+struct icon_cache_entry {
+	struct wl_list link; // icon_cache::entries
+	char *key;
+	cairo_surface_t *surface;
+	size_t bytes;
+};
+
+struct icon_cache *icon_cache_create(void) {
+	struct icon_cache *cache = calloc(1, sizeof(struct icon_cache));
+	if (!cache) {
+		return NULL;
+	}
+	cache->entries_by_key = create_hashmap();
+	if (!cache->entries_by_key) {
+		free(cache);
+		return NULL;
+	}
+	wl_list_init(&cache->entries);
+	return cache;
+}
+
+static void entry_destroy(struct icon_cache *cache,
+		struct icon_cache_entry *entry) {
+	hashmap_remove(cache->entries_by_key, entry->key);
+	wl_list_remove(&entry->link);
+	cache->bytes -= entry->bytes;
+	cairo_surface_destroy(entry->surface);
+	free(entry->key);
+	free(entry);
+}
+
+void icon_cache_destroy(struct icon_cache *cache) {
+	if (!cache) {
+		return;
+	}
+	uint64_t lookups = cache->hits + cache->misses;
+	sway_log(SWAY_DEBUG, "Icon cache: %" PRIu64 " hits, %" PRIu64 " misses "
+			"(%.1f%% hit rate), %" PRIu64 " evictions", cache->hits,
+			cache->misses, lookups ? 100.0 * cache->hits / lookups : 0.0,
+			cache->evictions);
+
+	struct icon_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &cache->entries, link) {
+		entry_destroy(cache, entry);
+	}
+	hashmap_free(cache->entries_by_key);
+	free(cache);
+}
+
+static cairo_surface_t *cache_get(struct icon_cache *cache, const char *key) {
+	struct icon_cache_entry *entry = hashmap_get(cache->entries_by_key, key);
+	if (!entry) {
+		cache->misses++;
+		return NULL;
+	}
+	cache->hits++;
+	wl_list_remove(&entry->link);
+	wl_list_insert(&cache->entries, &entry->link);
+	return cairo_surface_reference(entry->surface);
+}
+
+static void cache_add(struct icon_cache *cache, const char *key,
+		cairo_surface_t *surface) {
+	struct icon_cache_entry *entry = calloc(1, sizeof(struct icon_cache_entry));
+	if (!entry) {
+		return;
+	}
+	entry->key = strdup(key);
+	if (!entry->key) {
+		free(entry);
+		return;
+	}
+	entry->surface = cairo_surface_reference(surface);
+	entry->bytes = (size_t)cairo_image_surface_get_stride(surface) *
+		cairo_image_surface_get_height(surface);
+	wl_list_insert(&cache->entries, &entry->link);
+	hashmap_set(cache->entries_by_key, key, entry);
+	cache->bytes += entry->bytes;
+
+	// Keep the new entry even if it is larger than the limit on its own
+	while (cache->bytes > ICON_CACHE_MAX_BYTES &&
+			cache->entries.prev != &entry->link) {
+		struct icon_cache_entry *oldest =
+			wl_container_of(cache->entries.prev, oldest, link);
+		entry_destroy(cache, oldest);
+		cache->evictions++;
+	}
+}
+
+cairo_surface_t *icon_cache_load(struct icon_cache *cache, const char *path,
+		char **key) {
+	// The file's modification time and size are part of the key, so that
+	// an icon which was replaced on disk is decoded again
+	if (!cache) {
+		return load_image(path);
+	}
+	struct stat sb;
+	if (stat(path, &sb) != 0) {
+		sway_log_errno(SWAY_ERROR, "Failed to read icon %s", path);
+		return NULL;
+	}
+	char *file_key = format_str("f:%lld.%ld:%lld:%s",
+			(long long)sb.st_mtim.tv_sec, sb.st_mtim.tv_nsec,
+			(long long)sb.st_size, path);
+	if (!file_key) {
+		return NULL;
+	}
+
+	cairo_surface_t *image = cache_get(cache, file_key);
+	if (!image) {
+		image = load_image(path);
+		if (image) {
+			cache_add(cache, file_key, image);
+		}
+	}
+
+	if (image && key) {
+		*key = file_key;
+	} else {
+		free(file_key);
+	}
+	return image;
+}
+
+char *icon_cache_pixmap_key(int size, const unsigned char *pixels) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	size_t len = (size_t)size * size * 4;
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ pixels[i]) * 1099511628211ULL;
+	}
+	return format_str("p:%d:%016" PRIx64, size, hash);
+}
+
+cairo_surface_t *icon_cache_scale(struct icon_cache *cache, const char *key,
+		cairo_surface_t *image, int size) {
+	char *scaled_key = cache && key ? format_str("s:%d:%s", size, key) : NULL;
+	cairo_surface_t *scaled = scaled_key ? cache_get(cache, scaled_key) : NULL;
+	if (!scaled) {
+		scaled = cairo_image_surface_scale(image, size, size);
+		if (scaled_key &&
+				cairo_surface_status(scaled) == CAIRO_STATUS_SUCCESS) {
+			cache_add(cache, scaled_key, scaled);
+		}
+	}
+	free(scaled_key);
+	return scaled;
+}
@@ -6,10 +6,10 @@
 #include <string.h>
 #include "swaybar/bar.h"
 #include "swaybar/config.h"
-#include "swaybar/image.h"
 #include "swaybar/input.h"
 #include "swaybar/tray/host.h"
 #include "swaybar/tray/icon.h"
+#include "swaybar/tray/icon_cache.h"
 #include "swaybar/tray/item.h"
 #include "swaybar/tray/tray.h"
 #include "cairo_util.h"
@@ -312,6 +312,7 @@ void destroy_sni(struct swaybar_sni *sni) {
 	}
 
 	cairo_surface_destroy(sni->icon);
+	free(sni->icon_key);
 	free(sni->watcher_id);
 	free(sni->service);
 	free(sni->path);
@@ -424,13 +425,16 @@ static void reload_sni(struct swaybar_sni *sni, char *icon_theme,
 		if (sni->icon_theme_path) {
 			list_add(icon_search_paths, sni->icon_theme_path);
 		}
-		char *icon_path = find_icon(sni->tray->themes, icon_search_paths,
-				icon_name, target_size, icon_theme,
+		char *icon_path = find_icon(sni->tray->icon_index, sni->tray->themes,
+				icon_search_paths, icon_name, target_size, icon_theme,
 				&sni->min_size, &sni->max_size);
 		list_free(icon_search_paths);
 		if (icon_path) {
 			cairo_surface_destroy(sni->icon);
-			sni->icon = load_image(icon_path);
+			free(sni->icon_key);
+			sni->icon_key = NULL;
+			sni->icon = icon_cache_load(sni->tray->icon_cache, icon_path,
+					&sni->icon_key);
 			free(icon_path);
 			return;
 		}
@@ -453,6 +457,8 @@ static void reload_sni(struct swaybar_sni *sni, char *icon_theme,
 		sni->icon = cairo_image_surface_create_for_data(pixmap->pixels,
 				CAIRO_FORMAT_ARGB32, pixmap->size, pixmap->size,
 				cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, pixmap->size));
+		free(sni->icon_key);
+		sni->icon_key = icon_cache_pixmap_key(pixmap->size, pixmap->pixels);
 	}
 }
 
@@ -481,7 +487,8 @@ uint32_t render_sni(cairo_t *cairo, struct swaybar_output *output, double *x,
 		int actual_size = cairo_image_surface_get_height(sni->icon);
 		icon_size = actual_size < target_size ?
 			actual_size*(target_size/actual_size) : target_size;
-		icon = cairo_image_surface_scale(sni->icon, icon_size, icon_size);
+		icon = icon_cache_scale(sni->tray->icon_cache, sni->icon_key,
+				sni->icon, icon_size);
 	} else { // draw a :(
 		icon_size = target_size*0.8;
 		icon = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, icon_size, icon_size);
@@ -6,12 +6,14 @@
 #include "swaybar/config.h"
 #include "swaybar/bar.h"
 #include "swaybar/tray/icon.h"
+#include "swaybar/tray/icon_cache.h"
 #include "swaybar/tray/host.h"
 #include "swaybar/tray/item.h"
 #include "swaybar/tray/tray.h"
 #include "swaybar/tray/watcher.h"
 #include "list.h"
 #include "log.h"
+#include "loop.h"
 
 static int handle_lost_watcher(sd_bus_message *msg,
 		void *data, sd_bus_error *error) {
@@ -34,6 +36,11 @@ static int handle_lost_watcher(sd_bus_message *msg,
 	return 0;
 }
 
+static void icon_index_in(int fd, short mask, void *data) {
+	struct swaybar_tray *tray = data;
+	icon_index_handle_events(tray->icon_index);
+}
+
 struct swaybar_tray *create_tray(struct swaybar *bar) {
 	sway_log(SWAY_DEBUG, "Initializing tray");
 
@@ -69,6 +76,12 @@ struct swaybar_tray *create_tray(struct swaybar *bar) {
 	init_host(&tray->host_kde, "kde", tray);
 
 	init_themes(&tray->themes, &tray->basedirs);
+	tray->icon_index = create_icon_index();
+	tray->icon_cache = icon_cache_create();
+	if (tray->icon_index && tray->icon_index->fd != -1) {
+		loop_add_fd(bar->eventloop, tray->icon_index->fd, POLLIN,
+				icon_index_in, tray);
+	}
 
 	return tray;
 }
@@ -87,6 +100,11 @@ void destroy_tray(struct swaybar_tray *tray) {
 	destroy_watcher(tray->watcher_kde);
 	sd_bus_flush_close_unref(tray->bus);
 	finish_themes(tray->themes, tray->basedirs);
+	if (tray->icon_index && tray->icon_index->fd != -1) {
+		loop_remove_fd(tray->bar->eventloop, tray->icon_index->fd);
+	}
+	destroy_icon_index(tray->icon_index);
+	icon_cache_destroy(tray->icon_cache);
 	free(tray);
 }
 
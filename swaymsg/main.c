@@ -5,6 +5,7 @@
 #include <string.h>
 #include <strings.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <sys/un.h>
 #include <sys/socket.h>
@@ -311,6 +312,64 @@ static void pretty_print_config(json_object *c) {
 	printf("%s\n", json_object_get_string(config));
 }
 
+static void print_latency(json_object *histogram, const char *key) {
+	json_object *value = json_object_object_get(histogram, key);
+	if (value) {
+		printf("%dms", json_object_get_int(value));
+	} else {
+		printf("unbounded");
+	}
+}
+
+static void pretty_print_stats(json_object *s) {
+	json_object *transactions = json_object_object_get(s, "transactions");
+	json_object *latency = json_object_object_get(transactions, "latency");
+	printf("Transactions: %" PRId64 " committed, %" PRId64 " applied, "
+			"%" PRId64 " timed out (timeout %" PRId64 "ms)\n",
+		json_object_get_int64(json_object_object_get(transactions, "committed")),
+		json_object_get_int64(json_object_object_get(transactions, "applied")),
+		json_object_get_int64(json_object_object_get(transactions, "timed_out")),
+		json_object_get_int64(json_object_object_get(transactions, "timeout_ms")));
+	printf("  Commit to apply: p50 < ");
+	print_latency(latency, "p50_ms");
+	printf(", p99 < ");
+	print_latency(latency, "p99_ms");
+	printf("\n");
+
+	json_object *clients = json_object_object_get(s, "clients");
+	size_t len = json_object_array_length(clients);
+	if (len > 0) {
+		printf("\nClients:\n");
+	}
+	for (size_t i = 0; i < len; ++i) {
+		json_object *client = json_object_array_get_idx(clients, i);
+		json_object *ack_latency = json_object_object_get(client, "ack_latency");
+		printf("  %s: %" PRId64 " configures, %" PRId64 " timeouts, "
+				"ack p50 < ",
+			json_object_get_string(json_object_object_get(client, "app_id")),
+			json_object_get_int64(json_object_object_get(client, "configures")),
+			json_object_get_int64(json_object_object_get(client, "timeouts")));
+		print_latency(ack_latency, "p50_ms");
+		printf(", p99 < ");
+		print_latency(ack_latency, "p99_ms");
+		printf(", deadline %" PRId64 "ms%s\n",
+			json_object_get_int64(json_object_object_get(client, "deadline_ms")),
+			json_object_get_boolean(json_object_object_get(client, "slow")) ?
+				" (slow)" : "");
+	}
+
+	json_object *text_cache;
+	if (json_object_object_get_ex(s, "text_cache", &text_cache)) {
+		printf("\nTitle text cache: %" PRId64 " rasters (%" PRId64 " KiB), "
+				"%" PRId64 " hits, %" PRId64 " misses, %" PRId64 " evictions\n",
+			json_object_get_int64(json_object_object_get(text_cache, "entries")),
+			json_object_get_int64(json_object_object_get(text_cache, "bytes")) / 1024,
+			json_object_get_int64(json_object_object_get(text_cache, "hits")),
+			json_object_get_int64(json_object_object_get(text_cache, "misses")),
+			json_object_get_int64(json_object_object_get(text_cache, "evictions")));
+	}
+}
+
 static void pretty_print_tree(json_object *obj, int indent) {
 	for (int i = 0; i < indent; i++) {
 		printf("  ");
@@ -378,6 +437,9 @@ static void pretty_print(int type, json_object *resp) {
 	case IPC_GET_TREE:
 		pretty_print_tree(resp, 0);
 		return;
+	case IPC_GET_STATS:
+		pretty_print_stats(resp);
+		return;
 	case IPC_COMMAND:
 	case IPC_GET_WORKSPACES:
 	case IPC_GET_INPUTS:
@@ -506,6 +568,8 @@ int main(int argc, char **argv) {
 		type = IPC_GET_WORKSPACES;
 	} else if (strcasecmp(cmdtype, "get_seats") == 0) {
 		type = IPC_GET_SEATS;
+	} else if (strcasecmp(cmdtype, "get_stats") == 0) {
+		type = IPC_GET_STATS;
 	} else if (strcasecmp(cmdtype, "get_inputs") == 0) {
 		type = IPC_GET_INPUTS;
 	} else if (strcasecmp(cmdtype, "get_outputs") == 0) {
@@ -27,6 +27,7 @@ int main(int argc, char **argv) {
 	swaynag.buttons = create_list();
 	wl_list_init(&swaynag.outputs);
 	wl_list_init(&swaynag.seats);
+	buffer_pool_init(&swaynag.buffer_pool);
 
 	struct swaynag_button *button_close = calloc(1, sizeof(struct swaynag_button));
 	button_close->text = strdup("X");
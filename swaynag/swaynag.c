@@ -540,8 +540,7 @@ void swaynag_destroy(struct swaynag *swaynag) {
 		swaynag_seat_destroy(seat);
 	}
 
-	destroy_buffer(&swaynag->buffers[0]);
-	destroy_buffer(&swaynag->buffers[1]);
+	buffer_pool_finish(&swaynag->buffer_pool);
 
 	if (swaynag->outputs.prev || swaynag->outputs.next) {
 		struct swaynag_output *output, *temp;